@@ -27,14 +27,37 @@ typedef enum {
 } ConnStatusType;
 typedef enum {
     PGRES_EMPTY_QUERY=0,
+    PGRES_COMMAND_OK=1,
+    PGRES_TUPLES_OK=2,
     PGRES_BAD_RESPONSE=5,
     PGRES_NONFATAL_ERROR=6,
     PGRES_FATAL_ERROR=7,
+    PGRES_SINGLE_TUPLE=9,
+    PGRES_PIPELINE_SYNC=10,
+    PGRES_PIPELINE_ABORTED=11,
+    PGRES_TUPLES_CHUNK=12,
 } ExecStatusType;
+typedef enum {
+    PQTRANS_IDLE=0,
+    PQTRANS_ACTIVE=1,
+    PQTRANS_INTRANS=2,
+    PQTRANS_INERROR=3,
+    PQTRANS_UNKNOWN=4
+} PGTransactionStatusType;
 typedef unsigned int Oid;
 typedef struct pg_conn PGconn;
 typedef struct pg_result PGresult;
+typedef struct pg_cancel PGcancel;
 typedef void (*PQnoticeProcessor)(void*, const PGresult*);
+typedef struct pgresAttDesc {
+    char* name;
+    Oid tableid;
+    int columnid;
+    int format;
+    Oid typid;
+    int typlen;
+    int atttypmod;
+} PGresAttDesc;
 
 #define PG_DIAG_SQLSTATE 'C'
 #define PG_DIAG_MESSAGE_PRIMARY 'M'
@@ -43,4 +66,26 @@ typedef void (*PQnoticeProcessor)(void*, const PGresult*);
 
 MODULE_SCOPE const pqStubDefs* pqStubs;
 
+/*
+ * Routines that only recent releases of the client library provide.
+ * They are looked up one at a time once the library is loaded, and
+ * are left NULL when the library lacks them, so callers must test
+ * for their presence before use.
+ */
+
+typedef struct pqOptStubDefs {
+    int (*PQsetChunkedRowsModePtr)(PGconn*, int);
+    size_t (*PQresultMemorySizePtr)(const PGresult*);
+    int (*PQenterPipelineModePtr)(PGconn*);
+    int (*PQexitPipelineModePtr)(PGconn*);
+    int (*PQpipelineSyncPtr)(PGconn*);
+} pqOptStubDefs;
+#define PQsetChunkedRowsMode (pqOptStubs->PQsetChunkedRowsModePtr)
+#define PQresultMemorySize (pqOptStubs->PQresultMemorySizePtr)
+#define PQenterPipelineMode (pqOptStubs->PQenterPipelineModePtr)
+#define PQexitPipelineMode (pqOptStubs->PQexitPipelineModePtr)
+#define PQpipelineSync (pqOptStubs->PQpipelineSyncPtr)
+
+MODULE_SCOPE const pqOptStubDefs* pqOptStubs;
+
 #endif
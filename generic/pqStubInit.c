@@ -84,6 +84,29 @@ static const char *const pqSymbolNames[] = {
     "PQstatus",
     "PQuser",
     "PQtty",
+    "PQsendQueryPrepared",
+    "PQsetSingleRowMode",
+    "PQgetResult",
+    "PQexecParams",
+    "PQtransactionStatus",
+    "PQfformat",
+    "PQmakeEmptyPGresult",
+    "PQsetResultAttrs",
+    "PQsetvalue",
+    "PQftable",
+    "PQftablecol",
+    "PQfsize",
+    "PQfmod",
+    "PQgetCancel",
+    "PQcancel",
+    "PQfreeCancel",
+    "PQparameterStatus",
+    "lo_creat",
+    "lo_open",
+    "lo_write",
+    "lo_close",
+    "PQsendQueryParams",
+    "PQcmdStatus",
     NULL
     /* @END@ */
 };
@@ -95,6 +118,27 @@ static const char *const pqSymbolNames[] = {
 static pqStubDefs pqStubsTable;
 const pqStubDefs* pqStubs = &pqStubsTable;
 
+/*
+ * Names of the functions that we use if PostgreSQL provides them, in the
+ * order of the members of pqOptStubDefs.
+ */
+
+static const char *const pqOptSymbolNames[] = {
+    "PQsetChunkedRowsMode",
+    "PQresultMemorySize",
+    "PQenterPipelineMode",
+    "PQexitPipelineMode",
+    "PQpipelineSync",
+    NULL
+};
+
+/*
+ * Table containing pointers to the optional functions named above.
+ */
+
+static pqOptStubDefs pqOptStubsTable;
+const pqOptStubDefs* pqOptStubs = &pqOptStubsTable;
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -166,5 +210,12 @@ PostgresqlInitStubs(Tcl_Interp* interp)
     if (status != TCL_OK) {
 	return NULL;
     }
+
+    /* Resolve whichever optional functions the library has to offer */
+
+    for (i = 0; pqOptSymbolNames[i] != NULL; ++i) {
+	((void**) &pqOptStubsTable)[i] =
+	    Tcl_FindSymbol(NULL, handle, pqOptSymbolNames[i]);
+    }
     return handle;
 }
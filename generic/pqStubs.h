@@ -48,6 +48,29 @@ typedef struct pqStubDefs {
     ConnStatusType (*PQstatusPtr)(PGconn*);
     char* (*PQuserPtr)(const PGconn*);
     char* (*PQttyPtr)(const PGconn*);
+    int (*PQsendQueryPreparedPtr)(PGconn*, const char*, int, const char *const*, const int*, const int*, int);
+    int (*PQsetSingleRowModePtr)(PGconn*);
+    PGresult* (*PQgetResultPtr)(PGconn*);
+    PGresult* (*PQexecParamsPtr)(PGconn*, const char*, int, const Oid*, const char *const*, const int*, const int*, int);
+    PGTransactionStatusType (*PQtransactionStatusPtr)(const PGconn*);
+    int (*PQfformatPtr)(const PGresult*, int);
+    PGresult* (*PQmakeEmptyPGresultPtr)(PGconn*, ExecStatusType);
+    int (*PQsetResultAttrsPtr)(PGresult*, int, PGresAttDesc*);
+    int (*PQsetvaluePtr)(PGresult*, int, int, char*, int);
+    Oid (*PQftablePtr)(const PGresult*, int);
+    int (*PQftablecolPtr)(const PGresult*, int);
+    int (*PQfsizePtr)(const PGresult*, int);
+    int (*PQfmodPtr)(const PGresult*, int);
+    PGcancel* (*PQgetCancelPtr)(PGconn*);
+    int (*PQcancelPtr)(PGcancel*, char*, int);
+    void (*PQfreeCancelPtr)(PGcancel*);
+    const char* (*PQparameterStatusPtr)(const PGconn*, const char*);
+    Oid (*lo_creatPtr)(PGconn*, int);
+    int (*lo_openPtr)(PGconn*, Oid, int);
+    int (*lo_writePtr)(PGconn*, int, const char*, size_t);
+    int (*lo_closePtr)(PGconn*, int);
+    int (*PQsendQueryParamsPtr)(PGconn*, const char*, int, const Oid*, const char *const*, const int*, const int*, int);
+    char* (*PQcmdStatusPtr)(PGresult*);
 } pqStubDefs;
 #define pg_encoding_to_char (pqStubs->pg_encoding_to_charPtr)
 #define PQclear (pqStubs->PQclearPtr)
@@ -82,4 +105,27 @@ typedef struct pqStubDefs {
 #define PQstatus (pqStubs->PQstatusPtr)
 #define PQuser (pqStubs->PQuserPtr)
 #define PQtty (pqStubs->PQttyPtr)
+#define PQsendQueryPrepared (pqStubs->PQsendQueryPreparedPtr)
+#define PQsetSingleRowMode (pqStubs->PQsetSingleRowModePtr)
+#define PQgetResult (pqStubs->PQgetResultPtr)
+#define PQexecParams (pqStubs->PQexecParamsPtr)
+#define PQtransactionStatus (pqStubs->PQtransactionStatusPtr)
+#define PQfformat (pqStubs->PQfformatPtr)
+#define PQmakeEmptyPGresult (pqStubs->PQmakeEmptyPGresultPtr)
+#define PQsetResultAttrs (pqStubs->PQsetResultAttrsPtr)
+#define PQsetvalue (pqStubs->PQsetvaluePtr)
+#define PQftable (pqStubs->PQftablePtr)
+#define PQftablecol (pqStubs->PQftablecolPtr)
+#define PQfsize (pqStubs->PQfsizePtr)
+#define PQfmod (pqStubs->PQfmodPtr)
+#define PQgetCancel (pqStubs->PQgetCancelPtr)
+#define PQcancel (pqStubs->PQcancelPtr)
+#define PQfreeCancel (pqStubs->PQfreeCancelPtr)
+#define PQparameterStatus (pqStubs->PQparameterStatusPtr)
+#define PQsendQueryParams (pqStubs->PQsendQueryParamsPtr)
+#define lo_creat (pqStubs->lo_creatPtr)
+#define lo_open (pqStubs->lo_openPtr)
+#define lo_write (pqStubs->lo_writePtr)
+#define lo_close (pqStubs->lo_closePtr)
+#define PQcmdStatus (pqStubs->PQcmdStatusPtr)
 MODULE_SCOPE const pqStubDefs *pqStubs;
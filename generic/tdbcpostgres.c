@@ -69,7 +69,10 @@ int g_connections = 0;
 #include <tclOO.h>
 #include <tdbc.h>
 
+#include <ctype.h>
+#include <float.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef HAVE_STDINT_H
@@ -152,11 +155,14 @@ enum LiteralIndex {
 /* Object IDs for the Postgres data types */
 
 #define UNTYPEDOID	0
+#define BOOLOID		16
 #define BYTEAOID	17
+#define NAMEOID		19
 #define INT8OID		20
 #define INT2OID         21
 #define INT4OID         23
 #define TEXTOID		25
+#define OIDOID		26
 #define FLOAT4OID	700
 #define FLOAT8OID	701
 #define BPCHAROID	1042
@@ -166,6 +172,41 @@ enum LiteralIndex {
 #define TIMESTAMPOID	1114
 #define BITOID		1560
 #define NUMERICOID      1700
+#define UUIDOID		2950
+
+/* Constants of PostgreSQL's binary formats for dates and numerics */
+
+#define POSTGRES_EPOCH_DAYS	10957	/* Days from 1970-01-01 to
+					 * 2000-01-01 */
+#define USECS_PER_DAY		((Tcl_WideInt) 86400 * 1000000)
+#define NUMERIC_POS		0x0000
+#define NUMERIC_NEG		0x4000
+#define NUMERIC_NAN		0xC000
+#define NUMERIC_PINF		0xD000
+#define NUMERIC_NINF		0xF000
+#define DATE_NOBEGIN		0x80000000U
+#define DATE_NOEND		0x7FFFFFFFU
+#define TIMESTAMP_NOBEGIN	(((Tcl_WideUInt) 1) << 63)
+#define TIMESTAMP_NOEND		((((Tcl_WideUInt) 1) << 63) - 1)
+#define NUMERIC_MAX_DSCALE	0x3FFF
+#define NUMERIC_MAX_EXPONENT	1000	/* Largest exponent the server
+					 * accepts in a numeric literal */
+#define NUMERIC_MAX_DIGITS	65536	/* Digits beyond which a numeric
+					 * parameter is sent as text */
+
+/* Number of executions that 'executemany' sends without awaiting results */
+
+#define EXECUTEMANY_BATCH	256
+
+/* Constants for parameters read from channels */
+
+#define INV_WRITE		0x00020000 /* Large object access modes */
+#define INV_READ		0x00040000
+#define BLOB_CHUNK_BYTES	65536	/* Bytes read from a channel, or
+					 * written to a large object, at
+					 * a time */
+#define BLOB_MAX_BYTES		0x3FFFFFFF
+					/* Largest value of a field */
 
 typedef struct PostgresDataType {
     const char* name;		/* Type name */
@@ -193,6 +234,38 @@ static const PostgresDataType dataTypes[] = {
     { NULL, 0 }
 };
 
+/*
+ * Array types of the data types above, and of others that have binary
+ * encoders for parameters. 'paramtype' accepts an array type as the name
+ * of its element type followed by '[]'.
+ */
+
+typedef struct PostgresArrayType {
+    Oid elementOid;		/* Type number of the elements */
+    Oid arrayOid;		/* Type number of the array */
+} PostgresArrayType;
+static const PostgresArrayType arrayTypes[] = {
+    { BOOLOID,	    1000 },
+    { BYTEAOID,	    1001 },
+    { NAMEOID,	    1003 },
+    { INT2OID,	    1005 },
+    { INT4OID,	    1007 },
+    { TEXTOID,	    1009 },
+    { BPCHAROID,    1014 },
+    { VARCHAROID,   1015 },
+    { INT8OID,	    1016 },
+    { FLOAT4OID,    1021 },
+    { FLOAT8OID,    1022 },
+    { OIDOID,	    1028 },
+    { TIMESTAMPOID, 1115 },
+    { DATEOID,	    1182 },
+    { TIMEOID,	    1183 },
+    { NUMERICOID,   1231 },
+    { BITOID,	    1561 },
+    { UUIDOID,	    2951 },
+    { 0, 0 }
+};
+
 /* Configuration options for Postgres connections */
 
 /* Data types of configuration options */
@@ -203,6 +276,19 @@ enum OptType {
     TYPE_ENCODING,		/* Encoding name */
     TYPE_ISOLATION,		/* Transaction isolation level */
     TYPE_READONLY,		/* Read-only indicator */
+    TYPE_FETCHMODE,		/* Default way of retrieving result rows */
+    TYPE_CHUNKSIZE,		/* Default number of rows per transfer */
+    TYPE_WITHHOLD,		/* Cursors outlive the transaction */
+    TYPE_INTERN,		/* Share repeated text values of result
+				 * columns */
+    TYPE_REUSE,			/* Update row variables in place */
+    TYPE_SPILLTHRESHOLD,	/* Bytes of a materialized result that are
+				 * kept in memory */
+    TYPE_MAXRESULTBYTES,	/* Limit on the memory held by a result */
+    TYPE_MAXBLOBBYTES,		/* Limit on the contents of a channel
+				 * bound to a parameter */
+    TYPE_CANCELONCLOSE,		/* Cancel abandoned streaming queries */
+    TYPE_POSITIONAL,		/* Parameter values in order */
     TYPE_ATTACH			/* Not stored, used to attach to a
 				   previously detached connection */
 };
@@ -270,6 +356,14 @@ static const struct {
     { "-encoding", TYPE_ENCODING,  0,		CONN_OPT_FLAG_MOD,   NULL},
     { "-isolation", TYPE_ISOLATION, 0,		CONN_OPT_FLAG_MOD,   NULL},
     { "-readonly", TYPE_READONLY,  0,		CONN_OPT_FLAG_MOD,   NULL},
+    { "-fetchmode", TYPE_FETCHMODE, 0,		CONN_OPT_FLAG_MOD,   NULL},
+    { "-chunksize", TYPE_CHUNKSIZE, 0,		CONN_OPT_FLAG_MOD,   NULL},
+    { "-withhold", TYPE_WITHHOLD,  0,		CONN_OPT_FLAG_MOD,   NULL},
+    { "-intern",   TYPE_INTERN,    0,		CONN_OPT_FLAG_MOD,   NULL},
+    { "-spillthreshold", TYPE_SPILLTHRESHOLD, 0, CONN_OPT_FLAG_MOD,  NULL},
+    { "-maxresultbytes", TYPE_MAXRESULTBYTES, 0, CONN_OPT_FLAG_MOD,  NULL},
+    { "-maxblobbytes", TYPE_MAXBLOBBYTES, 0,	CONN_OPT_FLAG_MOD,   NULL},
+    { "-cancelonclose", TYPE_CANCELONCLOSE, 0, CONN_OPT_FLAG_MOD,    NULL},
     { "-attach",   TYPE_ATTACH,    INDX_ATTACH, 0,		     NULL},
     { NULL,	   TYPE_STRING,		   0,		0,		     NULL}
 };
@@ -286,6 +380,9 @@ typedef struct PerInterpData {
     int refCount;		    /* Reference count */
     Tcl_Obj* literals[LIT__END];    /* Literal pool */
     Tcl_HashTable typeNumHash;	    /* Lookup table for type numbers */
+    const Tcl_ObjType* listType;    /* Tcl's list type */
+    const Tcl_ObjType* dictType;    /* Tcl's dict type */
+    const Tcl_ObjType* doubleType;  /* Tcl's double type */
 } PerInterpData;
 #define IncrPerInterpRefCount(x)  \
     do {			  \
@@ -317,6 +414,46 @@ typedef struct ConnectionData {
     int readOnly;		/* Read only connection indicator */
     char * savedOpts[INDX_MAX]; /* Saved configuration options */
     Tcl_HashTable* statements;	/* Prepared statements */
+    int fetchMode;		/* Default fetch mode of new result sets */
+    int chunkSize;		/* Default rows per transfer when streaming */
+    int withHold;		/* Default for declaring cursors WITH HOLD */
+    int intern;			/* Default for interning text values */
+    Tcl_WideInt spillThreshold;	/* Default size past which materialized
+				 * results spill to a temporary file;
+				 * 0 to keep them in memory */
+    Tcl_WideInt maxResultBytes;	/* Limit on the memory that a result set
+				 * may hold, or 0 for no limit */
+    Tcl_WideInt maxBlobBytes;	/* Limit on the contents of a channel that
+				 * are read into memory, or 0 for none
+				 * but the size of a field */
+    int cancelOnClose;		/* Default for cancelling abandoned
+				 * streaming queries */
+    Tcl_HashTable* enumTypes;	/* Cache of whether user-defined types are
+				 * enums, keyed by type OID, or NULL */
+    struct ResultSetData* streamOwner;
+				/* Result set whose rows are still arriving
+				 * over the connection, or NULL if the
+				 * connection is idle */
+    Tcl_Obj* deferredDeallocs;	/* List of names of prepared statements
+				 * whose unallocation had to wait for the
+				 * connection to be free, or NULL */
+    Tcl_Obj* deferredCloses;	/* List of names of cursors whose closing
+				 * had to wait for the connection to be
+				 * free, each followed by its
+				 * transaction number, or NULL */
+    Tcl_WideInt xactCounter;	/* Number of the current transaction:
+				 * counts the transactions that are known,
+				 * or may be supposed, to have ended */
+    struct ResultSetData* pipelineHead;
+				/* First of the result sets queued in
+				 * pipeline mode, awaiting their results,
+				 * or NULL */
+    struct ResultSetData* pipelineTail;
+				/* Last of the queued result sets */
+    struct ResultSetData* pipelineFailure;
+				/* First result set whose statement failed
+				 * in the current pipeline, and whose
+				 * failure has not been reported, or NULL */
 } ConnectionData;
 
 /*
@@ -324,6 +461,10 @@ typedef struct ConnectionData {
  */
 
 #define CONN_FLAG_IN_XCN	0x1 	/* Transaction is in progress */
+#define CONN_FLAG_BATCH		0x2	/* 'executemany' is in progress */
+#define CONN_FLAG_PIPELINE	0x4	/* A 'pipeline' script is running */
+#define CONN_FLAG_PIPELINE_MODE	0x8	/* libpq is in pipeline mode, with
+					 * statements queued */
 
 #define IncrConnectionRefCount(x) \
     do {			  \
@@ -345,6 +486,70 @@ struct pgStatementRef {
     struct pgStatementRef* next;
 };
 
+/*
+ * Function that converts a column value, as libpq delivers it, to a Tcl
+ * object.
+ */
+
+typedef Tcl_Obj* ColumnDecoder(const char* buffer, int buffSize);
+
+/*
+ * Structure describing how the rows of a result become Tcl values. A plan
+ * is made from the first result of a statement, and is shared by the
+ * result sets of later executions, whose columns are the same. It is
+ * reference counted, because a result set may outlive its statement's
+ * plan if the statement is prepared again.
+ */
+
+typedef struct DecodePlan {
+    int refCount;		/* Reference count */
+    int nColumns;		/* Number of columns */
+    Tcl_Obj** columnNames;	/* Names of the columns */
+    ColumnDecoder** decoders;	/* Converters for the values of the
+				 * columns */
+    char* enums;		/* Flags == 1 for columns of enum types */
+    int format;			/* 1 if the plan decodes results in binary
+				 * format, 0 for text */
+    Tcl_Obj** cells;		/* Room to assemble the elements of a row,
+				 * 2*nColumns long */
+} DecodePlan;
+
+#define IncrDecodePlanRefCount(x)		\
+    do {					\
+	++((x)->refCount);			\
+    } while (0)
+#define DecrDecodePlanRefCount(x)		\
+    do {					\
+	DecodePlan* plan = (x);			\
+	if (--(plan->refCount) <= 0) {		\
+	    DeleteDecodePlan(plan);		\
+	}					\
+    } while(0)
+
+/*
+ * A ResultBuffer shares a PGresult between a result set and the lazy cells
+ * (see lazyCellType below) that refer to its text. The PGresult is cleared
+ * when the last of them lets go of it.
+ */
+
+typedef struct ResultBuffer {
+    int refCount;		/* Reference count */
+    PGresult* result;		/* Shared result */
+} ResultBuffer;
+
+#define IncrResultBufferRefCount(x)		\
+    do {					\
+	++((x)->refCount);			\
+    } while (0)
+#define DecrResultBufferRefCount(x)		\
+    do {					\
+	ResultBuffer* buf = (x);		\
+	if (--(buf->refCount) <= 0) {		\
+	    PQclear(buf->result);		\
+	    ckfree(buf);			\
+	}					\
+    } while(0)
+
 /*
  * Structure that carries the data for a Postgres prepared statement.
  *
@@ -367,11 +572,21 @@ typedef struct StatementData {
 				 * Postgres */
     char* stmtName;		/* Name identyfing the statement */
     Tcl_Obj* columnNames;	/* Column names in the result set */
+    int nColumns;		/* Number of columns in the result set */
+    Oid* columnTypes;		/* Data types of the result columns, as
+				 * described when the statement was
+				 * prepared */
+    DecodePlan* plan;		/* Plan for decoding the rows of results,
+				 * or NULL if none has been made yet */
 
     struct ParamData *params;	/* Attributes of parameters */
     int nParams;		/* Number of parameters */
     Oid* paramDataTypes;	/* Param data types list */
     int paramTypesChanged;	/* Indicator of changed param types */
+    char* paramScratch;		/* Storage, kept from one execution to the
+				 * next, for the tables of parameter values
+				 * that are handed to libpq */
+    size_t paramScratchSize;	/* Size of the storage in bytes */
     int flags;
     struct pgStatementRef* pgStatements;
     				/* Linked list of pgStatement objs so
@@ -396,6 +611,34 @@ typedef struct StatementData {
 /* Flags in the 'StatementData->flags' word */
 
 #define STMT_FLAG_BUSY		0x1	/* Statement handle is in use */
+#define STMT_FLAG_SCRATCH_BUSY	0x2	/* Parameter storage is in use */
+
+/*
+ * The parameter storage of a statement holds, for each parameter, a
+ * pointer to its value, its length, its format, a flag saying whether
+ * the value was allocated separately, and a slot of PARAM_SLOT_BYTES
+ * in which a binary value of fixed size is built.
+ */
+
+#define PARAM_SLOT_BYTES	16
+#define PARAM_SCRATCH_BYTES(n)						\
+    ((size_t) (n) * (sizeof(char*) + PARAM_SLOT_BYTES + 2 * sizeof(int) + 1))
+
+/*
+ * Structure locating the tables of marshalled parameters in the
+ * parameter storage, in the form that PQexecPrepared takes them.
+ */
+
+typedef struct ParamTables {
+    char* scratch;		/* Storage for all the below */
+    const char** values;	/* Table of values */
+    char* slots;		/* Storage for fixed-size binary values */
+    int* lengths;		/* Table of parameter lengths */
+    int* formats;		/* Table of parameter formats
+				 * (binary or string) */
+    char* needsFreeing;		/* Flags for whether a parameter needs
+				 * its memory released */
+} ParamTables;
 
 /*
  * Structure describing the data types of substituted parameters in
@@ -409,12 +652,91 @@ typedef struct ParamData {
 				 * expected data */
 } ParamData;
 
+/*
+ * Structure that carries the data for a command made by 'bind', which
+ * executes a statement with positional parameters. The commands bound
+ * to a statement object are listed in a BoundCommands structure kept
+ * as the object's metadata, so that they are deleted with it.
+ */
+
+typedef struct BoundStatement {
+    StatementData* sdata;	/* Statement to execute */
+    int lists;			/* Flag == 1 to return rows as lists,
+				 * 0 for dictionaries */
+    Tcl_Command token;		/* The command */
+    struct BoundCommands* owner;
+				/* List of commands bound to the statement
+				 * object */
+    struct BoundStatement* next;
+				/* Next command in the list */
+} BoundStatement;
+
+typedef struct BoundCommands {
+    Tcl_Interp* interp;		/* Interpreter holding the commands */
+    BoundStatement* first;	/* First command in the list */
+} BoundCommands;
+
+/*
+ * Channels wrapped by ::tdbc::postgres::blob are known by handles, such
+ * as "pgblob1", recorded in a table that is associated data of the
+ * interpreter. Only a handle in the table stands for a channel when
+ * bound to a parameter, so no other value can name one. A handle is
+ * forgotten when its channel is closed.
+ */
+
+#define BLOB_TABLE_KEY "tdbc::postgres::blobs"
+
+typedef struct BlobTable {
+    Tcl_HashTable handles;	/* BlobHandle* keyed by the name of the
+				 * handle */
+    int counter;		/* Number of the last handle made */
+} BlobTable;
+
+typedef struct BlobHandle {
+    Tcl_HashEntry* entry;	/* Entry of the handle in the table */
+    Tcl_Channel chan;		/* Channel that the handle stands for */
+} BlobHandle;
+
 #define PARAM_KNOWN	1<<0	/* Something is known about the parameter */
 #define PARAM_IN 	1<<1	/* Parameter is an input parameter */
 #define PARAM_OUT 	1<<2	/* Parameter is an output parameter */
 				/* (Both bits are set if parameter is
 				 * an INOUT parameter) */
 
+/*
+ * Structure holding the rows of a materialized result set that has been
+ * read with a spill threshold. The rows are packed one after another, each
+ * column as a length in host byte order (-1 for NULL) followed by its
+ * bytes. They are kept in memory until they outgrow the threshold, after
+ * which they are written to a temporary file. Groups of SPOOL_BATCH_ROWS
+ * rows are rebuilt into a PGresult as the rows are visited.
+ */
+
+typedef struct ResultSpool {
+    int nColumns;		/* Number of columns */
+    PGresAttDesc* attrs;	/* Descriptions of the columns, from which
+				 * batches of rows are rebuilt */
+    int nRows;			/* Number of rows in the spool */
+    Tcl_WideInt size;		/* Number of bytes in the spool */
+    Tcl_WideInt* batchOffsets;	/* Offset in the spool of the first row
+				 * of each batch */
+    int batchCapacity;		/* Room in batchOffsets */
+    char* bytes;		/* Bytes not yet written to the file; all
+				 * of the spool while 'chan' is NULL */
+    size_t nBytes;		/* Number of bytes in 'bytes' */
+    size_t capacity;		/* Room in 'bytes' */
+    Tcl_Channel chan;		/* Temporary file, or NULL */
+} ResultSpool;
+
+/*
+ * Number of rows that are rebuilt from a spool at a time, and the number of
+ * bytes that are gathered in memory before they are written to the
+ * temporary file.
+ */
+
+#define SPOOL_BATCH_ROWS	1024
+#define SPOOL_BLOCK_BYTES	(1 << 16)
+
 /*
  * Structure describing a Postgres result set.  The object that the Tcl
  * API terms a "result set" actually has to be represented by a Postgres
@@ -426,9 +748,98 @@ typedef struct ResultSetData {
     int refCount;		/* Reference count */
     StatementData* sdata;	/* Statement that generated this result set */
     PGresult* execResult;	/* Structure containing result of prepared statement execution */
+    ResultBuffer* buffer;	/* Buffer sharing execResult with lazy
+				 * cells, or NULL if there are none */
     char* stmtName;		/* Name identyfing the statement */
+    DecodePlan* plan;		/* Plan for decoding the rows */
     int rowCount;		/* Number of already retreived rows */
+    int batchStart;		/* Number of the row that is first in
+				 * execResult */
+    int fetchMode;		/* How rows are retrieved from the server */
+    int chunkSize;		/* Rows per transfer when streaming, or
+				 * per FETCH from a cursor; 0 to let a
+				 * cursor choose for itself */
+    int withHold;		/* Flag == 1 if a cursor is to be declared
+				 * WITH HOLD */
+    int cancelOnClose;		/* Flag == 1 if a streaming query may be
+				 * cancelled when its rows are discarded */
+    ResultSpool* spool;		/* Rows of a result that was read with a
+				 * spill threshold, or NULL */
+    char* cursorName;		/* Name of the server-side cursor, or NULL */
+    Tcl_WideInt cursorXact;	/* Number of the transaction to which the
+				 * cursor belongs, or -1 if it was declared
+				 * WITH HOLD */
+    Tcl_HashTable* internTable;	/* Shared values of interned columns, keyed
+				 * by their text, or NULL */
+    int* internCounts;		/* Count of distinct values that each column
+				 * has added to internTable, or -1 if the
+				 * column is not interned */
+    int reuse;			/* Flag == 1 if 'nextlist' and 'nextdict'
+				 * are to update the row in their variable
+				 * in place */
+    Tcl_Obj* varsSpec;		/* Arguments of the 'nextvars' call for
+				 * which varNames was made, or NULL */
+    Tcl_Obj** varNames;		/* Names of the variables that receive the
+				 * columns in 'nextvars', NULL for columns
+				 * that are not assigned */
+    int fetchSize;		/* Rows requested by the next FETCH */
+    Tcl_Time batchTime;		/* Time at which the last FETCH finished */
+    struct ResultSetData* pipelineNext;
+				/* Next result set in the connection's
+				 * pipeline queue */
+    int flags;			/* Flags - see below */
 } ResultSetData;
+
+/* Flags in the 'ResultSetData->flags' word */
+
+#define RS_FLAG_STREAMING	0x1	/* More results are to be read from
+					 * the connection */
+#define RS_FLAG_CURSOR		0x2	/* More rows are to be fetched from
+					 * the cursor */
+#define RS_FLAG_BATCHED		0x4	/* execResult holds only the rows of
+					 * the last FETCH, or none at all
+					 * once they are exhausted */
+#define RS_FLAG_CANCELLABLE	0x8	/* The streaming statement can be
+					 * cancelled, rather than read to
+					 * its end, when its remaining rows
+					 * are discarded */
+#define RS_FLAG_PENDING		0x10	/* The statement is queued in a
+					 * pipeline, and its result has not
+					 * been read */
+#define RS_FLAG_FAILED		0x20	/* The statement failed, or was
+					 * skipped, in a pipeline;
+					 * execResult holds the error */
+#define RS_FLAG_INTERN		0x40	/* All text columns of the pending
+					 * result are to be interned */
+#define RS_FLAG_ROLLED_BACK	0x80	/* The statement succeeded in a
+					 * pipeline, but a later one in the
+					 * same transaction failed */
+
+/*
+ * Limits on the number of rows that a cursor FETCHes at a time. A cursor
+ * starts at CURSOR_FETCH_INITIAL rows, and doubles the count while the
+ * round trip to the server is a noticeable fraction (more than
+ * 1/CURSOR_LATENCY_RATIO) of the time that the script spends on a batch,
+ * but never lets a batch grow much past CURSOR_BATCH_BYTES of data.
+ */
+
+#define CURSOR_FETCH_INITIAL	64
+#define CURSOR_FETCH_MAX	65536
+#define CURSOR_BATCH_BYTES	(1 << 20)
+#define CURSOR_LATENCY_RATIO	4
+
+/*
+ * Limit on the number of distinct values that an interned column may
+ * contribute to a result set's internTable. Past it, the column is taken
+ * to be of high cardinality and its values are no longer interned.
+ */
+
+#define INTERN_MAX_VALUES	256
+
+/* First OID that PostgreSQL assigns to user-defined objects */
+
+#define FIRST_NORMAL_OID	16384
+
 #define IncrResultSetRefCount(x)		\
     do {					\
 	++((x)->refCount);			\
@@ -468,16 +879,76 @@ enum IsolationLevel {
     ISOL_NONE = -1
 };
 
+/* Ways of retrieving the rows of a result set */
+
+static const char *const FetchModes[] = {
+    "materialize",
+    "stream",
+    "cursor",
+    NULL
+};
+
+enum FetchMode {
+    FETCH_MATERIALIZE,		/* Whole result is read by PQexecPrepared */
+    FETCH_STREAM,		/* Rows are read as they are consumed, in
+				 * single-row or chunked-rows mode */
+    FETCH_CURSOR,		/* Rows are FETCHed in batches from a
+				 * server-side cursor */
+    FETCH_NONE = -1
+};
+
+/* Options accepted by the result set constructor */
+
+static const struct {
+    const char* name;		/* Option name */
+    enum OptType type;		/* Option data type */
+} ResultSetOptions[] = {
+    { "-fetchmode", TYPE_FETCHMODE },
+    { "-chunksize", TYPE_CHUNKSIZE },
+    { "-withhold",  TYPE_WITHHOLD },
+    { "-intern",    TYPE_INTERN },
+    { "-reuse",     TYPE_REUSE },
+    { "-spillthreshold", TYPE_SPILLTHRESHOLD },
+    { "-cancelonclose", TYPE_CANCELONCLOSE },
+    { "-positional", TYPE_POSITIONAL },
+    { NULL,	    TYPE_STRING }
+};
+
+/* Options and forms of rows accepted by the bulk row methods */
+
+static const char *const RowOptions[] = {
+    "-as",
+    "-columnsvariable",
+    "--",
+    NULL
+};
+
+enum RowOption {
+    ROWOPT_AS,
+    ROWOPT_COLUMNSVARIABLE,
+    ROWOPT_END
+};
+
+static const char *const RowForms[] = {
+    "dicts",
+    "lists",
+    NULL
+};
+
 /* Static functions defined within this file */
 
-static int DeterminePostgresMajorVersion(Tcl_Interp* interp,
-					 ConnectionData* cdata,
-					 int* versionPtr);
 static void DummyNoticeProcessor(void*, const PGresult*);
 static int ExecSimpleQuery(Tcl_Interp* interp, PGconn * pgPtr,
 			   const char * query, PGresult** resOut);
 static void TransferPostgresError(Tcl_Interp* interp, PGconn * pgPtr);
 static int TransferResultError(Tcl_Interp* interp, PGresult * res);
+static int CheckConnectionAvailable(Tcl_Interp* interp,
+				    ConnectionData* cdata);
+static int CheckConnectionIdle(Tcl_Interp* interp, ConnectionData* cdata);
+static int GetChunkSizeFromObj(Tcl_Interp* interp, Tcl_Obj* obj,
+			       int* chunkSizePtr);
+static int GetByteCountFromObj(Tcl_Interp* interp, Tcl_Obj* obj,
+			       const char* what, Tcl_WideInt* countPtr);
 
 static Tcl_Obj* QueryConnectionOption(ConnectionData* cdata,
 				      Tcl_Interp* interp,
@@ -515,6 +986,14 @@ static int ConnectionDetachMethod(ClientData clientData, Tcl_Interp* interp,
 static int ConnectionConnectedMethod(ClientData clientData, Tcl_Interp* interp,
 				  Tcl_ObjectContext context,
 				  int objc, Tcl_Obj *const objv[]);
+static int ConnectionPipelineMethod(ClientData clientData, Tcl_Interp* interp,
+				    Tcl_ObjectContext context,
+				    int objc, Tcl_Obj *const objv[]);
+static int CanPipeline(ResultSetData* rdata, Tcl_WideInt spillThreshold);
+static int SendPipelined(Tcl_Interp* interp, ResultSetData* rdata,
+			 ParamTables* tables);
+static int SyncPipeline(Tcl_Interp* interp, ConnectionData* cdata);
+static int AwaitPipelinedResult(Tcl_Interp* interp, ResultSetData* rdata);
 static void DeleteConnectionMetadata(ClientData clientData);
 static void DeleteConnection(ConnectionData* cdata);
 static int CloneConnection(Tcl_Interp* interp, ClientData oldClientData,
@@ -522,10 +1001,129 @@ static int CloneConnection(Tcl_Interp* interp, ClientData oldClientData,
 static void DeleteDestroyMetadata(ClientData clientData) { /* nop */ }
 
 static char* GenStatementName(ConnectionData* cdata);
-static void UnallocateStatement(PGconn* pgPtr, char* stmtName);
+static void UnallocateStatement(ConnectionData* cdata, char* stmtName);
+static void DeferRelease(Tcl_Obj** listPtr, const char* name);
+static int ExecRelease(ConnectionData* cdata, const char* command,
+		       const char* name, const char* goneState);
+static void RunDeferredDeallocs(ConnectionData* cdata);
+static char* GenCursorName(ConnectionData* cdata);
+static int StatementIsQuery(StatementData* sdata, int withAllowed);
+static int OpenCursor(Tcl_Interp* interp, ResultSetData* rdata,
+		      const char *const* paramValues,
+		      const int* paramLengths, const int* paramFormats);
+static int FetchCursorBatch(Tcl_Interp* interp, ResultSetData* rdata);
+static void CloseCursor(ConnectionData* cdata, const char* cursorName,
+			Tcl_WideInt cursorXact);
 static StatementData* NewStatement(ConnectionData* cdata);
 static PGresult* PrepareStatement(Tcl_Interp* interp,
 				  StatementData* sdata, char* stmtName);
+static ColumnDecoder* BinaryDecoderForType(Oid type);
+static int BinaryResultsWanted(StatementData* sdata);
+static void LearnEnumTypes(ConnectionData* cdata, StatementData* sdata);
+static int IsEnumType(ConnectionData* cdata, Oid type);
+static void SetupInterning(ResultSetData* rdata, int intern);
+static Tcl_Obj* InternCell(ResultSetData* rdata, int column,
+			   const char* value, int length);
+static Tcl_WideUInt GetNetworkOrder(const char* buffer, int n);
+static Tcl_Obj* DecodeText(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeBool(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeInt2(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeInt4(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeOid(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeInt8(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeFloat4(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeFloat8(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeNumeric(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeDate(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeTimestamp(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeUuid(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeBytea(const char* buffer, int buffSize);
+static Tcl_Obj* DecodeByteaText(const char* buffer, int buffSize);
+static int FormatFloat(char* text, double value, int isFloat4);
+static int ParseDecimal(const char* s, char* digits, int* nDigitsPtr);
+static int FloatReadsBack(const char* digits, int nDigits, int exponent,
+			  double value, int isFloat4);
+static int FormatIsoDate(char* text, Tcl_WideInt days, int* yearPtr);
+static int FormatDigits(char* text, int value, int width);
+static void PutNetworkOrder(char* buffer, Tcl_WideUInt u, int n);
+static int ParseIsoDate(const char** sPtr, int* daysPtr);
+static int ParseIsoTimestamp(const char* s, Tcl_WideInt* usecPtr);
+static char* EncodeNumeric(const char* s, int* lengthPtr);
+static int EncodeBinaryParam(ConnectionData* cdata, Oid type,
+			     Tcl_Obj* valueObj, char** bufferPtr,
+			     int* lengthPtr);
+static Oid ArrayElementType(Oid arrayOid);
+static char* EncodeArrayParam(ConnectionData* cdata, Oid elementType,
+			      Tcl_Obj* valueObj, int* lengthPtr,
+			      int* formatPtr);
+static int BlobCmd(ClientData clientData, Tcl_Interp* interp,
+		   int objc, Tcl_Obj *const objv[]);
+static BlobTable* GetBlobTable(Tcl_Interp* interp, int create);
+static void DeleteBlobTable(ClientData clientData, Tcl_Interp* interp);
+static void BlobChannelClosed(ClientData clientData);
+static BlobHandle* FindBlobHandle(Tcl_Interp* interp, Tcl_Obj* objPtr);
+static Tcl_Channel GetBlobChannel(Tcl_Interp* interp, Tcl_Obj* blobObj);
+static int ReadBlobChunk(Tcl_Interp* interp, Tcl_Channel chan, char* buffer);
+static char* ReadBlobParam(Tcl_Interp* interp, ConnectionData* cdata,
+			   Tcl_Obj* blobObj,
+			   int* lengthPtr);
+static int WriteBlobParam(Tcl_Interp* interp, ConnectionData* cdata,
+			  Tcl_Obj* blobObj, Oid* oidPtr);
+static char* GetParamScratch(StatementData* sdata);
+static void ReleaseParamScratch(StatementData* sdata, char* scratch);
+static void GetParamTables(StatementData* sdata, ParamTables* tables);
+static int MarshalParams(Tcl_Interp* interp, StatementData* sdata,
+			 Tcl_Obj* paramDict, Tcl_Obj* const* positionalv,
+			 ParamTables* tables);
+static void FreeParamValues(StatementData* sdata, ParamTables* tables);
+static int AcquireStatementName(Tcl_Interp* interp, StatementData* sdata,
+				char** stmtNamePtr);
+static void ReleaseStatementName(StatementData* sdata, char* stmtName);
+static DecodePlan* NewDecodePlan(StatementData* sdata, PGresult* res);
+static DecodePlan* StatementPlan(StatementData* sdata, PGresult* res);
+static void DeleteDecodePlan(DecodePlan* plan);
+static Tcl_Obj* DecodeRow(ResultSetData* rdata, int row, int lists,
+			  Tcl_Obj** literals);
+static int FillRow(ResultSetData* rdata, int row, int lists,
+		   Tcl_Obj** literals);
+static Tcl_Obj* DecodeCell(ResultSetData* rdata, int row, int column);
+static int BindRowVars(Tcl_Interp* interp, ResultSetData* rdata,
+		       int objc, Tcl_Obj *const objv[]);
+static int ResultSetNextvarsMethod(ClientData clientData, Tcl_Interp* interp,
+				   Tcl_ObjectContext context,
+				   int objc, Tcl_Obj *const objv[]);
+static int CheckRandomAccess(Tcl_Interp* interp, ResultSetData* rdata);
+static int GetRowNumberFromObj(Tcl_Interp* interp, ResultSetData* rdata,
+			       Tcl_Obj* obj, int maxRow, int* rowPtr);
+static int ResultSetRowatMethod(ClientData clientData, Tcl_Interp* interp,
+				Tcl_ObjectContext context,
+				int objc, Tcl_Obj *const objv[]);
+static int ResultSetSeekMethod(ClientData clientData, Tcl_Interp* interp,
+			       Tcl_ObjectContext context,
+			       int objc, Tcl_Obj *const objv[]);
+static int ResultSetSliceMethod(ClientData clientData, Tcl_Interp* interp,
+				Tcl_ObjectContext context,
+				int objc, Tcl_Obj *const objv[]);
+static int UpdateRowInPlace(PerInterpData* pidata, Tcl_Obj* rowObj,
+			    int lists, int n, Tcl_Obj** cells);
+static Tcl_Obj* NewLazyCell(ResultSetData* rdata, const char* value);
+static void ReleaseExecResult(ResultSetData* rdata);
+static int ParseRowOptions(Tcl_Interp* interp, int objc,
+			   Tcl_Obj *const objv[], int nArgs,
+			   int* listsPtr, Tcl_Obj** columnsVarPtr);
+static int CollectRows(Tcl_Interp* interp, ResultSetData* rdata,
+		       int lists, int maxRows, Tcl_Obj** literals,
+		       Tcl_Obj** rowsPtr);
+static int ResultSetAllcolumnsMethod(ClientData clientData,
+				     Tcl_Interp* interp,
+				     Tcl_ObjectContext context,
+				     int objc, Tcl_Obj *const objv[]);
+static int ResultSetAllrowsMethod(ClientData clientData, Tcl_Interp* interp,
+				  Tcl_ObjectContext context,
+				  int objc, Tcl_Obj *const objv[]);
+static int ResultSetNextrowsMethod(ClientData clientData, Tcl_Interp* interp,
+				   Tcl_ObjectContext context,
+				   int objc, Tcl_Obj *const objv[]);
 static Tcl_Obj* ResultDescToTcl(PGresult* resultDesc, int flags);
 static int StatementConstructor(ClientData clientData, Tcl_Interp* interp,
 				Tcl_ObjectContext context,
@@ -536,6 +1134,41 @@ static int StatementParamtypeMethod(ClientData clientData, Tcl_Interp* interp,
 static int StatementParamsMethod(ClientData clientData, Tcl_Interp* interp,
 				 Tcl_ObjectContext context,
 				 int objc, Tcl_Obj *const objv[]);
+static int StatementBindMethod(ClientData clientData, Tcl_Interp* interp,
+			       Tcl_ObjectContext context,
+			       int objc, Tcl_Obj *const objv[]);
+static int StatementExecutemanyMethod(ClientData clientData,
+				      Tcl_Interp* interp,
+				      Tcl_ObjectContext context,
+				      int objc, Tcl_Obj *const objv[]);
+static int CheckManyBlobs(Tcl_Interp* interp, StatementData* sdata,
+			  int nSets, Tcl_Obj *const sets[], int positional);
+static int MarshalParamSet(Tcl_Interp* interp, StatementData* sdata,
+			   Tcl_Obj* setObj, int positional, int setNum,
+			   ParamTables* tables);
+static void AppendRowcount(ConnectionData* cdata, Tcl_Obj* countsObj,
+			   PGresult* res);
+static int ExecuteManySerially(Tcl_Interp* interp, StatementData* sdata,
+			       char* stmtName, ParamTables* tables,
+			       int nSets, Tcl_Obj *const sets[],
+			       int positional, int ownTransaction,
+			       Tcl_Obj* countsObj);
+static int ExecuteManyPipelined(Tcl_Interp* interp, StatementData* sdata,
+				char* stmtName, ParamTables* tables,
+				int nSets, Tcl_Obj *const sets[],
+				int positional, int ownTransaction,
+				Tcl_Obj* countsObj);
+static int ReadPipelineBatch(Tcl_Interp* interp, ConnectionData* cdata,
+			     int leading, int first, int nSent,
+			     Tcl_Obj* countsObj, int status);
+static int BoundStatementCmd(ClientData clientData, Tcl_Interp* interp,
+			     int objc, Tcl_Obj *const objv[]);
+static void DeleteBoundStatement(ClientData clientData);
+static void DeleteBoundCommands(ClientData clientData);
+static int CloneBoundCommands(Tcl_Interp* interp, ClientData oldClientData,
+			      ClientData* newClientData);
+static int CheckPositionalCount(Tcl_Interp* interp, StatementData* sdata,
+				int count);
 static void DeleteStatementMetadata(ClientData clientData);
 static void DeleteStatement(StatementData* sdata);
 static int CloneStatement(Tcl_Interp* interp, ClientData oldClientData,
@@ -544,6 +1177,13 @@ static int CloneStatement(Tcl_Interp* interp, ClientData oldClientData,
 static int ResultSetConstructor(ClientData clientData, Tcl_Interp* interp,
 				Tcl_ObjectContext context,
 				int objc, Tcl_Obj *const objv[]);
+static ResultSetData* NewResultSet(StatementData* sdata, int fetchMode,
+				   int chunkSize, int withHold,
+				   int cancelOnClose, int reuse);
+static int ExecuteResultSet(Tcl_Interp* interp, ResultSetData* rdata,
+			    Tcl_Obj* paramDict, Tcl_Obj* const* positionalv,
+			    Tcl_WideInt spillThreshold, int intern);
+static Tcl_Obj* ResultSetRowcount(ResultSetData* rdata);
 static int ResultSetColumnsMethod(ClientData clientData, Tcl_Interp* interp,
 				  Tcl_ObjectContext context,
 				  int objc, Tcl_Obj *const objv[]);
@@ -553,6 +1193,32 @@ static int ResultSetNextrowMethod(ClientData clientData, Tcl_Interp* interp,
 static int ResultSetRowcountMethod(ClientData clientData, Tcl_Interp* interp,
 				   Tcl_ObjectContext context,
 				   int objc, Tcl_Obj *const objv[]);
+static int ReadStreamBatch(Tcl_Interp* interp, ResultSetData* rdata);
+static void FinishStream(ResultSetData* rdata);
+static int SpoolResult(Tcl_Interp* interp, ResultSetData* rdata,
+		       Tcl_WideInt threshold);
+static void SpoolAppend(ResultSpool* spool, const void* data, size_t n);
+static int FlushSpool(Tcl_Interp* interp, ResultSpool* spool);
+static int LoadSpoolBatch(Tcl_Interp* interp, ResultSetData* rdata,
+			  int batch);
+static void DeleteSpool(ResultSpool* spool);
+static size_t ResultMemorySize(const PGresult* res);
+static int CheckResultLimit(Tcl_Interp* interp, ResultSetData* rdata,
+			    Tcl_WideInt size);
+static void CancelQuery(ConnectionData* cdata);
+static void DiscardRows(ResultSetData* rdata);
+static int ResultSetNextresultsMethod(ClientData clientData,
+				      Tcl_Interp* interp,
+				      Tcl_ObjectContext context,
+				      int objc, Tcl_Obj *const objv[]);
+static int ResultSetMemoryMethod(ClientData clientData, Tcl_Interp* interp,
+				 Tcl_ObjectContext context,
+				 int objc, Tcl_Obj *const objv[]);
+static int ResultSetRowTotal(ResultSetData* rdata);
+static int LocateRow(Tcl_Interp* interp, ResultSetData* rdata, int absRow,
+		     int* rowPtr);
+static int ResultSetCurrentRow(Tcl_Interp* interp, ResultSetData* rdata,
+			       int* rowPtr);
 static void DeleteResultSetMetadata(ClientData clientData);
 static void DeleteResultSet(ResultSetData* rdata);
 static int CloneResultSet(Tcl_Interp* interp, ClientData oldClientData,
@@ -601,6 +1267,17 @@ const static Tcl_ObjectMetadataType statementDataType = {
 				 * 'cuz statements aren't clonable */
 };
 
+/* Metadata type that holds the commands bound to a statement object */
+
+const static Tcl_ObjectMetadataType boundCommandsDataType = {
+    TCL_OO_METADATA_VERSION_CURRENT,
+				/* version */
+    "BoundCommands",		/* name */
+    DeleteBoundCommands,	/* deleteProc */
+    CloneBoundCommands		/* cloneProc - a copy of the statement
+				 * has no bound commands */
+};
+
 /* Metadata type for result set data */
 
 const static Tcl_ObjectMetadataType resultSetDataType = {
@@ -650,11 +1327,101 @@ const static Tcl_MethodType ResultSetRowcountMethodType = {
     NULL			/* cloneProc */
 };
 
+const static Tcl_MethodType ResultSetAllcolumnsMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "allcolumns",		/* name */
+    ResultSetAllcolumnsMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetAllrowsMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "allrows",			/* name */
+    ResultSetAllrowsMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetMemoryMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "memory",			/* name */
+    ResultSetMemoryMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetNextresultsMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "nextresults",		/* name */
+    ResultSetNextresultsMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetNextvarsMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "nextvars",			/* name */
+    ResultSetNextvarsMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetNextrowsMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "nextrows",			/* name */
+    ResultSetNextrowsMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetRowatMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "rowat",			/* name */
+    ResultSetRowatMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetSeekMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "seek",			/* name */
+    ResultSetSeekMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType ResultSetSliceMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "slice",			/* name */
+    ResultSetSliceMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
 /* Methods to create on the result set class */
 
 const static Tcl_MethodType* ResultSetMethods[] = {
+    &ResultSetAllcolumnsMethodType,
+    &ResultSetAllrowsMethodType,
     &ResultSetColumnsMethodType,
+    &ResultSetMemoryMethodType,
+    &ResultSetNextresultsMethodType,
+    &ResultSetNextrowsMethodType,
+    &ResultSetNextvarsMethodType,
+    &ResultSetRowatMethodType,
     &ResultSetRowcountMethodType,
+    &ResultSetSeekMethodType,
+    &ResultSetSliceMethodType,
     NULL
 };
 
@@ -723,6 +1490,15 @@ const static Tcl_MethodType ConnectionRollbackMethodType = {
     NULL			/* cloneProc */
 };
 
+const static Tcl_MethodType ConnectionPipelineMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "pipeline",			/* name */
+    ConnectionPipelineMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
 const static Tcl_MethodType ConnectionTablesMethodType = {
     TCL_OO_METHOD_VERSION_CURRENT,
 				/* version */
@@ -759,6 +1535,7 @@ const static Tcl_MethodType* ConnectionMethods[] = {
     &ConnectionTablesMethodType,
     &ConnectionDetachMethodType,
     &ConnectionConnectedMethodType,
+    &ConnectionPipelineMethodType,
     NULL
 };
 
@@ -782,6 +1559,24 @@ const static Tcl_MethodType StatementParamsMethodType = {
     NULL			/* cloneProc */
 };
 
+const static Tcl_MethodType StatementBindMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "bind",			/* name */
+    StatementBindMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
+const static Tcl_MethodType StatementExecutemanyMethodType = {
+    TCL_OO_METHOD_VERSION_CURRENT,
+				/* version */
+    "executemany",		/* name */
+    StatementExecutemanyMethod,	/* callProc */
+    NULL,			/* deleteProc */
+    NULL			/* cloneProc */
+};
+
 const static Tcl_MethodType StatementParamtypeMethodType = {
     TCL_OO_METHOD_VERSION_CURRENT,
 				/* version */
@@ -796,6 +1591,8 @@ const static Tcl_MethodType StatementParamtypeMethodType = {
  */
 
 const static Tcl_MethodType* StatementMethods[] = {
+    &StatementBindMethodType,
+    &StatementExecutemanyMethodType,
     &StatementParamsMethodType,
     &StatementParamtypeMethodType,
     NULL
@@ -832,6 +1629,31 @@ Tcl_ObjType pgStatementType = {
     NULL			/* setFromAnyProc - we don't register this type */
 };
 
+/*
+ * Tcl_ObjType of the values of text columns in rows, whose string
+ * representation is copied out of the PGresult only when it is first
+ * needed:
+ *
+ * twoPtrValue
+ *	.ptr1 = ResultBuffer* holding the PGresult; ptr1 owns a ref on the
+ *		ResultBuffer until the string representation is made, and is
+ *		NULL afterward
+ *	.ptr2 = const char* NUL-terminated text of the value in the PGresult
+ */
+
+static void FreeLazyCell(Tcl_Obj* obj);
+static void DupLazyCell(Tcl_Obj* src, Tcl_Obj* dup);
+static void UpdateStringOfLazyCell(Tcl_Obj* obj);
+
+Tcl_ObjType lazyCellType = {
+    "pgLazyCell",		/* name */
+    FreeLazyCell,		/* freeIntRepProc */
+    DupLazyCell,		/* dupIntRepProc */
+    UpdateStringOfLazyCell,	/* updateStringProc */
+    NULL			/* setFromAnyProc - we don't register this type */
+};
+
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -1015,95 +1837,214 @@ static int TransferResultError(
 /*
  *-----------------------------------------------------------------------------
  *
- * DeterminePostgresMajorVersion --
+ * CheckConnectionAvailable --
  *
- *	Determine the major version of the PostgreSQL server at the
- *	other end of a connection.
+ *	Makes sure that no result set is streaming rows over a connection,
+ *	and no batch is being executed on it, before another command is
+ *	sent on it.
  *
  * Results:
- *	Returns a standard Tcl error code.
+ *	TCL_OK if the connection is free for use, otherwise TCL_ERROR.
  *
  * Side effects:
- *	Stores the version number in '*versionPtr' if successful.
+ *	Sets the interpreter result and error code if the connection is
+ *	busy.
+ *
+ * libpq admits only one command in progress per connection, so a result
+ * set in the 'stream' fetch mode must be read to the end, or closed,
+ * before anything else can be done with the connection.
  *
  *-----------------------------------------------------------------------------
  */
 
 static int
-DeterminePostgresMajorVersion(Tcl_Interp* interp,
-				/* Tcl interpreter */
-			      ConnectionData* cdata,
-				/* Connection data */
-			      int* versionPtr)
-				/* OUTPUT: PostgreSQL server version */
-{
-    PGresult* res;		/* Result of a Postgres query */
-    int status = TCL_ERROR;	/* Status return */
-    char* versionStr;		/* Version information from server */
-
-    if (ExecSimpleQuery(interp, cdata->pgPtr,
-			"SELECT version()", &res) == TCL_OK) {
-	versionStr = PQgetvalue(res, 0, 0);
-	if (sscanf(versionStr, " PostgreSQL %d", versionPtr) == 1) {
-	    status = TCL_OK;
-	} else {
-	    Tcl_Obj* result = Tcl_NewStringObj("unable to parse PostgreSQL "
-					       "version: \"", -1);
-	    Tcl_AppendToObj(result, versionStr, -1);
-	    Tcl_AppendToObj(result, "\"", -1);
-	    Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
-			     "POSTGRES", "-1", NULL);
-	}
-	PQclear(res);
+CheckConnectionAvailable(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ConnectionData* cdata	/* Connection data */
+) {
+    if (cdata->streamOwner != NULL) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("connection is busy "
+						  "streaming the rows of "
+						  "another result set", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY010",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
     }
-    return status;
+    if (cdata->flags & CONN_FLAG_BATCH) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("connection is busy "
+						  "executing a batch", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY010",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+    return TCL_OK;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * QueryConnectionOption --
+ * CheckConnectionIdle --
  *
- *	Determine the current value of a connection option.
+ *	Makes sure that a connection can take a command and wait for its
+ *	reply.
  *
  * Results:
- *	Returns a Tcl object containing the value if successful, or NULL
- *	if unsuccessful. If unsuccessful, stores error information in the
- *	Tcl interpreter.
+ *	TCL_OK if the connection is free for use, otherwise TCL_ERROR.
+ *
+ * Side effects:
+ *	Synchronizes the statements queued in a pipeline, if any, since
+ *	a command that waits for its reply cannot be sent in pipeline
+ *	mode, and retries releases that had to wait for the connection.
+ *	Sets the interpreter result and error code if the connection is
+ *	busy.
  *
  *-----------------------------------------------------------------------------
  */
 
-static Tcl_Obj*
-QueryConnectionOption (
-    ConnectionData* cdata,	/* Connection data */
+static int
+CheckConnectionIdle(
     Tcl_Interp* interp,		/* Tcl interpreter */
-    int optionNum		/* Position of the option in the table */
+    ConnectionData* cdata	/* Connection data */
 ) {
-    PerInterpData* pidata = cdata->pidata; /* Per-interpreter data */
-    Tcl_Obj** literals = pidata->literals;
-    char * value;		/* Return value as C string */
-
-    /* Suppress attempts to query the password */
-    if (ConnOptions[optionNum].info == INDX_PASS) {
-	return Tcl_NewObj();
+    if (CheckConnectionAvailable(interp, cdata) != TCL_OK
+	|| SyncPipeline(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
     }
-    if (ConnOptions[optionNum].type == TYPE_ENCODING) {
-	value = (char* )pg_encoding_to_char(PQclientEncoding(cdata->pgPtr));
-	return Tcl_NewStringObj(value, -1);
+    if (PQtransactionStatus(cdata->pgPtr) == PQTRANS_IDLE) {
+	++cdata->xactCounter;
     }
+    RunDeferredDeallocs(cdata);
+    return TCL_OK;
+}
 
-    if (ConnOptions[optionNum].type == TYPE_ISOLATION) {
-	if (cdata->isolation == ISOL_NONE) {
-	    PGresult * res;
-	    char * isoName;
-	    int i = 0;
-
-	    /* The isolation level wasn't set - get default value */
-
-	    if (ExecSimpleQuery(interp, cdata->pgPtr,
-		    "SHOW default_transaction_isolation", &res) != TCL_OK) {
-		return NULL;
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetChunkSizeFromObj --
+ *
+ *	Parses the value of a -chunksize option.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Stores the chunk size in '*chunkSizePtr' if successful, otherwise
+ *	leaves an error message in the interpreter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+GetChunkSizeFromObj(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_Obj* obj,		/* Value of the option */
+    int* chunkSizePtr		/* OUTPUT: Number of rows per chunk */
+) {
+    int chunkSize;
+
+    if (Tcl_GetIntFromObj(interp, obj, &chunkSize) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (chunkSize < 0) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("chunk size must be "
+						  "a non-negative integer",
+						  -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+    *chunkSizePtr = chunkSize;
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetByteCountFromObj --
+ *
+ *	Parses the value of an option that is a number of bytes, such as
+ *	-spillthreshold or -maxresultbytes.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Stores the number in '*countPtr' if successful, otherwise leaves an
+ *	error message, which names the option as 'what', in the
+ *	interpreter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+GetByteCountFromObj(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_Obj* obj,		/* Value of the option */
+    const char* what,		/* Description of the option */
+    Tcl_WideInt* countPtr	/* OUTPUT: Number of bytes */
+) {
+    Tcl_WideInt count;
+
+    if (Tcl_GetWideIntFromObj(interp, obj, &count) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (count < 0) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "%s must be a non-negative integer", what));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+    *countPtr = count;
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * QueryConnectionOption --
+ *
+ *	Determine the current value of a connection option.
+ *
+ * Results:
+ *	Returns a Tcl object containing the value if successful, or NULL
+ *	if unsuccessful. If unsuccessful, stores error information in the
+ *	Tcl interpreter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj*
+QueryConnectionOption (
+    ConnectionData* cdata,	/* Connection data */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    int optionNum		/* Position of the option in the table */
+) {
+    PerInterpData* pidata = cdata->pidata; /* Per-interpreter data */
+    Tcl_Obj** literals = pidata->literals;
+    char * value;		/* Return value as C string */
+
+    /* Suppress attempts to query the password */
+    if (ConnOptions[optionNum].info == INDX_PASS) {
+	return Tcl_NewObj();
+    }
+    if (ConnOptions[optionNum].type == TYPE_ENCODING) {
+	value = (char* )pg_encoding_to_char(PQclientEncoding(cdata->pgPtr));
+	return Tcl_NewStringObj(value, -1);
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_ISOLATION) {
+	if (cdata->isolation == ISOL_NONE) {
+	    PGresult * res;
+	    char * isoName;
+	    int i = 0;
+
+	    /* The isolation level wasn't set - get default value */
+
+	    if (SyncPipeline(interp, cdata) != TCL_OK
+		|| ExecSimpleQuery(interp, cdata->pgPtr,
+		    "SHOW default_transaction_isolation", &res) != TCL_OK) {
+		return NULL;
 	    }
 	    value = PQgetvalue(res, 0, 0);
 	    isoName = (char*) ckalloc(strlen(value) + 1);
@@ -1148,6 +2089,38 @@ QueryConnectionOption (
 	}
     }
 
+    if (ConnOptions[optionNum].type == TYPE_FETCHMODE) {
+	return Tcl_NewStringObj(FetchModes[cdata->fetchMode], -1);
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_CHUNKSIZE) {
+	return Tcl_NewWideIntObj(cdata->chunkSize);
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_WITHHOLD) {
+	return literals[cdata->withHold ? LIT_1 : LIT_0];
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_INTERN) {
+	return literals[cdata->intern ? LIT_1 : LIT_0];
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_SPILLTHRESHOLD) {
+	return Tcl_NewWideIntObj(cdata->spillThreshold);
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_MAXRESULTBYTES) {
+	return Tcl_NewWideIntObj(cdata->maxResultBytes);
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_MAXBLOBBYTES) {
+	return Tcl_NewWideIntObj(cdata->maxBlobBytes);
+    }
+
+    if (ConnOptions[optionNum].type == TYPE_CANCELONCLOSE) {
+	return literals[cdata->cancelOnClose ? LIT_1 : LIT_0];
+    }
+
     if (ConnOptions[optionNum].queryF != NULL) {
 	value = ConnOptions[optionNum].queryF(cdata->pgPtr);
 	if (value != NULL) {
@@ -1200,16 +2173,25 @@ ConfigureConnection(
     char * encoding = NULL;	/* Selected encoding name */
     int isolation = ISOL_NONE;	/* Isolation level */
     int readOnly = -1;		/* Read only indicator */
+    int fetchMode = FETCH_NONE;	/* Default fetch mode */
+    int chunkSize = -1;		/* Default chunk size */
+    int withHold = -1;		/* Default for holding cursors */
+    int intern = -1;		/* Default for interning text values */
+    Tcl_WideInt spillThreshold = -1;
+				/* Default threshold for spilling results */
+    Tcl_WideInt maxResultBytes = -1;
+				/* Limit on the memory held by a result */
+    Tcl_WideInt maxBlobBytes = -1;
+				/* Limit on the contents of a channel */
+    int cancelOnClose = -1;	/* Default for cancelling abandoned
+				 * streams */
 #define CONNINFO_LEN 1000
     char connInfo[CONNINFO_LEN]; /* Configuration string for PQconnectdb() */
 
     Tcl_Obj* retval;
     Tcl_Obj* optval;
-    int vers;			/* PostgreSQL major version */
     Tcl_HashEntry* he = NULL;
     int res = TCL_OK;
-    int isNew = 0;
-				/* Is this a new connection? */
     ConnectionData* detachedcdata = NULL;
     				/* The detached connection data we retrieved
 				 * from DetachedConnections
@@ -1331,6 +2313,58 @@ ConfigureConnection(
 		return TCL_ERROR;
 	    }
 	    break;
+	case TYPE_FETCHMODE:
+	    if (Tcl_GetIndexFromObjStruct(interp, objv[i+1], FetchModes,
+					  sizeof(char *), "fetch mode",
+					  TCL_EXACT, &fetchMode) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_CHUNKSIZE:
+	    if (GetChunkSizeFromObj(interp, objv[i+1], &chunkSize) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_WITHHOLD:
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &withHold)
+		!= TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_INTERN:
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &intern)
+		!= TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_REUSE:
+	case TYPE_POSITIONAL:
+	    /* Accepted only by the result set constructor */
+	    break;
+	case TYPE_SPILLTHRESHOLD:
+	    if (GetByteCountFromObj(interp, objv[i+1], "spill threshold",
+				    &spillThreshold) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_MAXRESULTBYTES:
+	    if (GetByteCountFromObj(interp, objv[i+1], "result size limit",
+				    &maxResultBytes) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_MAXBLOBBYTES:
+	    if (GetByteCountFromObj(interp, objv[i+1], "blob size limit",
+				    &maxBlobBytes) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_CANCELONCLOSE:
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &cancelOnClose)
+		!= TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
 	case TYPE_ATTACH:
 	    /* TODO: Don't allow this in safe interps */
 	    /* If -attach is given, it must be the only option */
@@ -1380,8 +2414,6 @@ ConfigureConnection(
     }
 
     if (cdata->pgPtr == NULL) {
-	isNew = 1;
-
 	cdata->statements = ckalloc(sizeof(Tcl_HashTable));
 	Tcl_InitHashTable(cdata->statements, TCL_STRING_KEYS);
 	DBG("Init cdata %s ->statements %s\n", name(cdata), name(cdata->statements));
@@ -1418,6 +2450,40 @@ ConfigureConnection(
 	PQsetNoticeProcessor(cdata->pgPtr, DummyNoticeProcessor, NULL);
     }
 
+    /* Fetch mode defaults for result sets */
+
+    if (fetchMode != FETCH_NONE) {
+	cdata->fetchMode = fetchMode;
+    }
+    if (chunkSize != -1) {
+	cdata->chunkSize = chunkSize;
+    }
+    if (withHold != -1) {
+	cdata->withHold = withHold;
+    }
+    if (intern != -1) {
+	cdata->intern = intern;
+    }
+    if (spillThreshold != -1) {
+	cdata->spillThreshold = spillThreshold;
+    }
+    if (maxResultBytes != -1) {
+	cdata->maxResultBytes = maxResultBytes;
+    }
+    if (maxBlobBytes != -1) {
+	cdata->maxBlobBytes = maxBlobBytes;
+    }
+    if (cancelOnClose != -1) {
+	cdata->cancelOnClose = cancelOnClose;
+    }
+
+    /* The remaining settings need to talk to the server */
+
+    if ((encoding != NULL || isolation != ISOL_NONE || readOnly != -1)
+	&& CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
     /* Character encoding */
 
     if (encoding != NULL ) {
@@ -1455,27 +2521,6 @@ ConfigureConnection(
 	cdata->readOnly = readOnly;
     }
 
-    if (isNew) {
-	/* Determine the PostgreSQL version in use */
-
-	if (DeterminePostgresMajorVersion(interp, cdata, &vers) != TCL_OK) {
-	    return TCL_ERROR;
-	}
-
-	/*
-	* On PostgreSQL 9.0 and later, change 'bytea_output' to the
-	* backward-compatible 'escape' setting, so that the code in
-	* ResultSetNextrowMethod will retrieve byte array values correctly
-	* on either 8.x or 9.x servers.
-	*/
-	if (vers >= 9) {
-	    if (ExecSimpleQuery(interp, cdata->pgPtr,
-				"SET bytea_output = 'escape'", NULL) != TCL_OK) {
-		return TCL_ERROR;
-	    }
-	}
-    }
-
     return TCL_OK;
 }
 
@@ -1526,6 +2571,22 @@ ConnectionConstructor(
     cdata->isolation = ISOL_NONE;
     cdata->readOnly = 0;
     cdata->statements = NULL;
+    cdata->fetchMode = FETCH_MATERIALIZE;
+    cdata->chunkSize = 0;
+    cdata->withHold = 0;
+    cdata->intern = 0;
+    cdata->spillThreshold = 0;
+    cdata->maxResultBytes = 0;
+    cdata->maxBlobBytes = 0;
+    cdata->cancelOnClose = 0;
+    cdata->enumTypes = NULL;
+    cdata->streamOwner = NULL;
+    cdata->deferredDeallocs = NULL;
+    cdata->deferredCloses = NULL;
+    cdata->xactCounter = 0;
+    cdata->pipelineHead = NULL;
+    cdata->pipelineTail = NULL;
+    cdata->pipelineFailure = NULL;
     IncrPerInterpRefCount(pidata);
     Tcl_ObjectSetMetadata(thisObject, &connectionDataType, (ClientData) cdata);
 
@@ -1686,6 +2747,9 @@ ConnectionBegintransactionMethod(
 			 "POSTGRES", "-1", NULL);
 	return TCL_ERROR;
     }
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
    cdata->flags |= CONN_FLAG_IN_XCN;
 
    /* Execute begin trasnaction block command */
@@ -1745,6 +2809,10 @@ ConnectionCommitMethod(
 	return TCL_ERROR;
     }
 
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
     cdata->flags &= ~ CONN_FLAG_IN_XCN;
 
     /* Execute commit SQL command */
@@ -1803,6 +2871,11 @@ ConnectionColumnsMethod(
 
     if (objc < 3 || objc > 4) {
 	Tcl_WrongNumArgs(interp, 2, objv, "table ?pattern?");
+	Tcl_DecrRefCount(sqlQuery);
+	return TCL_ERROR;
+    }
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	Tcl_DecrRefCount(sqlQuery);
 	return TCL_ERROR;
     }
 
@@ -1999,6 +3072,7 @@ ConnectionRollbackMethod(
     ConnectionData* cdata = (ConnectionData*)
 	Tcl_ObjectGetMetadata(thisObject, &connectionDataType);
 				/* Instance data */
+    int status;
 
     /* Check parameters */
 
@@ -2017,10 +3091,20 @@ ConnectionRollbackMethod(
 	return TCL_ERROR;
     }
 
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
     cdata->flags &= ~CONN_FLAG_IN_XCN;
 
-    /* Send end transaction SQL command */
-    return ExecSimpleQuery(interp, cdata->pgPtr, "ROLLBACK", NULL);
+    /*
+     * Send end transaction SQL command. Releases that the failed
+     * transaction held back can be made now.
+     */
+
+    status = ExecSimpleQuery(interp, cdata->pgPtr, "ROLLBACK", NULL);
+    RunDeferredDeallocs(cdata);
+    return status;
 }
 
 /*
@@ -2073,6 +3157,11 @@ ConnectionTablesMethod(
 
     if (objc < 2 || objc > 3) {
 	Tcl_WrongNumArgs(interp, 2, objv, "");
+	Tcl_DecrRefCount(sqlQuery);
+	return TCL_ERROR;
+    }
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	Tcl_DecrRefCount(sqlQuery);
 	return TCL_ERROR;
     }
 
@@ -2216,6 +3305,13 @@ FreezeStatement(
     FreezeTclObj(&sdata->nativeSql);
     FreezeTclObj(&sdata->columnNames);
 
+    /* The decoding plan holds Tcl_Objs too; the next execution remakes it */
+
+    if (sdata->plan != NULL) {
+	DecrDecodePlanRefCount(sdata->plan);
+	sdata->plan = NULL;
+    }
+
     /* cdata will be in a new location when we thaw */
 
     DecrConnectionRefCount(sdata->cdata);
@@ -2337,6 +3433,21 @@ ConnectionDetachMethod(
 	goto finally;
     }
 
+    /* The statements of a running pipeline cannot be frozen */
+
+    if (cdata->flags & CONN_FLAG_PIPELINE) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("connection is busy "
+						  "running a pipeline", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY010",
+			 "POSTGRES", "-1", NULL);
+	res = TCL_ERROR;
+	goto finally;
+    }
+    res = SyncPipeline(interp, cdata);
+    if (res != TCL_OK) {
+	goto finally;
+    }
+
     DBG(" ***> Detach %s, cdata: %s *** \n", name(thisObject), name(cdata));
 
     /* Find our associated prepared statements */
@@ -2574,6 +3685,13 @@ ConnectionConnectedMethod(
 
     if (PQstatus(cdata->pgPtr) != CONNECTION_OK) {
 	connected = 0;
+    } else if (cdata->streamOwner != NULL
+	       || (cdata->flags & CONN_FLAG_PIPELINE_MODE)) {
+	/*
+	 * Rows are arriving, or statements are queued, so the server is
+	 * evidently there
+	 */
+	connected = 1;
     } else {
 	res = PQexec(cdata->pgPtr, "");
 	connected = (PQresultStatus(res) == PGRES_EMPTY_QUERY);
@@ -2584,61 +3702,475 @@ ConnectionConnectedMethod(
 
     return TCL_OK;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * DeleteConnectionMetadata, DeleteConnection --
+ * ConnectionPipelineMethod --
  *
- *	Cleans up when a database connection is deleted.
+ *	Evaluates a script with the statements that it executes sent to
+ *	the server without waiting for their results.
+ *
+ * Usage:
+ *	$connection pipeline script
  *
  * Results:
- *	None.
+ *	Returns the result of the script. If the script succeeds but a
+ *	statement that it executed failed, and the failure has not been
+ *	reported through the statement's result set, reports the first
+ *	such failure.
  *
  * Side effects:
- *	Terminates the connection and frees all system resources associated
- *	with it.
+ *	Result sets made while the script runs, whose results can be read
+ *	whole with PQexecPrepared's single request, are queued on the
+ *	connection in libpq's pipeline mode. The queue is synchronized,
+ *	and the result sets are filled in, when one of them is first
+ *	used, when a command that needs a reply of its own is sent, and
+ *	when the script ends. Without pipeline mode in the client library,
+ *	the script runs with each statement executed at once.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-DeleteConnectionMetadata(
-    ClientData clientData	/* Instance data for the connection */
+static int
+ConnectionPipelineMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext objectContext, /* Object context */
+    int objc,			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
 ) {
-    DecrConnectionRefCount((ConnectionData*)clientData);
-}
+    Tcl_Object thisObject = Tcl_ObjectContextObject(objectContext);
+				/* The current connection object */
+    ConnectionData* cdata = (ConnectionData*)
+	Tcl_ObjectGetMetadata(thisObject, &connectionDataType);
+				/* Instance data */
+    Tcl_InterpState state;	/* Result of a failed script */
+    int status;
 
-static void
-DeleteConnection(
-    ConnectionData* cdata	/* Instance data for the connection */
-) {
-    Tcl_HashSearch	search;
-    Tcl_HashEntry*	he = NULL;
+    (void)clientData;
 
-    FDBG("===> Enter DeleteConnection %s\n", name(cdata));
-    if (cdata->statements) {
-	he = Tcl_FirstHashEntry(cdata->statements, &search);
-	if (he) {
-	    StatementData*	sdata = NULL;
-	    int			stillRemain = 0;
+    if (objc != 3) {
+	Tcl_WrongNumArgs(interp, 2, objv, "script");
+	return TCL_ERROR;
+    }
 
-	    do {
-		sdata = Tcl_GetHashValue(he);
-		if (sdata->cdata == NULL) {
-		    /*
-		     * A frozen statement, just free it.  Can arrive here if
-		     * the last pgStatement literal is deleted during
-		     * interpreter exit, causing the cdata refcount to go to 0.
-		     * Destructor should be run but isn't, so we're left with
-		     * frozen statements in cdata->statements.
-		     * cdata->pgPtr is going to be closed anyway, so skip the
-		     * UnallocateStatement step (which would cause problems
-		     * with refcounting cdata)
-		     */
-		    if (sdata->stmtName) {
-			/* NULLing stmtName causes the UnallocateStatement
-			 * to be skipped */
+    /* A nested pipeline is part of the one that contains it */
+
+    if (cdata->flags & CONN_FLAG_PIPELINE) {
+	return Tcl_EvalObjEx(interp, objv[2], 0);
+    }
+
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    IncrConnectionRefCount(cdata);
+    cdata->flags |= CONN_FLAG_PIPELINE;
+    status = Tcl_EvalObjEx(interp, objv[2], 0);
+    cdata->flags &= ~CONN_FLAG_PIPELINE;
+
+    if (status != TCL_OK) {
+
+	/* The script's own result takes precedence over any failure */
+
+	state = Tcl_SaveInterpState(interp, status);
+	SyncPipeline(interp, cdata);
+	status = Tcl_RestoreInterpState(interp, state);
+    } else if (SyncPipeline(interp, cdata) != TCL_OK) {
+	status = TCL_ERROR;
+    } else if (cdata->pipelineFailure != NULL) {
+	status = AwaitPipelinedResult(interp, cdata->pipelineFailure);
+    }
+    if (cdata->pipelineFailure != NULL) {
+	DecrResultSetRefCount(cdata->pipelineFailure);
+	cdata->pipelineFailure = NULL;
+    }
+    DecrConnectionRefCount(cdata);
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CanPipeline --
+ *
+ *	Determines whether the execution of a result set can be queued
+ *	on the connection rather than waited for.
+ *
+ * Results:
+ *	Returns 1 if the result set is being made inside a 'pipeline'
+ *	script, and its statement would be executed with a single request
+ *	whose result is read whole; returns 0 otherwise.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CanPipeline(
+    ResultSetData* rdata,	/* Result set about to be executed */
+    Tcl_WideInt spillThreshold	/* Spill threshold, or -1 for the
+				 * connection's */
+) {
+    StatementData* sdata = rdata->sdata;
+				/* Statement data */
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+
+    if (!(cdata->flags & CONN_FLAG_PIPELINE)
+	|| PQenterPipelineMode == NULL
+	|| sdata->paramTypesChanged) {
+	return 0;
+    }
+    if (spillThreshold == -1) {
+	spillThreshold = cdata->spillThreshold;
+    }
+    switch (rdata->fetchMode) {
+    case FETCH_MATERIALIZE:
+	return (spillThreshold <= 0 && cdata->maxResultBytes <= 0);
+    case FETCH_CURSOR:
+	return !StatementIsQuery(sdata, 1);
+    default:
+	return 0;
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SendPipelined --
+ *
+ *	Queues the execution of a result set's statement on a connection
+ *	in pipeline mode.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Puts the connection in pipeline mode if it is not already, sends
+ *	the statement, and appends the result set, which the queue holds
+ *	a reference to, to the connection's queue.
+ *
+ * The statement's own prepared statement is executed even if another
+ * result set is using it: an execution whose result is read whole is
+ * done with it once the result arrives, and it takes no portal.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+SendPipelined(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set to execute */
+    ParamTables* tables		/* Marshalled parameters */
+) {
+    StatementData* sdata = rdata->sdata;
+				/* Statement data */
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+
+    if (!(cdata->flags & CONN_FLAG_PIPELINE_MODE)) {
+	if (!PQenterPipelineMode(cdata->pgPtr)) {
+	    TransferPostgresError(interp, cdata->pgPtr);
+	    return TCL_ERROR;
+	}
+	cdata->flags |= CONN_FLAG_PIPELINE_MODE;
+    }
+    if (!PQsendQueryPrepared(cdata->pgPtr, sdata->stmtName,
+			     sdata->nParams, tables->values,
+			     tables->lengths, tables->formats,
+			     BinaryResultsWanted(sdata))) {
+	TransferPostgresError(interp, cdata->pgPtr);
+	return TCL_ERROR;
+    }
+    rdata->flags |= RS_FLAG_PENDING;
+    rdata->pipelineNext = NULL;
+    IncrResultSetRefCount(rdata);
+    if (cdata->pipelineTail == NULL) {
+	cdata->pipelineHead = rdata;
+    } else {
+	cdata->pipelineTail->pipelineNext = rdata;
+    }
+    cdata->pipelineTail = rdata;
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SyncPipeline --
+ *
+ *	Synchronizes the queue of a connection in pipeline mode, and
+ *	reads the results of the statements in it.
+ *
+ * Results:
+ *	Returns a standard Tcl result, which is TCL_ERROR only if the
+ *	connection fails.
+ *
+ * Side effects:
+ *	Gives each queued result set its result, or marks it failed, and
+ *	releases the queue's reference to it. Remembers the first result
+ *	set whose statement failed, for ConnectionPipelineMethod to report,
+ *	and marks the statements that succeeded before it in the same
+ *	transaction as rolled back.
+ *	Takes the connection out of pipeline mode, and carries out the
+ *	commands that had to wait for that; if it cannot leave pipeline
+ *	mode, they wait for a later synchronization.
+ *
+ * The statements queued between synchronizations run as one implicit
+ * transaction unless a transaction is open. Once one fails, the server
+ * skips the rest, and reports them as aborted.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+SyncPipeline(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ConnectionData* cdata	/* Connection data */
+) {
+    PGconn* pgPtr = cdata->pgPtr;
+				/* Connection handle */
+    ResultSetData* rdata;	/* Result set whose result is read */
+    ResultSetData* xactFirst;	/* First result set in the transaction
+				 * of 'rdata' */
+    ResultSetData* prior;	/* Result set ahead of 'rdata' */
+    const char* command;	/* Command status of a statement */
+    PGresult* res;		/* Result of a statement */
+    PGresult* extra;		/* Further result of a statement */
+    int synced;			/* Flag == 1 if the synchronization point
+				 * was sent */
+    int ok;			/* Flag == 1 while the connection works */
+    int status = TCL_OK;
+
+    if (!(cdata->flags & CONN_FLAG_PIPELINE_MODE)) {
+	return TCL_OK;
+    }
+
+    /* The queued statements may have ended a transaction and begun another */
+
+    ++cdata->xactCounter;
+    ok = synced = PQpipelineSync(pgPtr);
+    xactFirst = cdata->pipelineHead;
+    for (rdata = cdata->pipelineHead; rdata != NULL;
+	 rdata = rdata->pipelineNext) {
+	rdata->flags &= ~RS_FLAG_PENDING;
+
+	/* Each statement's results are followed by a NULL */
+
+	res = ok ? PQgetResult(pgPtr) : NULL;
+	if (res == NULL) {
+	    ok = 0;
+	} else {
+	    while ((extra = PQgetResult(pgPtr)) != NULL) {
+		PQclear(extra);
+	    }
+	}
+	rdata->execResult = res;
+	switch (res == NULL ? PGRES_FATAL_ERROR : PQresultStatus(res)) {
+	case PGRES_COMMAND_OK:
+	case PGRES_TUPLES_OK:
+	case PGRES_NONFATAL_ERROR:
+	    rdata->plan = StatementPlan(rdata->sdata, res);
+	    IncrDecodePlanRefCount(rdata->plan);
+	    SetupInterning(rdata, (rdata->flags & RS_FLAG_INTERN) != 0);
+
+	    /* A statement that ends a transaction ends its group */
+
+	    command = PQcmdStatus(res);
+	    if (strcmp(command, "COMMIT") == 0
+		|| strcmp(command, "ROLLBACK") == 0) {
+		xactFirst = rdata->pipelineNext;
+	    }
+	    break;
+	case PGRES_PIPELINE_ABORTED:
+	    rdata->flags |= RS_FLAG_FAILED;
+	    break;
+	default:
+	    rdata->flags |= RS_FLAG_FAILED;
+	    if (cdata->pipelineFailure == NULL) {
+		cdata->pipelineFailure = rdata;
+		IncrResultSetRefCount(rdata);
+	    }
+
+	    /*
+	     * The failure aborts the transaction, and so undoes the
+	     * statements ahead of it in the transaction.
+	     */
+
+	    for (prior = xactFirst; prior != rdata;
+		 prior = prior->pipelineNext) {
+		if (!(prior->flags & RS_FLAG_FAILED)) {
+		    prior->flags |= RS_FLAG_FAILED | RS_FLAG_ROLLED_BACK;
+		}
+	    }
+	    xactFirst = rdata->pipelineNext;
+	    break;
+	}
+    }
+    while ((rdata = cdata->pipelineHead) != NULL) {
+	cdata->pipelineHead = rdata->pipelineNext;
+	rdata->pipelineNext = NULL;
+	DecrResultSetRefCount(rdata);
+    }
+    cdata->pipelineTail = NULL;
+
+    /*
+     * The synchronization point ends the results. If they went astray,
+     * skip whatever remains up to it; two NULLs in a row mean that
+     * nothing remains.
+     */
+
+    if (ok) {
+	res = PQgetResult(pgPtr);
+	ok = (res != NULL && PQresultStatus(res) == PGRES_PIPELINE_SYNC);
+	PQclear(res);
+    }
+    if (!ok) {
+	TransferPostgresError(interp, pgPtr);
+	status = TCL_ERROR;
+	while (synced
+	       && ((res = PQgetResult(pgPtr)) != NULL
+		   || (res = PQgetResult(pgPtr)) != NULL)) {
+	    synced = (PQresultStatus(res) != PGRES_PIPELINE_SYNC);
+	    PQclear(res);
+	}
+    }
+
+    /*
+     * Commands deferred until the connection left pipeline mode can be
+     * issued only once it has. If it cannot leave, it stays in pipeline
+     * mode, and the next synchronization tries again.
+     */
+
+    if (!PQexitPipelineMode(pgPtr)) {
+	if (status == TCL_OK) {
+	    TransferPostgresError(interp, pgPtr);
+	    status = TCL_ERROR;
+	}
+	return status;
+    }
+    cdata->flags &= ~CONN_FLAG_PIPELINE_MODE;
+    RunDeferredDeallocs(cdata);
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * AwaitPipelinedResult --
+ *
+ *	Makes sure that a result set that was queued in a pipeline has
+ *	its result.
+ *
+ * Results:
+ *	Returns a standard Tcl result. If the result set's statement
+ *	failed, or was skipped because an earlier one in the pipeline
+ *	failed, reports why.
+ *
+ * Side effects:
+ *	Synchronizes the pipeline if the result set is still in its queue.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+AwaitPipelinedResult(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata	/* Result set about to be used */
+) {
+    ConnectionData* cdata = rdata->sdata->cdata;
+				/* Connection data */
+
+    if ((rdata->flags & RS_FLAG_PENDING)
+	&& SyncPipeline(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (!(rdata->flags & RS_FLAG_FAILED)) {
+	return TCL_OK;
+    }
+    if (rdata->flags & RS_FLAG_ROLLED_BACK) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("statement was rolled "
+						  "back because a later "
+						  "statement in its "
+						  "transaction failed", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "TRANSACTION_ROLLBACK",
+			 "40000", "POSTGRES", "-1", NULL);
+    } else if (rdata->execResult == NULL) {
+	TransferPostgresError(interp, cdata->pgPtr);
+    } else if (PQresultStatus(rdata->execResult) == PGRES_PIPELINE_ABORTED) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("statement was not "
+						  "executed because an "
+						  "earlier statement in the "
+						  "pipeline failed", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "INVALID_TRANSACTION_STATE",
+			 "25P02", "POSTGRES", "-1", NULL);
+    } else {
+	TransferResultError(interp, rdata->execResult);
+    }
+
+    /* The failure is reported, so the pipeline need not report it */
+
+    if (cdata->pipelineFailure == rdata) {
+	cdata->pipelineFailure = NULL;
+	DecrResultSetRefCount(rdata);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteConnectionMetadata, DeleteConnection --
+ *
+ *	Cleans up when a database connection is deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Terminates the connection and frees all system resources associated
+ *	with it.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DeleteConnectionMetadata(
+    ClientData clientData	/* Instance data for the connection */
+) {
+    DecrConnectionRefCount((ConnectionData*)clientData);
+}
+
+static void
+DeleteConnection(
+    ConnectionData* cdata	/* Instance data for the connection */
+) {
+    Tcl_HashSearch	search;
+    Tcl_HashEntry*	he = NULL;
+
+    FDBG("===> Enter DeleteConnection %s\n", name(cdata));
+    if (cdata->statements) {
+	he = Tcl_FirstHashEntry(cdata->statements, &search);
+	if (he) {
+	    StatementData*	sdata = NULL;
+	    int			stillRemain = 0;
+
+	    do {
+		sdata = Tcl_GetHashValue(he);
+		if (sdata->cdata == NULL) {
+		    /*
+		     * A frozen statement, just free it.  Can arrive here if
+		     * the last pgStatement literal is deleted during
+		     * interpreter exit, causing the cdata refcount to go to 0.
+		     * Destructor should be run but isn't, so we're left with
+		     * frozen statements in cdata->statements.
+		     * cdata->pgPtr is going to be closed anyway, so skip the
+		     * UnallocateStatement step (which would cause problems
+		     * with refcounting cdata)
+		     */
+		    if (sdata->stmtName) {
+			/* NULLing stmtName causes the UnallocateStatement
+			 * to be skipped */
 			ckfree(sdata->stmtName);
 			sdata->stmtName = NULL;
 		    }
@@ -2686,6 +4218,19 @@ DeleteConnection(
 	PQfinish(cdata->pgPtr);
 	cdata->pgPtr = NULL;
     }
+    if (cdata->deferredDeallocs != NULL) {
+	Tcl_DecrRefCount(cdata->deferredDeallocs);
+	cdata->deferredDeallocs = NULL;
+    }
+    if (cdata->deferredCloses != NULL) {
+	Tcl_DecrRefCount(cdata->deferredCloses);
+	cdata->deferredCloses = NULL;
+    }
+    if (cdata->enumTypes != NULL) {
+	Tcl_DeleteHashTable(cdata->enumTypes);
+	ckfree(cdata->enumTypes);
+	cdata->enumTypes = NULL;
+    }
     DecrPerInterpRefCount(cdata->pidata);
     cdata->pidata = NULL;
     
@@ -2812,69 +4357,293 @@ GenStatementName(
  * Results:
  *	Nothing.
  *
+ * Side effects:
+ *	While another result set is streaming, statements are queued in a
+ *	pipeline or the transaction has failed, the connection cannot take
+ *	the command. The name is then remembered, as it is if the command
+ *	fails, and RunDeferredDeallocs tries again once the connection is
+ *	free, so that the prepared statement does not outlive its use.
+ *
  *-----------------------------------------------------------------------------
  */
 
 static void
 UnallocateStatement(
-	PGconn * pgPtr,	    /* Connection handle */
+	ConnectionData* cdata,	/* Connection data */
 	char* stmtName	    /* Statement name */
 ) {
-    Tcl_Obj * sqlQuery = Tcl_NewStringObj("DEALLOCATE ", -1);
-    Tcl_IncrRefCount(sqlQuery);
-    Tcl_AppendToObj(sqlQuery, stmtName, -1);
-    PQclear(PQexec(pgPtr, Tcl_GetString(sqlQuery)));
-    Tcl_DecrRefCount(sqlQuery);
+    if (cdata->streamOwner != NULL
+	|| (cdata->flags & CONN_FLAG_PIPELINE_MODE)
+	|| PQtransactionStatus(cdata->pgPtr) == PQTRANS_INERROR
+	|| !ExecRelease(cdata, "DEALLOCATE ", stmtName, "26000")) {
+	DeferRelease(&cdata->deferredDeallocs, stmtName);
+    }
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * NewStatement --
+ * DeferRelease --
  *
- *	Creates an empty object to hold statement data.
+ *	Remembers the name of a prepared statement or cursor whose release
+ *	has to wait until the connection is free.
  *
  * Results:
- *	Returns a pointer to the newly-created object.
+ *	None.
+ *
+ * Side effects:
+ *	Appends the name to the list in '*listPtr', making the list if
+ *	there is none.
  *
  *-----------------------------------------------------------------------------
  */
 
-static StatementData*
-NewStatement(
-    ConnectionData* cdata	/* Instance data for the connection */
+static void
+DeferRelease(
+    Tcl_Obj** listPtr,		/* List of deferred names */
+    const char* name		/* Name to add */
 ) {
-    StatementData* sdata = (StatementData*) ckalloc(sizeof(StatementData));
-    memset(sdata, 0, sizeof(StatementData));
-    sdata->refCount = 1;
-    sdata->cdata = cdata;
-    DBG("Taking a ref on cdata %s for sdata %s, statements existing: %d\n", name(cdata), name(sdata), ++g_statements);
-    IncrConnectionRefCount(sdata->cdata);
-    sdata->subVars = Tcl_NewObj();
-    Tcl_IncrRefCount(sdata->subVars);
-    sdata->params = NULL;
-    sdata->paramDataTypes = NULL;
-    sdata->origSql = NULL;
-    sdata->nativeSql = NULL;
-    sdata->columnNames = NULL;
-    sdata->flags = 0;
-    sdata->stmtName = GenStatementName(cdata);
-    sdata->paramTypesChanged = 0;
-    sdata->pgStatements = NULL;
-
-    return sdata;
+    if (*listPtr == NULL) {
+	*listPtr = Tcl_NewObj();
+	Tcl_IncrRefCount(*listPtr);
+    }
+    Tcl_ListObjAppendElement(NULL, *listPtr, Tcl_NewStringObj(name, -1));
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * PrepareStatement --
+ * ExecRelease --
  *
- *	Prepare a PostgreSQL statement. When stmtName equals to
- *	NULL, statement name is taken from sdata strucure.
+ *	Issues a command that releases a prepared statement or cursor.
  *
  * Results:
- *	Returns the Posgres result object if successful, and NULL on failure.
+ *	Returns 1 if the object is gone: the command succeeded, the
+ *	server reported 'goneState' because the object no longer exists,
+ *	or the connection is lost and the object with it. Returns 0 if the
+ *	command is to be tried again.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ExecRelease(
+    ConnectionData* cdata,	/* Connection data */
+    const char* command,	/* Command, followed by a space */
+    const char* name,		/* Name of the object */
+    const char* goneState	/* SQLSTATE reporting a missing object */
+) {
+    Tcl_Obj* sqlQuery;		/* Command to issue */
+    PGresult* res;		/* Result of the command */
+    const char* sqlstate;	/* SQLSTATE of a failure */
+    int gone;
+
+    sqlQuery = Tcl_NewStringObj(command, -1);
+    Tcl_IncrRefCount(sqlQuery);
+    Tcl_AppendToObj(sqlQuery, name, -1);
+    res = PQexec(cdata->pgPtr, Tcl_GetString(sqlQuery));
+    Tcl_DecrRefCount(sqlQuery);
+    if (res != NULL && PQresultStatus(res) == PGRES_COMMAND_OK) {
+	gone = 1;
+    } else if (PQstatus(cdata->pgPtr) != CONNECTION_OK) {
+	gone = 1;
+    } else {
+	sqlstate = (res == NULL) ? NULL
+	    : PQresultErrorField(res, PG_DIAG_SQLSTATE);
+	gone = (sqlstate != NULL && strcmp(sqlstate, goneState) == 0);
+    }
+    PQclear(res);
+    return gone;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RunDeferredDeallocs --
+ *
+ *	Unallocates the prepared statements, and closes the cursors,
+ *	whose release had to wait until the connection was free. No errors
+ *	are reported on failure.
+ *
+ * Results:
+ *	Nothing.
+ *
+ * Side effects:
+ *	Names whose release fails again are kept for the next try. Nothing
+ *	is tried while the connection is still busy or its transaction has
+ *	failed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+RunDeferredDeallocs(
+	ConnectionData* cdata	/* Connection data */
+) {
+    Tcl_Obj* deallocs;		/* List of statements to unallocate */
+    Tcl_Obj* closes;		/* List of cursors to close */
+    Tcl_Obj** names;		/* Names of the statements or cursors */
+    int nNames;			/* Number of statements or cursors */
+    Tcl_WideInt cursorXact;	/* Transaction number of a cursor */
+    int i;
+
+    if (cdata->streamOwner != NULL
+	|| (cdata->flags & (CONN_FLAG_PIPELINE_MODE | CONN_FLAG_BATCH))
+	|| PQtransactionStatus(cdata->pgPtr) == PQTRANS_INERROR) {
+	return;
+    }
+    if (cdata->deferredDeallocs != NULL) {
+	deallocs = cdata->deferredDeallocs;
+	cdata->deferredDeallocs = NULL;
+	Tcl_ListObjGetElements(NULL, deallocs, &nNames, &names);
+	for (i = 0; i < nNames; ++i) {
+	    UnallocateStatement(cdata, Tcl_GetString(names[i]));
+	}
+	Tcl_DecrRefCount(deallocs);
+    }
+    if (cdata->deferredCloses != NULL) {
+	closes = cdata->deferredCloses;
+	cdata->deferredCloses = NULL;
+	Tcl_ListObjGetElements(NULL, closes, &nNames, &names);
+	for (i = 0; i + 1 < nNames; i += 2) {
+	    Tcl_GetWideIntFromObj(NULL, names[i+1], &cursorXact);
+	    CloseCursor(cdata, Tcl_GetString(names[i]), cursorXact);
+	}
+	Tcl_DecrRefCount(closes);
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GenCursorName --
+ *
+ *	Generates a unique name for a server-side cursor.
+ *
+ * Results:
+ *	Null terminated, free-able, string containing the name.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static char*
+GenCursorName(
+    ConnectionData* cdata	/* Instance data for the connection */
+) {
+    char cursorName[30];
+    char* retval;
+    cdata->stmtCounter += 1;
+    snprintf(cursorName, 30, "cursor%d", cdata->stmtCounter);
+    retval = (char *)ckalloc(strlen(cursorName) + 1);
+    strcpy(retval, cursorName);
+    return retval;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CloseCursor --
+ *
+ *	Tries to close a server-side cursor. No errors are reported on
+ *	failure.
+ *
+ * Results:
+ *	Nothing.
+ *
+ * Side effects:
+ *	While another result set is streaming, statements are queued in a
+ *	pipeline or the transaction has failed, the cursor is remembered,
+ *	as it is if the CLOSE fails, and RunDeferredDeallocs tries again
+ *	once the connection is free.
+ *
+ * A cursor not declared WITH HOLD is gone once its transaction ends, and
+ * trying to close it then would abort whatever transaction is in
+ * progress. Such a cursor is therefore closed only while the transaction
+ * in which it was declared is still open, as far as the connection can
+ * tell; one that is left open vanishes when that transaction ends.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+CloseCursor(
+    ConnectionData* cdata,	/* Connection data */
+    const char* cursorName,	/* Name of the cursor */
+    Tcl_WideInt cursorXact	/* Number of the transaction to which the
+				 * cursor belongs, or -1 if it is declared
+				 * WITH HOLD */
+) {
+    PGTransactionStatusType xactStatus = PQtransactionStatus(cdata->pgPtr);
+				/* Status of the transaction in progress */
+
+    if (cursorXact != -1
+	&& (xactStatus != PQTRANS_INTRANS
+	    || cursorXact != cdata->xactCounter)) {
+	return;
+    }
+    if (cdata->streamOwner != NULL
+	|| (cdata->flags & CONN_FLAG_PIPELINE_MODE)
+	|| xactStatus == PQTRANS_INERROR
+	|| !ExecRelease(cdata, "CLOSE ", cursorName, "34000")) {
+	DeferRelease(&cdata->deferredCloses, cursorName);
+	Tcl_ListObjAppendElement(NULL, cdata->deferredCloses,
+				 Tcl_NewWideIntObj(cursorXact));
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * NewStatement --
+ *
+ *	Creates an empty object to hold statement data.
+ *
+ * Results:
+ *	Returns a pointer to the newly-created object.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static StatementData*
+NewStatement(
+    ConnectionData* cdata	/* Instance data for the connection */
+) {
+    StatementData* sdata = (StatementData*) ckalloc(sizeof(StatementData));
+    memset(sdata, 0, sizeof(StatementData));
+    sdata->refCount = 1;
+    sdata->cdata = cdata;
+    DBG("Taking a ref on cdata %s for sdata %s, statements existing: %d\n", name(cdata), name(sdata), ++g_statements);
+    IncrConnectionRefCount(sdata->cdata);
+    sdata->subVars = Tcl_NewObj();
+    Tcl_IncrRefCount(sdata->subVars);
+    sdata->params = NULL;
+    sdata->paramDataTypes = NULL;
+    sdata->origSql = NULL;
+    sdata->nativeSql = NULL;
+    sdata->columnNames = NULL;
+    sdata->nColumns = 0;
+    sdata->columnTypes = NULL;
+    sdata->plan = NULL;
+    sdata->flags = 0;
+    sdata->stmtName = GenStatementName(cdata);
+    sdata->paramTypesChanged = 0;
+    sdata->paramScratch = NULL;
+    sdata->paramScratchSize = 0;
+    sdata->pgStatements = NULL;
+
+    return sdata;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * PrepareStatement --
+ *
+ *	Prepare a PostgreSQL statement. When stmtName equals to
+ *	NULL, statement name is taken from sdata strucure.
+ *
+ * Results:
+ *	Returns the Posgres result object if successful, and NULL on failure.
  *
  * Side effects:
  *	Prepares the statement.
@@ -2895,6 +4664,8 @@ PrepareStatement(
     int nativeSqlLen;		/* Length of the statement */
     PGresult* res;		/* result of statement preparing*/
     PGresult* res2;
+    int changed;		/* Flag == 1 if the result columns differ
+				 * from the last preparation */
     int i;
 
     if (stmtName == NULL) {
@@ -2928,6 +4699,36 @@ PrepareStatement(
 	sdata->params[i].precision = 0;
 	sdata->params[i].scale = 0;
     }
+
+    /*
+     * Remember the types of the result columns, so that executions can
+     * decide up front whether to ask for binary results. If they have
+     * changed, the plan for decoding the results no longer fits.
+     */
+
+    changed = (PQnfields(res2) != sdata->nColumns);
+    for (i = 0; !changed && i < sdata->nColumns; ++i) {
+	changed = (PQftype(res2, i) != sdata->columnTypes[i]);
+    }
+    if (changed) {
+	if (sdata->columnTypes != NULL) {
+	    ckfree(sdata->columnTypes);
+	    sdata->columnTypes = NULL;
+	}
+	sdata->nColumns = PQnfields(res2);
+	if (sdata->nColumns > 0) {
+	    sdata->columnTypes =
+		(Oid*) ckalloc(sdata->nColumns * sizeof(Oid));
+	    for (i = 0; i < sdata->nColumns; ++i) {
+		sdata->columnTypes[i] = PQftype(res2, i);
+	    }
+	}
+	LearnEnumTypes(cdata, sdata);
+	if (sdata->plan != NULL) {
+	    DecrDecodePlanRefCount(sdata->plan);
+	    sdata->plan = NULL;
+	}
+    }
     PQclear(res2);
 
     return res;
@@ -2936,1268 +4737,7130 @@ PrepareStatement(
 /*
  *-----------------------------------------------------------------------------
  *
- * ResultDescToTcl --
+ * BinaryDecoderForType --
  *
- *	Converts a Postgres result description for return as a Tcl list.
+ *	Finds the function that converts values of a given data type from
+ *	PostgreSQL's binary format.
  *
  * Results:
- *	Returns a Tcl object holding the result description
+ *	Returns the decoder, or NULL if the type has none.
  *
- * If any column names are duplicated, they are disambiguated by
- * appending '#n' where n increments once for each occurrence of the
- * column name.
+ *-----------------------------------------------------------------------------
+ */
+
+static ColumnDecoder*
+BinaryDecoderForType(
+    Oid type			/* Data type of the column */
+) {
+    switch (type) {
+    case BOOLOID:
+	return DecodeBool;
+    case INT2OID:
+	return DecodeInt2;
+    case INT4OID:
+	return DecodeInt4;
+    case INT8OID:
+	return DecodeInt8;
+    case OIDOID:
+	return DecodeOid;
+    case FLOAT4OID:
+	return DecodeFloat4;
+    case FLOAT8OID:
+	return DecodeFloat8;
+    case NUMERICOID:
+	return DecodeNumeric;
+    case DATEOID:
+	return DecodeDate;
+    case TIMESTAMPOID:
+	return DecodeTimestamp;
+    case UUIDOID:
+	return DecodeUuid;
+    case BYTEAOID:
+	return DecodeBytea;
+    case TEXTOID:
+    case VARCHAROID:
+    case BPCHAROID:
+    case NAMEOID:
+
+	/* Character types have the same form in binary as in text */
+
+	return DecodeText;
+    default:
+	return NULL;
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BinaryResultsWanted --
+ *
+ *	Determines whether the results of a statement are to be
+ *	requested in binary format.
+ *
+ * Results:
+ *	Returns 1 if there is a binary decoder for the type of every
+ *	result column, and 0 otherwise.
+ *
+ * libpq asks for one format for all the columns of a result, so a single
+ * column of another type means that the whole result comes as text.
+ * Binary values must come out as the server would have written them,
+ * so floating-point columns need a server that writes the shortest
+ * exact form (PostgreSQL 12 or later), and date and timestamp columns
+ * need the ISO date style. The date style can change during the
+ * session, so the decision is made anew for each execution.
  *
  *-----------------------------------------------------------------------------
  */
 
-static Tcl_Obj*
-ResultDescToTcl(
-    PGresult* result,		/* Result set description */
-    int flags			/* Flags governing the conversion */
+static int
+BinaryResultsWanted(
+    StatementData* sdata	/* Statement to be executed */
 ) {
-    Tcl_Obj* retval = Tcl_NewObj();
-    Tcl_HashTable names;	/* Hash table to resolve name collisions */
-    char * fieldName;
-    Tcl_InitHashTable(&names, TCL_STRING_KEYS);
-    if (result != NULL) {
-	unsigned int fieldCount = PQnfields(result);
-	unsigned int i;
-	char numbuf[16];
-	for (i = 0; i < fieldCount; ++i) {
-	    int isNew;
-	    int count = 1;
-	    Tcl_Obj* nameObj;
-	    Tcl_HashEntry* entry;
-	    fieldName = PQfname(result, i);
-	    nameObj = Tcl_NewStringObj(fieldName, -1);
-	    Tcl_IncrRefCount(nameObj);
-	    entry =
-		Tcl_CreateHashEntry(&names, fieldName, &isNew);
-	    while (!isNew) {
-	        count = PTR2INT(Tcl_GetHashValue(entry));
-		++count;
-		Tcl_SetHashValue(entry, INT2PTR(count));
-		sprintf(numbuf, "#%d", count);
-		Tcl_AppendToObj(nameObj, numbuf, -1);
-		entry = Tcl_CreateHashEntry(&names, Tcl_GetString(nameObj),
-					    &isNew);
+    PGconn* pgPtr = sdata->cdata->pgPtr;
+				/* Connection handle */
+    const char* setting;	/* Value of a server parameter */
+    int i;
+
+    if (sdata->nColumns == 0) {
+	return 0;
+    }
+    for (i = 0; i < sdata->nColumns; ++i) {
+	if (BinaryDecoderForType(sdata->columnTypes[i]) == NULL) {
+	    return 0;
+	}
+	switch (sdata->columnTypes[i]) {
+	case FLOAT4OID:
+	case FLOAT8OID:
+	    setting = PQparameterStatus(pgPtr, "server_version");
+	    if (setting == NULL || atoi(setting) < 12) {
+		return 0;
 	    }
-	    Tcl_SetHashValue(entry, INT2PTR(count));
-	    Tcl_ListObjAppendElement(NULL, retval, nameObj);
-	    Tcl_DecrRefCount(nameObj);
+	    break;
+	case TIMESTAMPOID:
+	    setting = PQparameterStatus(pgPtr, "integer_datetimes");
+	    if (setting == NULL || strcmp(setting, "on") != 0) {
+		return 0;
+	    }
+	    /* FALLTHRU */
+	case DATEOID:
+	    setting = PQparameterStatus(pgPtr, "DateStyle");
+	    if (setting == NULL || strncmp(setting, "ISO", 3) != 0) {
+		return 0;
+	    }
+	    break;
 	}
     }
-    Tcl_DeleteHashTable(&names);
-    return retval;
+    return 1;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * StatementConstructor --
- *
- *	C-level initialization for the object representing an Postgres prepared
- *	statement.
- *
- * Usage:
- *	statement new connection statementText
- *	statement create name connection statementText
+ * LearnEnumTypes --
  *
- * Parameters:
- *      connection -- the Postgres connection object
- *	statementText -- text of the statement to prepare.
+ *	Finds out which of the user-defined types of a statement's result
+ *	columns are enums.
  *
  * Results:
- *	Returns a standard Tcl result
+ *	None.
  *
  * Side effects:
- *	Prepares the statement, and stores it (plus a reference to the
- *	connection) in instance metadata.
+ *	Queries pg_type for the types that the connection has not yet seen,
+ *	and records the answers in cdata->enumTypes. If the query fails, the
+ *	types are taken not to be enums.
  *
  *-----------------------------------------------------------------------------
  */
 
-static int
-StatementConstructor(
-    ClientData clientData,	/* Not used */
-    Tcl_Interp* interp,		/* Tcl interpreter */
-    Tcl_ObjectContext context,	/* Object context  */
-    int objc, 			/* Parameter count */
-    Tcl_Obj *const objv[]	/* Parameter vector */
+static void
+LearnEnumTypes(
+    ConnectionData* cdata,	/* Connection to the database */
+    StatementData* sdata	/* Statement just prepared */
 ) {
-    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
-				/* The current statement object */
-    int skip = Tcl_ObjectContextSkippedArgs(context);
-				/* Number of args to skip before the
-				 * payload arguments */
-    Tcl_Object connectionObject;
-				/* The database connection as a Tcl_Object */
-    ConnectionData* cdata;	/* The connection object's data */
-    StatementData* sdata = NULL;
-    				/* The statement's object data */
-
-    /* Find the connection object, and get its data. */
+    Tcl_DString query;		/* Query against pg_type */
+    Tcl_HashEntry* entry;	/* Entry for a type in cdata->enumTypes */
+    PGresult* res;		/* Result of the query */
+    char buf[16];		/* Formatted type OID */
+    int nTypes = 0;		/* Number of types in the query */
+    int isNew;
+    int i;
 
-    thisObject = Tcl_ObjectContextObject(context);
-    if (objc != skip+2) {
-	Tcl_WrongNumArgs(interp, skip, objv, "connection statementText");
-	return TCL_ERROR;
+    if (cdata->enumTypes == NULL) {
+	cdata->enumTypes = (Tcl_HashTable*) ckalloc(sizeof(Tcl_HashTable));
+	Tcl_InitHashTable(cdata->enumTypes, TCL_ONE_WORD_KEYS);
     }
-
-    connectionObject = Tcl_GetObjectFromObj(interp, objv[skip]);
-    if (connectionObject == NULL) {
-	return TCL_ERROR;
+    Tcl_DStringInit(&query);
+    Tcl_DStringAppend(&query, "SELECT oid FROM pg_catalog.pg_type"
+		      " WHERE typtype = 'e' AND oid IN (", -1);
+    for (i = 0; i < sdata->nColumns; ++i) {
+	if (sdata->columnTypes[i] < FIRST_NORMAL_OID) {
+	    continue;
+	}
+	entry = Tcl_CreateHashEntry(cdata->enumTypes,
+				    INT2PTR(sdata->columnTypes[i]), &isNew);
+	if (!isNew) {
+	    continue;
+	}
+	Tcl_SetHashValue(entry, INT2PTR(0));
+	snprintf(buf, sizeof(buf), "%s%u", nTypes ? "," : "",
+		 (unsigned) sdata->columnTypes[i]);
+	Tcl_DStringAppend(&query, buf, -1);
+	++nTypes;
+    }
+    Tcl_DStringAppend(&query, ")", 1);
+
+    if (nTypes > 0) {
+	res = PQexec(cdata->pgPtr, Tcl_DStringValue(&query));
+	if (res != NULL && PQresultStatus(res) == PGRES_TUPLES_OK) {
+	    for (i = 0; i < PQntuples(res); ++i) {
+		entry = Tcl_FindHashEntry(cdata->enumTypes,
+			INT2PTR(strtoul(PQgetvalue(res, i, 0), NULL, 10)));
+		if (entry != NULL) {
+		    Tcl_SetHashValue(entry, INT2PTR(1));
+		}
+	    }
+	}
+	if (res != NULL) {
+	    PQclear(res);
+	}
     }
-    cdata = (ConnectionData*) Tcl_ObjectGetMetadata(connectionObject,
-						    &connectionDataType);
-    if (cdata == NULL) {
-	Tcl_AppendResult(interp, Tcl_GetString(objv[skip]),
-			 " does not refer to a Postgres connection", NULL);
-	return TCL_ERROR;
-    }
-
-    /*
-     * All the work is done by the GetPgStatementFromObj, which will
-     * cache the StatementData in objv[skip+1] for future calls
-     */
-
-    TIME("GetPgStatementFromObj",
-    if (GetPgStatementFromObj(interp, objv[skip+1], cdata, &sdata) != TCL_OK) {
-	return TCL_ERROR;
-    }
-    );
-
-    /* Attach the current statement data as metadata to the current object */
-
-    IncrStatementRefCount(sdata);
-    Tcl_ObjectSetMetadata(thisObject, &statementDataType, (ClientData) sdata);
-
-    return TCL_OK;
+    Tcl_DStringFree(&query);
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * StatementParamsMethod --
- *
- *	Lists the parameters in a Postgres statement.
+ * IsEnumType --
  *
- * Usage:
- *	$statement params
+ *	Determines whether a data type is known to be an enum.
  *
  * Results:
- *	Returns a standard Tcl result containing a dictionary. The keys
- *	of the dictionary are parameter names, and the values are parameter
- *	types, themselves expressed as dictionaries containing the keys,
- *	'name', 'direction', 'type', 'precision', 'scale' and 'nullable'.
- *
+ *	Returns 1 if LearnEnumTypes has found the type to be an enum, and
+ *	0 otherwise.
  *
  *-----------------------------------------------------------------------------
  */
 
 static int
-StatementParamsMethod(
-    ClientData clientData,	/* Not used */
-    Tcl_Interp* interp,		/* Tcl interpreter */
-    Tcl_ObjectContext context,	/* Object context  */
-    int objc, 			/* Parameter count */
-    Tcl_Obj *const objv[]	/* Parameter vector */
+IsEnumType(
+    ConnectionData* cdata,	/* Connection to the database */
+    Oid type			/* Type OID */
 ) {
-    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
-				/* The current statement object */
-    StatementData* sdata	/* The current statement */
-	= (StatementData*) Tcl_ObjectGetMetadata(thisObject,
-						 &statementDataType);
-    ConnectionData* cdata = sdata->cdata;
-    PerInterpData* pidata = cdata->pidata; /* Per-interp data */
-    Tcl_Obj** literals = pidata->literals; /* Literal pool */
-    Tcl_Obj* paramName;		/* Name of a parameter */
-    Tcl_Obj* paramDesc;		/* Description of one parameter */
-    Tcl_Obj* dataTypeName;	/* Name of a parameter's data type */
-    Tcl_Obj* retVal;		/* Return value from this command */
-    Tcl_HashEntry* typeHashEntry;
-    int i;
-
-    if (objc != 2) {
-	Tcl_WrongNumArgs(interp, 2, objv, "");
-	return TCL_ERROR;
-    }
+    Tcl_HashEntry* entry;
 
-    retVal = Tcl_NewObj();
-    for (i = 0; i < sdata->nParams; ++i) {
-	paramDesc = Tcl_NewObj();
-	Tcl_ListObjIndex(NULL, sdata->subVars, i, &paramName);
-	Tcl_DictObjPut(NULL, paramDesc, literals[LIT_NAME], paramName);
-	switch (sdata->params[i].flags & (PARAM_IN | PARAM_OUT)) {
-	case PARAM_IN:
-	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_DIRECTION],
-			   literals[LIT_IN]);
-	    break;
-	case PARAM_OUT:
-	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_DIRECTION],
-			   literals[LIT_OUT]);
-	    break;
-	case PARAM_IN | PARAM_OUT:
-	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_DIRECTION],
-			   literals[LIT_INOUT]);
-	    break;
-	default:
-	    break;
-	}
-	typeHashEntry =
-	    Tcl_FindHashEntry(&(pidata->typeNumHash),
-			      INT2PTR(sdata->paramDataTypes[i]));
-	if (typeHashEntry != NULL) {
-	    dataTypeName = (Tcl_Obj*) Tcl_GetHashValue(typeHashEntry);
-	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_TYPE], dataTypeName);
-	}
-	Tcl_DictObjPut(NULL, paramDesc, literals[LIT_PRECISION],
-		       Tcl_NewWideIntObj(sdata->params[i].precision));
-	Tcl_DictObjPut(NULL, paramDesc, literals[LIT_SCALE],
-		       Tcl_NewWideIntObj(sdata->params[i].scale));
-	Tcl_DictObjPut(NULL, retVal, paramName, paramDesc);
+    if (type < FIRST_NORMAL_OID || cdata->enumTypes == NULL) {
+	return 0;
     }
-
-    Tcl_SetObjResult(interp, retVal);
-    return TCL_OK;
+    entry = Tcl_FindHashEntry(cdata->enumTypes, INT2PTR(type));
+    return (entry != NULL) && PTR2INT(Tcl_GetHashValue(entry));
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * StatementParamtypeMethod --
- *
- *	Defines a parameter type in a Postgres statement.
+ * DecodeText, DecodeBool, DecodeInt2, DecodeInt4, DecodeOid, DecodeInt8,
+ * DecodeFloat4, DecodeFloat8, DecodeNumeric, DecodeDate, DecodeTimestamp,
+ * DecodeUuid, DecodeBytea --
  *
- * Usage:
- *	$statement paramtype paramName ?direction? type ?precision ?scale??
+ *	Convert a column value to a Tcl object. DecodeText takes the text
+ *	format; the rest take PostgreSQL's binary format.
  *
  * Results:
- *	Returns a standard Tcl result.
+ *	Return a Tcl object with a zero reference count.
  *
- * Side effects:
- *	Updates the description of the given parameter.
+ * Integers and doubles arrive in network byte order, and are made into
+ * the corresponding Tcl numbers without a trip through their string
+ * representations. Every value has the text that the server would have
+ * sent in text format, so that a column's values do not depend on the
+ * format of the result: doubles are given the server's spelling as
+ * their string representation, and booleans, numerics, dates and
+ * timestamps are formatted the way the server formats them.
  *
  *-----------------------------------------------------------------------------
  */
 
-static int
-StatementParamtypeMethod(
-    ClientData clientData,	/* Not used */
-    Tcl_Interp* interp,		/* Tcl interpreter */
-    Tcl_ObjectContext context,	/* Object context  */
-    int objc, 			/* Parameter count */
-    Tcl_Obj *const objv[]	/* Parameter vector */
+static Tcl_WideUInt
+GetNetworkOrder(
+    const char* buffer,		/* Bytes of the value */
+    int n			/* Number of bytes */
 ) {
-    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
-				/* The current statement object */
-    StatementData* sdata	/* The current statement */
-	= (StatementData*) Tcl_ObjectGetMetadata(thisObject,
-						 &statementDataType);
-    static const struct {
-	const char* name;
-	int flags;
-    } directions[] = {
-	{ "in", 	PARAM_IN },
-	{ "out",	PARAM_OUT },
-	{ "inout",	PARAM_IN | PARAM_OUT },
-	{ NULL,		0 }
-    };
-    int direction;
-    int typeNum;		/* Data type number of a parameter */
-    int precision;		/* Data precision */
-    int scale;			/* Data scale */
+    const unsigned char* p = (const unsigned char*) buffer;
+    Tcl_WideUInt u = 0;
+    int i;
 
-    const char* paramName;	/* Name of the parameter being set */
-    Tcl_Obj* targetNameObj;	/* Name of the ith parameter in the statement */
-    const char* targetName;	/* Name of a candidate parameter in the
-				 * statement */
-    int matchCount = 0;		/* Number of parameters matching the name */
-    Tcl_Obj* errorObj;		/* Error message */
+    for (i = 0; i < n; ++i) {
+	u = (u << 8) | p[i];
+    }
+    return u;
+}
 
-    int i;
+static Tcl_Obj*
+DecodeText(
+    const char* buffer,		/* Value */
+    int buffSize		/* Length of the value */
+) {
+    return Tcl_NewStringObj(buffer, buffSize);
+}
 
-    /* Check parameters */
+static Tcl_Obj*
+DecodeBool(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    return Tcl_NewStringObj((buffSize > 0 && buffer[0] != 0) ? "t" : "f", 1);
+}
 
-    if (objc < 4) {
-	goto wrongNumArgs;
-    }
+static Tcl_Obj*
+DecodeInt2(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    return Tcl_NewWideIntObj((short) GetNetworkOrder(buffer, 2));
+}
 
-    i = 3;
-    if (Tcl_GetIndexFromObjStruct(interp, objv[i], directions,
-				  sizeof(directions[0]), "direction",
-				  TCL_EXACT, &direction) != TCL_OK) {
-	direction = PARAM_IN;
-	Tcl_ResetResult(interp);
-    } else {
-	++i;
-    }
-    if (i >= objc) goto wrongNumArgs;
-    if (Tcl_GetIndexFromObjStruct(interp, objv[i], dataTypes,
-				  sizeof(dataTypes[0]), "SQL data type",
-				  TCL_EXACT, &typeNum) == TCL_OK) {
-	++i;
-    } else {
-	return TCL_ERROR;
+static Tcl_Obj*
+DecodeInt4(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    return Tcl_NewWideIntObj((int) GetNetworkOrder(buffer, 4));
+}
+
+static Tcl_Obj*
+DecodeOid(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    return Tcl_NewWideIntObj((Tcl_WideInt) GetNetworkOrder(buffer, 4));
+}
+
+static Tcl_Obj*
+DecodeInt8(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    return Tcl_NewWideIntObj((Tcl_WideInt) GetNetworkOrder(buffer, 8));
+}
+
+static Tcl_Obj*
+DecodeFloat4(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    union {
+	unsigned int u;
+	float f;
+    } conv;			/* Bits of the float */
+    char text[32];		/* Text of the value */
+    Tcl_Obj* obj;
+
+    conv.u = (unsigned int) GetNetworkOrder(buffer, 4);
+    if (conv.f != conv.f) {
+	return Tcl_NewStringObj("NaN", -1);
+    } else if (conv.f > FLT_MAX) {
+	return Tcl_NewStringObj("Infinity", -1);
+    } else if (conv.f < -FLT_MAX) {
+	return Tcl_NewStringObj("-Infinity", -1);
+    }
+    obj = Tcl_NewDoubleObj((double) conv.f);
+    Tcl_InitStringRep(obj, text, FormatFloat(text, (double) conv.f, 1));
+    return obj;
+}
+
+static Tcl_Obj*
+DecodeFloat8(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    union {
+	Tcl_WideUInt u;
+	double d;
+    } conv;			/* Bits of the double */
+    char text[32];		/* Text of the value */
+    Tcl_Obj* obj;
+
+    conv.u = GetNetworkOrder(buffer, 8);
+
+    /* Spell the special values the way that PostgreSQL does */
+
+    if (conv.d != conv.d) {
+	return Tcl_NewStringObj("NaN", -1);
+    } else if (conv.d > DBL_MAX) {
+	return Tcl_NewStringObj("Infinity", -1);
+    } else if (conv.d < -DBL_MAX) {
+	return Tcl_NewStringObj("-Infinity", -1);
     }
-    if (i < objc) {
-	if (Tcl_GetIntFromObj(interp, objv[i], &precision) == TCL_OK) {
-	    ++i;
-	} else {
-	    return TCL_ERROR;
+    obj = Tcl_NewDoubleObj(conv.d);
+    Tcl_InitStringRep(obj, text, FormatFloat(text, conv.d, 0));
+    return obj;
+}
+
+static Tcl_Obj*
+DecodeNumeric(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    int nDigits = (short) GetNetworkOrder(buffer, 2);
+				/* Number of base-10000 digits */
+    int weight = (short) GetNetworkOrder(buffer + 2, 2);
+				/* Power of 10000 of the first digit */
+    int sign = (int) GetNetworkOrder(buffer + 4, 2);
+				/* Sign, or kind of special value */
+    int dscale = (short) GetNetworkOrder(buffer + 6, 2);
+				/* Decimal digits after the point */
+    Tcl_Obj* obj;		/* Text of the value */
+    char* text;			/* Bytes of the text */
+    char group[4];		/* Decimal digits of one base-10000 digit */
+    int digit;			/* Value of one base-10000 digit */
+    int n = 0;			/* Length of the text */
+    int d, i;
+
+    switch (sign) {
+    case NUMERIC_NAN:
+	return Tcl_NewStringObj("NaN", -1);
+    case NUMERIC_PINF:
+	return Tcl_NewStringObj("Infinity", -1);
+    case NUMERIC_NINF:
+	return Tcl_NewStringObj("-Infinity", -1);
+    }
+    if (nDigits > (buffSize - 8) / 2) {
+	nDigits = (buffSize - 8) / 2;
+    }
+    obj = Tcl_NewObj();
+    Tcl_SetObjLength(obj, 2 + 4 * ((weight < 0) ? 1 : weight + 1)
+		     + dscale + 3);
+    text = Tcl_GetString(obj);
+    if (sign == NUMERIC_NEG) {
+	text[n++] = '-';
+    }
+
+    /* The integer part, without leading zeroes */
+
+    if (weight < 0) {
+	text[n++] = '0';
+    }
+    for (d = 0; d <= weight; ++d) {
+	digit = (d < nDigits) ? (int) GetNetworkOrder(buffer + 8 + 2*d, 2)
+	    : 0;
+	n += FormatDigits(text + n, digit, (d == 0) ? 1 : 4);
+    }
+
+    /* The fraction, to exactly 'dscale' places */
+
+    if (dscale > 0) {
+	text[n++] = '.';
+	for (i = 0, d = weight + 1; i < dscale; i += 4, ++d) {
+	    digit = (d >= 0 && d < nDigits)
+		? (int) GetNetworkOrder(buffer + 8 + 2*d, 2) : 0;
+	    FormatDigits(group, digit, 4);
+	    memcpy(text + n, group, (dscale - i < 4) ? dscale - i : 4);
+	    n += (dscale - i < 4) ? dscale - i : 4;
 	}
     }
-    if (i < objc) {
-	if (Tcl_GetIntFromObj(interp, objv[i], &scale) == TCL_OK) {
-	    ++i;
-	} else {
-	    return TCL_ERROR;
+    Tcl_SetObjLength(obj, n);
+    return obj;
+}
+
+static Tcl_Obj*
+DecodeDate(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    Tcl_WideUInt u = GetNetworkOrder(buffer, 4);
+				/* Bits of the day number */
+    char text[32];		/* Text of the date */
+    int year;			/* Year, 0 for 1 BC */
+    int n;			/* Length of the text */
+
+    if (u == DATE_NOBEGIN) {
+	return Tcl_NewStringObj("-infinity", -1);
+    } else if (u == DATE_NOEND) {
+	return Tcl_NewStringObj("infinity", -1);
+    }
+    n = FormatIsoDate(text, (int) u, &year);
+    if (year <= 0) {
+	memcpy(text + n, " BC", 3);
+	n += 3;
+    }
+    return Tcl_NewStringObj(text, n);
+}
+
+static Tcl_Obj*
+DecodeTimestamp(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    Tcl_WideUInt u = GetNetworkOrder(buffer, 8);
+				/* Bits of the microsecond count */
+    Tcl_WideInt usec = (Tcl_WideInt) u;
+				/* Microseconds since the epoch */
+    Tcl_WideInt days;		/* Days since the epoch */
+    char text[64];		/* Text of the timestamp */
+    int year;			/* Year, 0 for 1 BC */
+    int secs;			/* Seconds since midnight */
+    int n;			/* Length of the text */
+
+    if (u == TIMESTAMP_NOBEGIN) {
+	return Tcl_NewStringObj("-infinity", -1);
+    } else if (u == TIMESTAMP_NOEND) {
+	return Tcl_NewStringObj("infinity", -1);
+    }
+    days = usec / USECS_PER_DAY;
+    usec -= days * USECS_PER_DAY;
+    if (usec < 0) {
+	usec += USECS_PER_DAY;
+	--days;
+    }
+    n = FormatIsoDate(text, days, &year);
+    secs = (int) (usec / 1000000);
+    text[n++] = ' ';
+    n += FormatDigits(text + n, secs / 3600, 2);
+    text[n++] = ':';
+    n += FormatDigits(text + n, secs / 60 % 60, 2);
+    text[n++] = ':';
+    n += FormatDigits(text + n, secs % 60, 2);
+
+    /* The fraction of a second, without trailing zeroes */
+
+    if (usec % 1000000 != 0) {
+	text[n++] = '.';
+	n += FormatDigits(text + n, (int) (usec % 1000000), 6);
+	while (text[n-1] == '0') {
+	    --n;
 	}
     }
-    if (i != objc) {
-	goto wrongNumArgs;
+    if (year <= 0) {
+	memcpy(text + n, " BC", 3);
+	n += 3;
     }
+    return Tcl_NewStringObj(text, n);
+}
 
-    /* Look up parameters by name. */
+static Tcl_Obj*
+DecodeUuid(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    const unsigned char* p = (const unsigned char*) buffer;
+    char uuid[36];		/* Formatted UUID */
+    int i, j;
 
-    paramName = Tcl_GetString(objv[2]);
-    for (i = 0; i < sdata->nParams; ++i) {
-	Tcl_ListObjIndex(NULL, sdata->subVars, i, &targetNameObj);
-	targetName = Tcl_GetString(targetNameObj);
-	if (!strcmp(paramName, targetName)) {
-	    ++matchCount;
-	    sdata->params[i].flags = direction;
-	    if (sdata->paramDataTypes[i] != dataTypes[typeNum].oid) {
-		sdata->paramTypesChanged = 1;
-	    }
-	    sdata->paramDataTypes[i] = dataTypes[typeNum].oid;
-	    sdata->params[i].precision = precision;
-	    sdata->params[i].scale = scale;
-	}
-    }
-    if (matchCount == 0) {
-	errorObj = Tcl_NewStringObj("unknown parameter \"", -1);
-	Tcl_AppendToObj(errorObj, paramName, -1);
-	Tcl_AppendToObj(errorObj, "\": must be ", -1);
-	for (i = 0; i < sdata->nParams; ++i) {
-	    Tcl_ListObjIndex(NULL, sdata->subVars, i, &targetNameObj);
-	    Tcl_AppendObjToObj(errorObj, targetNameObj);
-	    if (i < sdata->nParams-2) {
-		Tcl_AppendToObj(errorObj, ", ", -1);
-	    } else if (i == sdata->nParams-2) {
-		Tcl_AppendToObj(errorObj, " or ", -1);
-	    }
+    for (i = 0, j = 0; i < 16; ++i) {
+	if (i == 4 || i == 6 || i == 8 || i == 10) {
+	    uuid[j++] = '-';
 	}
-	Tcl_SetObjResult(interp, errorObj);
-	return TCL_ERROR;
+	uuid[j++] = "0123456789abcdef"[p[i] >> 4];
+	uuid[j++] = "0123456789abcdef"[p[i] & 0xf];
     }
-    return TCL_OK;
+    return Tcl_NewStringObj(uuid, j);
+}
 
- wrongNumArgs:
-    Tcl_WrongNumArgs(interp, 2, objv,
-		     "name ?direction? type ?precision ?scale??");
-    return TCL_ERROR;
+static Tcl_Obj*
+DecodeBytea(
+    const char* buffer,		/* Value in binary format */
+    int buffSize		/* Length of the value */
+) {
+    return Tcl_NewByteArrayObj((const unsigned char*) buffer, buffSize);
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * DeleteStatementMetadata, DeleteStatement --
+ * DecodeByteaText --
  *
- *	Cleans up when a Postgres statement is no longer required.
+ *	Converts a bytea value in PostgreSQL's text format to a Tcl byte
+ *	array.
  *
- * Side effects:
- *	Frees all resources associated with the statement.
+ * Results:
+ *	Returns a Tcl object with a zero reference count.
+ *
+ * Servers from 9.0 on send bytea in 'hex' format, \x followed by two
+ * hex digits per byte. Older servers, or a session that has set
+ * bytea_output to 'escape', send printable bytes as they are and the
+ * rest as backslash and three octal digits.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-DeleteStatementMetadata(
-    ClientData clientData	/* Instance data for the connection */
-) {
-    DecrStatementRefCount((StatementData*)clientData);
-}
-static void
-DeleteStatement(
-    StatementData* sdata	/* Metadata for the statement */
+static Tcl_Obj*
+DecodeByteaText(
+    const char* buffer,		/* Value in text format */
+    int buffSize		/* Length of the value */
 ) {
-    Tcl_HashEntry* he = NULL;
-
-    DBG("  ==> DeleteStatement %s\n", name(sdata));
-    if (sdata->columnNames != NULL) {
-	Tcl_DecrRefCount(sdata->columnNames);
-    }
-    if (sdata->stmtName != NULL) {
-	UnallocateStatement(sdata->cdata->pgPtr, sdata->stmtName);
-	ckfree(sdata->stmtName);
-    }
-    if (sdata->nativeSql != NULL) {
-	Tcl_DecrRefCount(sdata->nativeSql);
-    }
-    if (sdata->origSql != NULL) {
-	/*
-	 * Non-frozen entries in the statements hash table don't hold
-	 * references to sdata, so when the refcount goes to zero
-	 * we remove the entry from the hash.  This way the the
-	 * statements hash contains only the currently referenced
-	 * statements (as metadata for statement objects, or intrep
-	 * for pgStatement ObjTypes), or frozen statements from
-	 * previous incarnations.
-	 *
-	 * If we're here and sdata->cdata is NULL it means that the
-	 * connection is being explicitly destroyed and the connection
-	 * destructor will take care of removing the hash entries itself.
-	 */
-	if (sdata->cdata) {
-	    he = Tcl_FindHashEntry(sdata->cdata->statements, sdata->origSql);
-	    if (he) {
-		Tcl_DeleteHashEntry(he);
+    Tcl_Obj* retval = Tcl_NewByteArrayObj(NULL, 0);
+    unsigned char* bytes;	/* Bytes of the result */
+    unsigned char* q;		/* Next byte of the result to store */
+    const char* p = buffer;	/* Next character of the value */
+    const char* end = buffer + buffSize;
+    int hi, lo;
+
+    if (buffSize >= 2 && p[0] == '\\' && p[1] == 'x') {
+	bytes = Tcl_SetByteArrayLength(retval, (buffSize - 2) / 2);
+	q = bytes;
+	for (p += 2; p + 1 < end; p += 2) {
+	    hi = isdigit((unsigned char) p[0]) ? p[0] - '0'
+		: (tolower((unsigned char) p[0]) - 'a' + 10);
+	    lo = isdigit((unsigned char) p[1]) ? p[1] - '0'
+		: (tolower((unsigned char) p[1]) - 'a' + 10);
+	    *q++ = (unsigned char) ((hi << 4) | lo);
+	}
+    } else {
+	bytes = Tcl_SetByteArrayLength(retval, buffSize);
+	q = bytes;
+	while (p < end) {
+	    if (*p != '\\') {
+		*q++ = (unsigned char) *p++;
+	    } else if (p + 1 < end && p[1] == '\\') {
+		*q++ = '\\';
+		p += 2;
+	    } else if (p + 3 < end) {
+		*q++ = (unsigned char) (((p[1] - '0') << 6)
+					| ((p[2] - '0') << 3)
+					| (p[3] - '0'));
+		p += 4;
+	    } else {
+		*q++ = (unsigned char) *p++;
 	    }
 	}
-	ckfree(sdata->origSql);
-	sdata->origSql = NULL;
-    }
-    if (sdata->params != NULL) {
-	ckfree(sdata->params);
-    }
-    if (sdata->paramDataTypes != NULL) {
-	ckfree(sdata->paramDataTypes);
-    }
-    if (sdata->subVars != NULL) {
-	Tcl_DecrRefCount(sdata->subVars);
-	sdata->subVars = NULL;
-    }
-    if (sdata->cdata) {
-	/*
-	 * sdata->cdata == NULL means this statement is frozen, and doesn't
-	 * hold a reference to cdata (which will have moved location when
-	 * we're thawed anyway).  The dependency on cdata->pgPtr for prepared
-	 * statements is implicit in that the only way to reach a frozen
-	 * statement is via the correct cdata's statements hash table.
-	 */
-	DecrConnectionRefCount(sdata->cdata);
     }
-    ckfree(sdata);
-    DBG("  <== DeleteStatement %s, statements remaining: %d\n", name(sdata), --g_statements);
+    Tcl_SetByteArrayLength(retval, (int) (q - bytes));
+    return retval;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * CloneStatement --
+ * FormatFloat --
  *
- *	Attempts to clone a Postgres statement's metadata.
+ *	Formats a finite double or float4 value the way that PostgreSQL
+ *	12 and later do by default: with the fewest digits that read back
+ *	as the same value, in exponential notation if the exponent is
+ *	below -4 or too large for the type's precision.
  *
  * Results:
- *	Returns the new metadata
- *
- * At present, we don't attempt to clone statements - it's not obvious
- * that such an action would ever even make sense.  Instead, we return NULL
- * to indicate that the metadata should not be cloned. (Note that this
- * action isn't right, either. What *is* right is to indicate that the object
- * is not clonable, but the API gives us no way to do that.
+ *	Returns the length of the text, which is stored in 'text'; at
+ *	least 32 bytes must be available there.
  *
  *-----------------------------------------------------------------------------
  */
 
 static int
-CloneStatement(
-    Tcl_Interp* interp,		/* Tcl interpreter for error reporting */
-    ClientData metadata,	/* Metadata to be cloned */
-    ClientData* newMetaData	/* Where to put the cloned metadata */
+FormatFloat(
+    char* text,			/* OUTPUT: Text of the value */
+    double value,		/* Value to format */
+    int isFloat4		/* Flag == 1 if the value is a float4 */
 ) {
-    Tcl_SetObjResult(interp,
-		     Tcl_NewStringObj("Postgres statements are not clonable",
-				      -1));
-    return TCL_ERROR;
+    char printed[TCL_DOUBLE_SPACE + 8];
+				/* Value as printed */
+    char digits[TCL_DOUBLE_SPACE];
+				/* Significant digits of the value */
+    int maxDigits = isFloat4 ? 9 : 17;
+				/* Digits that suffice for any value */
+    int nDigits = 0;		/* Number of significant digits */
+    int exponent;		/* Decimal exponent of the first digit */
+    int n = 0;			/* Length of the text */
+    int i;
+
+    if (value == 0.0) {
+	return sprintf(text, (1.0 / value < 0) ? "-0" : "0");
+    }
+    if (value < 0) {
+	text[n++] = '-';
+	value = -value;
+    }
+
+    /*
+     * Tcl prints a double with the fewest digits that read back as the
+     * value (unless tcl_precision is set), which are the server's digits
+     * unless they lie halfway between two values. Failing that, and for a float4, the shortest
+     * exponential form that reads back is searched for. Any decimal of
+     * up to FLT_DIG or DBL_DIG digits is the one printed to that many
+     * digits of the value nearest it, so the search starts there;
+     * subnormal values have too few bits for that, and are searched
+     * from a single digit.
+     */
+
+    if (!isFloat4) {
+	Tcl_PrintDouble(NULL, value, printed);
+	exponent = ParseDecimal(printed, digits, &nDigits);
+	if (!FloatReadsBack(digits, nDigits, exponent, value, 0)) {
+	    nDigits = 0;
+	}
+    }
+    if (nDigits == 0) {
+	if (value < (isFloat4 ? FLT_MIN : DBL_MIN)) {
+	    i = 1;
+	} else {
+	    i = isFloat4 ? FLT_DIG : DBL_DIG;
+	}
+	for (; ; ++i) {
+	    sprintf(printed, "%.*e", i - 1, value);
+	    exponent = ParseDecimal(printed, digits, &nDigits);
+	    if (i == maxDigits
+		|| FloatReadsBack(digits, nDigits, exponent, value,
+				  isFloat4)) {
+		break;
+	    }
+	}
+    }
+
+    /* Lay the digits out as the server does */
+
+    if (exponent < -4 || exponent >= (isFloat4 ? FLT_DIG : DBL_DIG)) {
+	text[n++] = digits[0];
+	if (nDigits > 1) {
+	    text[n++] = '.';
+	    memcpy(text + n, digits + 1, nDigits - 1);
+	    n += nDigits - 1;
+	}
+	n += sprintf(text + n, "e%c%02d", (exponent < 0) ? '-' : '+',
+		     abs(exponent));
+    } else if (exponent < 0) {
+	text[n++] = '0';
+	text[n++] = '.';
+	for (i = -1; i > exponent; --i) {
+	    text[n++] = '0';
+	}
+	memcpy(text + n, digits, nDigits);
+	n += nDigits;
+    } else {
+	for (i = 0; i <= exponent || i < nDigits; ++i) {
+	    if (i == exponent + 1) {
+		text[n++] = '.';
+	    }
+	    text[n++] = (i < nDigits) ? digits[i] : '0';
+	}
+    }
+    text[n] = '\0';
+    return n;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * AddStatementRef --
+ * ParseDecimal --
  *
- *	Adds obj as a reference to sdata in the pgStatement linked list,
- *	and increments the StatementData ref count
+ *	Takes apart a positive number printed in decimal, in fixed or
+ *	exponential notation.
  *
  * Results:
- *	None
+ *	Returns the decimal exponent of the first significant digit.
+ *
+ * Side effects:
+ *	Stores the significant digits, less any trailing zeroes, in
+ *	'digits', and their number in '*nDigitsPtr'.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-AddStatementRef(
-    Tcl_Obj* obj,
-    StatementData* sdata
+static int
+ParseDecimal(
+    const char* s,		/* Number as printed */
+    char* digits,		/* OUTPUT: Significant digits */
+    int* nDigitsPtr		/* OUTPUT: Number of significant digits */
 ) {
-    struct pgStatementRef* myRef = ckalloc(sizeof(struct pgStatementRef));
+    int nDigits = 0;		/* Number of significant digits */
+    int intDigits = 0;		/* Number of digits before the point */
+    int first = -1;		/* Position of the first significant
+				 * digit */
+    int seenPoint = 0;		/* Flag == 1 once past the point */
+    int i;
 
-    myRef->obj = obj;
-    DBG("Adding obj statement ref: %s: %s\n", name(obj), Tcl_GetString(obj));
-    myRef->next = sdata->pgStatements;
-    sdata->pgStatements = myRef;
-    IncrStatementRefCount(sdata);
+    for (i = 0; *s != '\0' && *s != 'e'; ++s) {
+	if (*s == '.') {
+	    seenPoint = 1;
+	    continue;
+	}
+	if (!seenPoint) {
+	    ++intDigits;
+	}
+	if (first < 0 && *s != '0') {
+	    first = i;
+	}
+	if (first >= 0) {
+	    digits[nDigits++] = *s;
+	}
+	++i;
+    }
+    while (nDigits > 1 && digits[nDigits-1] == '0') {
+	--nDigits;
+    }
+    *nDigitsPtr = nDigits;
+    return intDigits - 1 - first + ((*s == 'e') ? atoi(s + 1) : 0);
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * RemoveStatementRef --
+ * FloatReadsBack --
  *
- *	Removes obj as a reference to sdata from the pgStatement linked list,
- *	and decrements the StatementData ref count (if a ref to obj was found).
+ *	Determines whether a decimal form of a positive double or float4
+ *	value is one that PostgreSQL would accept as its shortest form.
  *
  * Results:
- *	None
+ *	Returns 1 if the decimal reads back as the value, and does not lie
+ *	exactly halfway between the value and one of its neighbours.
+ *
+ * The server never picks a decimal that reads back only by virtue of
+ * the round-half-even rule. Such a decimal is recognized by nudging it
+ * both ways, far below any digit it has: the two nudged forms then read
+ * back as different values. A point halfway between two values has too
+ * many digits to be a candidate unless the values are integers or
+ * nearly so, which they are only from 2**52 (2**22 for a float4) up;
+ * smaller values are spared the nudging.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-RemoveStatementRef(
-    Tcl_Obj* obj,
-    StatementData* sdata
+static int
+FloatReadsBack(
+    const char* digits,		/* Significant digits of the decimal */
+    int nDigits,		/* Number of significant digits */
+    int exponent,		/* Decimal exponent of the first digit */
+    double value,		/* Value that it is to read back as */
+    int isFloat4		/* Flag == 1 if the value is a float4 */
 ) {
-    struct pgStatementRef* p = sdata->pgStatements;
-    struct pgStatementRef* t = NULL;
-
-    if (p == NULL) return;
+    char decimal[96];		/* Decimal, possibly nudged up or down */
+    Tcl_WideUInt mantissa = 0;	/* Significant digits as an integer */
+    int i;
 
-    if (p->obj == obj) {
-	sdata->pgStatements = p->next;
-	ckfree(p);
-	p = NULL;
-	DecrStatementRefCount(sdata);
-	return;
+    for (i = 0; i < nDigits; ++i) {
+	mantissa = mantissa * 10 + (digits[i] - '0');
     }
-
-    while (p->next && p->next->obj != obj) {
-	p = p->next;
+    exponent -= nDigits - 1;
+    sprintf(decimal, "%" TCL_LL_MODIFIER "ue%d", mantissa, exponent);
+    if (isFloat4 ? (strtof(decimal, NULL) != (float) value)
+	: (strtod(decimal, NULL) != value)) {
+	return 0;
     }
-
-    if (p->next == NULL) {
-	return;
+    if (value < (isFloat4 ? 1048576.0 : 1125899906842624.0)) {
+	return 1;
     }
+    sprintf(decimal, "%" TCL_LL_MODIFIER "u%s1e%d", mantissa,
+	    "00000000000000000000000000000000000000000000000000000000000",
+	    exponent - 60);
+    if (isFloat4) {
+	float up = strtof(decimal, NULL);
 
-    t = p->next;
-    p->next = p->next->next;
-    ckfree(t);
-    t = NULL;
-    DecrStatementRefCount(sdata);
+	sprintf(decimal, "%" TCL_LL_MODIFIER "u%s9e%d", mantissa - 1,
+		"99999999999999999999999999999999999999999999999999999999999",
+		exponent - 60);
+	return strtof(decimal, NULL) == up;
+    } else {
+	double up = strtod(decimal, NULL);
+
+	sprintf(decimal, "%" TCL_LL_MODIFIER "u%s9e%d", mantissa - 1,
+		"99999999999999999999999999999999999999999999999999999999999",
+		exponent - 60);
+	return strtod(decimal, NULL) == up;
+    }
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * RemoveAllStatementRefs --
+ * FormatIsoDate --
  *
- *	Removes all pgStatement Intrep refs from sdata, invalidating the
- *	referring objects' intreps and decrementing the StatementData for
- *	each removed reference.
+ *	Formats a day number as YYYY-MM-DD in the proleptic Gregorian
+ *	calendar, as PostgreSQL does in the ISO date style.
  *
  * Results:
- *	None
+ *	Returns the length of the text, which is stored in 'text'.
+ *
+ * Side effects:
+ *	Stores the astronomical year in '*yearPtr'; years up to 0 are
+ *	formatted as years BC, and the caller appends the " BC".
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-RemoveAllStatementRefs(
-    StatementData* sdata
+static int
+FormatIsoDate(
+    char* text,			/* OUTPUT: Text of the date */
+    Tcl_WideInt days,		/* Days since 2000-01-01 */
+    int* yearPtr		/* OUTPUT: Year of the date */
 ) {
-    struct pgStatementRef* p = sdata->pgStatements;
-    struct pgStatementRef* n = NULL;
-    Tcl_ObjInternalRep* ir = NULL;
-
-    sdata->pgStatements = NULL;
-
-    while (p) {
-	ir = Tcl_FetchInternalRep(p->obj, &pgStatementType);
-	if (ir) {
-	    if (ir->twoPtrValue.ptr1) {
-		DBG("\t  Unlinking pgStatement Tcl_Obj %s from %s/%s\n", name(p->obj), name(sdata->cdata), name(sdata));
-		DecrStatementRefCount((StatementData*) ir->twoPtrValue.ptr1);
-		ir->twoPtrValue.ptr1 = NULL;
-	    }
-	    ir->twoPtrValue.ptr2 = NULL;
-	}
-	
-	n = p->next;
-	p->obj = NULL;
-	p->next = NULL;
-	ckfree(p);
-	p = n;
-    }
+    Tcl_WideInt z = days + POSTGRES_EPOCH_DAYS + 719468;
+				/* Days since 0000-03-01 */
+    Tcl_WideInt era;		/* Period of 400 years */
+    int doe, yoe, doy, mp;	/* Terms of the count of days */
+    int y, m, d;		/* Year, month and day */
+    int n;			/* Length of the text */
+
+    era = ((z >= 0) ? z : z - 146096) / 146097;
+    doe = (int) (z - era * 146097);
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = (mp < 10) ? mp + 3 : mp - 9;
+    y = (int) (yoe + era * 400) + (m <= 2);
+    *yearPtr = y;
+    n = FormatDigits(text, (y > 0) ? y : 1 - y, 4);
+    text[n++] = '-';
+    n += FormatDigits(text + n, m, 2);
+    text[n++] = '-';
+    n += FormatDigits(text + n, d, 2);
+    return n;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * FreeStatement --
+ * FormatDigits --
  *
- *	Frees a pgStatement ObjType intrep
+ *	Formats a nonnegative integer in decimal, padded with zeroes to a
+ *	given width, as the %0*d format would.
  *
  * Results:
- *	None
+ *	Returns the number of digits stored in 'text'.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-FreeStatement(
-    Tcl_Obj* obj
+static int
+FormatDigits(
+    char* text,			/* OUTPUT: Digits of the number */
+    int value,			/* Number to format */
+    int width			/* Least number of digits */
 ) {
-    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &pgStatementType);
-    StatementData* sdata = ir->twoPtrValue.ptr1;
+    int n = 0;			/* Number of digits */
+    int v;
 
-    DBG("FreeIntRep on pgStatement %s\n", name(obj));
-    if (ir->twoPtrValue.ptr1) {
-	/*
-	 * May be NULL already if the StatementData was unlinked from this
-	 * intrep when the associated connection was frozen.
-	 */
-	RemoveStatementRef(obj, sdata);
+    for (v = value; v != 0 || n < width; v /= 10) {
+	++n;
     }
-    ir->twoPtrValue.ptr1 = NULL;
-    ir->twoPtrValue.ptr2 = NULL;
+    for (v = n; v > 0; value /= 10) {
+	text[--v] = (char) ('0' + value % 10);
+    }
+    return n;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * DupStatement --
+ * PutNetworkOrder --
  *
- *	Duplicates a pgStatement ObjType intrep
+ *	Stores an unsigned integer as big-endian bytes.
  *
  * Results:
- *	None
+ *	None.
  *
  *-----------------------------------------------------------------------------
  */
 
 static void
-DupStatement(
-    Tcl_Obj* src,
-    Tcl_Obj* dup
+PutNetworkOrder(
+    char* buffer,		/* Place to store the bytes */
+    Tcl_WideUInt u,		/* Value to store */
+    int n			/* Number of bytes */
 ) {
-    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(src, &pgStatementType);
-    StatementData* sdata = ir->twoPtrValue.ptr1;
-
-    AddStatementRef(dup, sdata);
-    Tcl_StoreInternalRep(dup, &pgStatementType, ir);
+    while (n-- > 0) {
+	buffer[n] = (char) (u & 0xff);
+	u >>= 8;
+    }
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * UpdateStringOfStatement --
+ * ParseIsoDate --
  *
- *	Duplicates a pgStatement ObjType intrep
+ *	Parses a date in the form YYYY-MM-DD.
  *
  * Results:
- *	None
+ *	Returns 1 if the date is valid, 0 otherwise.
+ *
+ * Side effects:
+ *	Stores the number of days since 2000-01-01, the epoch of
+ *	PostgreSQL's binary dates, in '*daysPtr', and advances '*sPtr'
+ *	past the date.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-UpdateStringOfStatement(
-    Tcl_Obj* obj
+static int
+ParseIsoDate(
+    const char** sPtr,		/* IN/OUT: Text to parse */
+    int* daysPtr		/* OUTPUT: Days since 2000-01-01 */
 ) {
-    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &pgStatementType);
-    StatementData* sdata = ir->twoPtrValue.ptr1;
+    static const int monthDays[] = {
+	31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+    };
+    const char* s = *sPtr;
+    int y, m, d;		/* Year, month and day */
+    int era, yoe, doy, doe;	/* Terms of the count of days */
+    int i;
 
-    Tcl_InitStringRep(obj, sdata->origSql, strlen(sdata->origSql));
+    for (i = 0; i < 10; ++i) {
+	if ((i == 4 || i == 7) ? (s[i] != '-')
+	    : !isdigit((unsigned char) s[i])) {
+	    return 0;
+	}
+    }
+    y = atoi(s);
+    m = atoi(s + 5);
+    d = atoi(s + 8);
+    if (y < 1 || m < 1 || m > 12 || d < 1
+	|| d > monthDays[m-1] + (m == 2 && y % 4 == 0
+				 && (y % 100 != 0 || y % 400 == 0))) {
+	return 0;
+    }
+
+    /* Count the days in the proleptic Gregorian calendar */
+
+    y -= (m <= 2);
+    era = y / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    *daysPtr = era * 146097 + doe - 719468 - POSTGRES_EPOCH_DAYS;
+    *sPtr = s + 10;
+    return 1;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * GetPgStatementFromObj --
+ * ParseIsoTimestamp --
  *
- *	Duplicates a pgStatement ObjType intrep
+ *	Parses a timestamp in the form YYYY-MM-DD HH:MM:SS.FFFFFF, where a
+ *	'T' may separate the date and time, the fraction of a second may be
+ *	shorter or absent, and the time may be absent altogether.
  *
  * Results:
- *	None
+ *	Returns 1 if the timestamp is valid, 0 otherwise.
+ *
+ * Side effects:
+ *	Stores the number of microseconds since 2000-01-01 00:00:00 in
+ *	'*usecPtr'.
  *
  *-----------------------------------------------------------------------------
  */
 
-static void
-ThawTclObj(
-    Tcl_Obj** obj
+static int
+ParseIsoTimestamp(
+    const char* s,		/* Text to parse */
+    Tcl_WideInt* usecPtr	/* OUTPUT: Microseconds since the epoch */
 ) {
-    char* frozenStr = NULL;	/* Frozen string while replacing with Tcl_Obj */
+    int days;			/* Days since the epoch */
+    int h, m, sec;		/* Hours, minutes and seconds */
+    int usec = 0;		/* Microseconds */
+    int i;
 
-    if (*obj == NULL) {
-	return;
+    if (!ParseIsoDate(&s, &days)) {
+	return 0;
     }
-
-    frozenStr = (char*)*obj;
-    *obj = Tcl_NewStringObj(frozenStr, -1);
-    Tcl_IncrRefCount(*obj);
-    ckfree(frozenStr);
-    frozenStr = NULL;
+    if (*s == '\0') {
+	*usecPtr = (Tcl_WideInt) days * USECS_PER_DAY;
+	return 1;
+    }
+    if (*s != ' ' && *s != 'T') {
+	return 0;
+    }
+    ++s;
+    for (i = 0; i < 8; ++i) {
+	if ((i == 2 || i == 5) ? (s[i] != ':')
+	    : !isdigit((unsigned char) s[i])) {
+	    return 0;
+	}
+    }
+    h = atoi(s);
+    m = atoi(s + 3);
+    sec = atoi(s + 6);
+    if (h > 23 || m > 59 || sec > 59) {
+	return 0;
+    }
+    s += 8;
+    if (*s == '.') {
+	++s;
+	for (i = 0; i < 6 && isdigit((unsigned char) s[i]); ++i) {
+	    usec = 10 * usec + (s[i] - '0');
+	}
+	if (i == 0) {
+	    return 0;
+	}
+	s += i;
+	for (; i < 6; ++i) {
+	    usec *= 10;
+	}
+    }
+    if (*s != '\0') {
+	return 0;
+    }
+    *usecPtr = (Tcl_WideInt) days * USECS_PER_DAY
+	+ ((Tcl_WideInt) h * 3600 + m * 60 + sec) * 1000000 + usec;
+    return 1;
 }
 
-static int
-GetPgStatementFromObj(
-    Tcl_Interp* interp,
-    Tcl_Obj* obj,
-    ConnectionData* cdata,
-    StatementData** sdataOut
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * EncodeNumeric --
+ *
+ *	Converts a decimal number to PostgreSQL's binary format for
+ *	'numeric': a header of the count of base-10000 digits, the weight
+ *	of the first digit, the sign and the display scale, followed by
+ *	the digits, all as 16-bit integers.
+ *
+ * Results:
+ *	Returns a buffer allocated with ckalloc that holds the value, and
+ *	stores its length in '*lengthPtr'. Returns NULL if the text is not
+ *	a decimal number with an optional exponent, leaving it to the
+ *	server to make what it can of it.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static char*
+EncodeNumeric(
+    const char* s,		/* Text of the number */
+    int* lengthPtr		/* OUTPUT: Length of the value */
 ) {
-    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &pgStatementType);
-    Tcl_ObjInternalRep newIr;
-    StatementData* sdata = NULL;
-    Tcl_Obj* tokens = NULL;	/* The tokens of the statement to be prepared */
-    int tokenc;			/* Length of the 'tokens' list */
-    Tcl_Obj** tokenv;		/* Exploded tokens from the list */
-    Tcl_Obj* nativeSql = NULL;	/* SQL statement mapped to native form */
-    Tcl_Obj* subVars = NULL;	/* Substition variables, in order */
-    char* tokenStr;		/* Token string */
-    int tokenLen;		/* Length of a token */
-    char tmpstr[30];		/* Temporary array for strings */
-    PGresult* res;		/* Temporary result of libpq calls */
-    Tcl_HashEntry* he = NULL;	/* Frozen prepared statement */
-    int i, j, new;
-    const char* origSql = NULL;
-    int origSqlLen;
+    const char* intPart;	/* Digits before the decimal point */
+    const char* fracPart;	/* Digits after the decimal point */
+    int intLen, fracLen;	/* Number of digits in each part */
+    int exponent = 0;		/* Power of ten that scales the digits */
+    int expSign = 1;		/* Sign of the exponent */
+    int point;			/* Count of the digits that precede the
+				 * decimal point once the exponent is
+				 * applied */
+    int scale;			/* Count of digits after the point */
+    int intGroups;		/* Base-10000 digits before the point */
+    int nGroups;		/* Base-10000 digits in all */
+    int first;			/* First nonzero base-10000 digit */
+    int weight;			/* Weight of the first digit */
+    int negative = 0;		/* Flag == 1 if the number is negative */
+    char* buffer;		/* Binary value */
+    int group, digit, pos;
+    int i, j;
+
+    if (*s == '-') {
+	negative = 1;
+	++s;
+    } else if (*s == '+') {
+	++s;
+    }
+    intPart = s;
+    while (isdigit((unsigned char) *s)) {
+	++s;
+    }
+    intLen = s - intPart;
+    fracPart = s;
+    fracLen = 0;
+    if (*s == '.') {
+	fracPart = ++s;
+	while (isdigit((unsigned char) *s)) {
+	    ++s;
+	}
+	fracLen = s - fracPart;
+    }
+    if (intLen + fracLen == 0 || intLen + fracLen > NUMERIC_MAX_DIGITS) {
+	return NULL;
+    }
 
-    DBG("GetPgStatementFromObj %s \"%s\"\n", name(obj), Tcl_GetString(obj));
     /*
-     * Cached StatementData is only valid if the pgPtr matches the connection
-     * we used to prepare.  If ptr1 is NULL then the StatementData was unlinked
-     * from under us and we need to regenerate it.
+     * An exponent is accepted in the range the server allows, which
+     * covers everything that Tcl produces when it formats a double.
      */
-    if (ir && ir->twoPtrValue.ptr1 && ir->twoPtrValue.ptr2 == cdata->pgPtr) {
-	*sdataOut = ir->twoPtrValue.ptr1;
-	return TCL_OK;
+
+    if (*s == 'e' || *s == 'E') {
+	++s;
+	if (*s == '-') {
+	    expSign = -1;
+	    ++s;
+	} else if (*s == '+') {
+	    ++s;
+	}
+	if (!isdigit((unsigned char) *s)) {
+	    return NULL;
+	}
+	while (isdigit((unsigned char) *s)) {
+	    exponent = 10 * exponent + (*s++ - '0');
+	    if (exponent > NUMERIC_MAX_EXPONENT) {
+		return NULL;
+	    }
+	}
+	exponent *= expSign;
+    }
+    if (*s != '\0') {
+	return NULL;
+    }
+    while (intLen > 0 && *intPart == '0') {
+	++intPart;
+	--intLen;
+    }
+    point = intLen + exponent;
+    scale = fracLen - exponent;
+    if (scale < 0) {
+	scale = 0;
+    } else if (scale > NUMERIC_MAX_DSCALE) {
+	return NULL;
     }
 
     /*
-     * Not a pgStatementType, or not valid for this ConnectionData:
-     * attempt to convert it to one.
-     *
-     * Look for a frozen (previously detached) prepared statement.
+     * Group the digits by fours either side of the decimal point, and
+     * trim the groups that are zero at either end. Digit 'pos' counts
+     * from the first digit of the integer part, running on into the
+     * fraction; positions outside the digits given are zeroes.
      */
 
-    he = Tcl_CreateHashEntry(cdata->statements, Tcl_GetString(obj), &new);
-    if (!new) {
-	sdata = Tcl_GetHashValue(he);
-	DBG("\tRetrieved StatementData from statements hash: %s\n", name(sdata));
-	IncrStatementRefCount(sdata);	/* For sdata pointer */
-
-	if (sdata->cdata == NULL) {
-	    DBG("\t\tWas frozen, thawing\n");
-	    /* cdata == NULL means this statement was frozen, thaw it */
-
-	    sdata->cdata = cdata;
-	    IncrConnectionRefCount(sdata->cdata);
+    intGroups = (point > 0) ? (point + 3) / 4 : 0;
+    nGroups = intGroups + (scale + 3) / 4;
+    buffer = ckalloc(8 + 2 * nGroups);
+    for (i = 0; i < nGroups; ++i) {
+	group = 0;
+	for (j = 0; j < 4; ++j) {
+	    pos = point + 4 * (i - intGroups) + j;
+	    if (pos < 0 || pos >= intLen + fracLen) {
+		digit = 0;
+	    } else if (pos < intLen) {
+		digit = intPart[pos] - '0';
+	    } else {
+		digit = fracPart[pos - intLen] - '0';
+	    }
+	    group = 10 * group + digit;
+	}
+	PutNetworkOrder(buffer + 8 + 2 * i, group, 2);
+    }
+    weight = intGroups - 1;
+    for (first = 0;
+	 first < nGroups && GetNetworkOrder(buffer + 8 + 2 * first, 2) == 0;
+	 ++first) {
+	--weight;
+    }
+    while (nGroups > first
+	   && GetNetworkOrder(buffer + 8 + 2 * (nGroups - 1), 2) == 0) {
+	--nGroups;
+    }
+    if (first > 0) {
+	memmove(buffer + 8, buffer + 8 + 2 * first, 2 * (nGroups - first));
+    }
+    nGroups -= first;
+    if (nGroups == 0) {
+	weight = 0;
+	negative = 0;
+    }
 
-	    /*
-	     * To survive freezing the Tcl_Objs in StatementData are reduced to
-	     * char*s.  Reverse that here.
-	     */
+    PutNetworkOrder(buffer, nGroups, 2);
+    PutNetworkOrder(buffer + 2, (Tcl_WideUInt) weight, 2);
+    PutNetworkOrder(buffer + 4, negative ? NUMERIC_NEG : NUMERIC_POS, 2);
+    PutNetworkOrder(buffer + 6, scale, 2);
+    *lengthPtr = 8 + 2 * nGroups;
+    return buffer;
+}
 
-	    ThawTclObj(&sdata->subVars);
-	    ThawTclObj(&sdata->nativeSql);
-	    ThawTclObj(&sdata->columnNames);
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * EncodeBinaryParam --
+ *
+ *	Converts the value of a parameter to PostgreSQL's binary format
+ *	for its data type.
+ *
+ * Results:
+ *	Returns 1 and stores in '*lengthPtr' the length of the value if
+ *	the value could be converted. On entry, '*bufferPtr' points to a
+ *	slot of PARAM_SLOT_BYTES bytes, which receives a value of fixed
+ *	size; a value that does not fit is put instead in a buffer
+ *	allocated with ckalloc, and '*bufferPtr' is changed to point to
+ *	it. Returns 0 if the type has no binary
+ *	encoder here or the value is not in a form that the encoder
+ *	recognizes; the value is then sent as text for the server to
+ *	interpret, or reject.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-	    /* Frozen entries in the hash have their own references
-	     * (nothing else references them).  Thawed ones don't,
-	     * remove the cdata->statements ref now that we've thawed
-	     * this one.
-	     */
-	    DecrStatementRefCount(sdata);
+static int
+EncodeBinaryParam(
+    ConnectionData* cdata,	/* Connection data */
+    Oid type,			/* Data type of the parameter */
+    Tcl_Obj* valueObj,		/* Value of the parameter */
+    char** bufferPtr,		/* INPUT/OUTPUT: Binary value */
+    int* lengthPtr		/* OUTPUT: Length of the binary value */
+) {
+    union {
+	Tcl_WideUInt u;
+	double d;
+    } conv8;			/* Bits of a double */
+    union {
+	unsigned int u;
+	float f;
+    } conv4;			/* Bits of a float */
+    Tcl_WideInt w;
+    int i;
+    const char* s;
+    const char* value;
+    char* buffer = *bufferPtr;
+
+    switch (type) {
+    case BOOLOID:
+	if (Tcl_GetBooleanFromObj(NULL, valueObj, &i) != TCL_OK) {
+	    return 0;
 	}
-    } else {
-	DBG("query not found in cdata->statements: %s, existing statements:\n", Tcl_GetString(obj));
-	DUMP_STATEMENTS(cdata);
-
-	/* Tokenize the statement */
+	buffer[0] = (char) i;
+	*lengthPtr = 1;
+	break;
+
+    case INT2OID:
+	if (Tcl_GetWideIntFromObj(NULL, valueObj, &w) != TCL_OK
+	    || w < -0x8000 || w > 0x7FFF) {
+	    return 0;
+	}
+	PutNetworkOrder(buffer, (Tcl_WideUInt) w, 2);
+	*lengthPtr = 2;
+	break;
+
+    case INT4OID:
+	if (Tcl_GetWideIntFromObj(NULL, valueObj, &w) != TCL_OK
+	    || w < -(Tcl_WideInt) 0x80000000 || w > 0x7FFFFFFF) {
+	    return 0;
+	}
+	PutNetworkOrder(buffer, (Tcl_WideUInt) w, 4);
+	*lengthPtr = 4;
+	break;
 
-	tokens = Tdbc_TokenizeSql(interp, Tcl_GetString(obj));
-	if (tokens == NULL) {
-	    goto err;
+    case INT8OID:
+	if (Tcl_GetWideIntFromObj(NULL, valueObj, &w) != TCL_OK) {
+	    return 0;
 	}
-	Tcl_IncrRefCount(tokens);
+	PutNetworkOrder(buffer, (Tcl_WideUInt) w, 8);
+	*lengthPtr = 8;
+	break;
+
+    case FLOAT4OID:
+	if (Tcl_GetDoubleFromObj(NULL, valueObj, &conv8.d) != TCL_OK
+	    || (conv8.d - conv8.d == 0.0
+		&& (conv8.d > FLT_MAX || conv8.d < -FLT_MAX))) {
+	    return 0;		/* Let the server report the overflow */
+	}
+	conv4.f = (float) conv8.d;
+	PutNetworkOrder(buffer, conv4.u, 4);
+	*lengthPtr = 4;
+	break;
+
+    case FLOAT8OID:
+	if (Tcl_GetDoubleFromObj(NULL, valueObj, &conv8.d) != TCL_OK) {
+	    return 0;
+	}
+	PutNetworkOrder(buffer, conv8.u, 8);
+	*lengthPtr = 8;
+	break;
+
+    case OIDOID:
+	if (Tcl_GetWideIntFromObj(NULL, valueObj, &w) != TCL_OK
+	    || w < 0 || w > (Tcl_WideInt) 0xFFFFFFFF) {
+	    return 0;
+	}
+	PutNetworkOrder(buffer, (Tcl_WideUInt) w, 4);
+	*lengthPtr = 4;
+	break;
+
+    case NUMERICOID:
 
 	/*
-	 * Rewrite the tokenized statement to Postgres syntax. Reject the
-	 * statement if it is actually multiple statements.
+	 * Numbers that Tcl holds only in their internal form are formatted
+	 * here, the way Tcl would format them, rather than having the
+	 * object generate and keep a string representation. A double that
+	 * has a string representation is encoded from the string, which
+	 * keeps the scale that it was written with.
 	 */
 
-	if (Tcl_ListObjGetElements(interp, tokens, &tokenc, &tokenv) != TCL_OK) {
-	    goto err;
-	}
-
-	nativeSql = Tcl_NewObj();
-	Tcl_IncrRefCount(nativeSql);
-
-	subVars = Tcl_NewListObj(0, NULL);
-	Tcl_IncrRefCount(subVars);
-	
-	j=0;
+	if (valueObj->bytes == NULL
+	    && valueObj->typePtr == cdata->pidata->doubleType) {
+	    char text[TCL_DOUBLE_SPACE];
 
-	for (i = 0; i < tokenc; ++i) {
-	    tokenStr = Tcl_GetStringFromObj(tokenv[i], &tokenLen);
+	    Tcl_GetDoubleFromObj(NULL, valueObj, &conv8.d);
+	    if (conv8.d - conv8.d != 0.0) {
+		return 0;	/* Infinity and NaN go as text */
+	    }
+	    Tcl_PrintDouble(NULL, conv8.d, text);
+	    buffer = EncodeNumeric(text, lengthPtr);
+	} else if (Tcl_GetWideIntFromObj(NULL, valueObj, &w) == TCL_OK) {
+	    char text[TCL_INTEGER_SPACE];
 
-	    switch (tokenStr[0]) {
-	    case '$':
-	    case ':':
-		/*
-		 * A PostgreSQL cast is not a parameter!
-		 */
-		if (tokenStr[0] == ':' && tokenStr[1] == tokenStr[0]) {
-		    Tcl_AppendToObj(nativeSql, tokenStr, tokenLen);
-		    break;
-		}
+	    snprintf(text, sizeof(text), "%" TCL_LL_MODIFIER "d", w);
+	    buffer = EncodeNumeric(text, lengthPtr);
+	} else {
+	    buffer = EncodeNumeric(Tcl_GetString(valueObj), lengthPtr);
+	}
+	if (buffer == NULL) {
+	    return 0;
+	}
+	break;
 
-		j+=1;
-		snprintf(tmpstr, 30, "$%d", j);
-		Tcl_AppendToObj(nativeSql, tmpstr, -1);
-		Tcl_ListObjAppendElement(NULL, subVars,
-					Tcl_NewStringObj(tokenStr+1, tokenLen-1));
-		break;
+    case DATEOID:
+	s = Tcl_GetString(valueObj);
+	if (!ParseIsoDate(&s, &i) || *s != '\0') {
+	    return 0;
+	}
+	PutNetworkOrder(buffer, (unsigned int) i, 4);
+	*lengthPtr = 4;
+	break;
+
+    case TIMESTAMPOID:
+	value = PQparameterStatus(cdata->pgPtr, "integer_datetimes");
+	if (value == NULL || strcmp(value, "on") != 0
+	    || !ParseIsoTimestamp(Tcl_GetString(valueObj), &w)) {
+	    return 0;
+	}
+	PutNetworkOrder(buffer, (Tcl_WideUInt) w, 8);
+	*lengthPtr = 8;
+	break;
 
-	    case ';':
-		Tcl_SetObjResult(interp,
-				Tcl_NewStringObj("tdbc::postgres"
-						" does not support semicolons "
-						"in statements", -1));
-		goto err;
-		break;
+    case UUIDOID:
 
-	    default:
-		Tcl_AppendToObj(nativeSql, tokenStr, tokenLen);
-		break;
+	/*
+	 * Accept 32 hex digits, with a hyphen after any group of four as
+	 * PostgreSQL does
+	 */
 
+	s = Tcl_GetString(valueObj);
+	for (i = 0; i < 32; ++i) {
+	    if (*s == '-' && i > 0 && i % 4 == 0) {
+		++s;
 	    }
+	    if (!isxdigit((unsigned char) *s)) {
+		return 0;
+	    }
+	    conv4.u = isdigit((unsigned char) *s) ? (*s - '0')
+		: (tolower((unsigned char) *s) - 'a' + 10);
+	    if (i % 2 == 0) {
+		buffer[i/2] = (char) (conv4.u << 4);
+	    } else {
+		buffer[i/2] |= (char) conv4.u;
+	    }
+	    ++s;
 	}
+	if (*s != '\0') {
+	    return 0;
+	}
+	*lengthPtr = 16;
+	break;
 
-	Tcl_DecrRefCount(tokens);
-	tokens = NULL;
-
-	/*
-	 * Allocate an object to hold data about this statement
-	 */
+    default:
+	return 0;
+    }
+    *bufferPtr = buffer;
+    return 1;
+}
 
-	sdata = NewStatement(cdata);
-	DBG("\nCreated fresh StatementData: %s\n", name(sdata));
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ArrayElementType --
+ *
+ *	Finds the element type of an array type.
+ *
+ * Results:
+ *	Returns the type number of the elements, or UNTYPEDOID if the type
+ *	is not an array type listed in 'arrayTypes'.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-	/*
-	 * Can't point origSql to obj - it would be a circular reference (obj
-	 * referenced in obj's intrep), so it would never be freed
-	 */
-	origSql = Tcl_GetStringFromObj(obj, &origSqlLen);
-	sdata->origSql = ckalloc(origSqlLen+1);
-	memcpy(sdata->origSql, origSql, origSqlLen+1);
+static Oid
+ArrayElementType(
+    Oid arrayOid		/* Type number of the array */
+) {
+    int i;
 
-	sdata->nativeSql = nativeSql;
-	nativeSql = NULL;
-	sdata->subVars = subVars;
-	subVars = NULL;
+    for (i = 0; arrayTypes[i].arrayOid != 0; ++i) {
+	if (arrayTypes[i].arrayOid == arrayOid) {
+	    return arrayTypes[i].elementOid;
+	}
+    }
+    return UNTYPEDOID;
+}
 
-	Tcl_ListObjLength(NULL, sdata->subVars, &sdata->nParams);
-	sdata->params = (ParamData*) ckalloc(sdata->nParams * sizeof(ParamData));
-	memset(sdata->params, 0, sdata->nParams * sizeof(ParamData));
-	sdata->paramDataTypes = (Oid*) ckalloc(sdata->nParams * sizeof(Oid));
-	memset(sdata->paramDataTypes, 0, sdata->nParams * sizeof(Oid));
-	for (i = 0; i < sdata->nParams; ++i) {
-	    sdata->params[i].flags = PARAM_IN;
-	    sdata->paramDataTypes[i] = UNTYPEDOID ;
-	    sdata->params[i].precision = 0;
-	    sdata->params[i].scale = 0;
-	}
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * EncodeArrayParam --
+ *
+ *	Converts a Tcl list to a one-dimensional PostgreSQL array.
+ *
+ * Results:
+ *	Returns a buffer allocated with ckalloc that holds the array, and
+ *	stores its length in '*lengthPtr' and its format in '*formatPtr'.
+ *	The array is in binary format if every element can be encoded in
+ *	binary, and otherwise in the text format of an array literal with
+ *	every element quoted, for the server to interpret. Returns NULL if
+ *	the value is not a list of several elements and looks like an array
+ *	literal, such as {1,2,3}; the caller sends it as it is.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-	/* Prepare the statement */
+static char*
+EncodeArrayParam(
+    ConnectionData* cdata,	/* Connection data */
+    Oid elementType,		/* Data type of the elements */
+    Tcl_Obj* valueObj,		/* Value of the parameter */
+    int* lengthPtr,		/* OUTPUT: Length of the value */
+    int* formatPtr		/* OUTPUT: 1 for binary, 0 for text */
+) {
+    Tcl_Obj** elemv;		/* Elements of the list */
+    int elemc;			/* Number of elements */
+    char slot[PARAM_SLOT_BYTES];
+				/* Binary value of a fixed-size element */
+    char header[20];		/* Array header, or element length */
+    char* bufPtr;		/* Binary value of an element */
+    const char* s;		/* Text of an element */
+    char* buffer;		/* Encoded array */
+    Tcl_DString ds;		/* Encoded array, as it is built */
+    int len;
+    int i;
 
-	res = PrepareStatement(interp, sdata, NULL);
-	if (res == NULL) {
-	    goto err;
+    if (valueObj->typePtr != cdata->pidata->listType) {
+	s = Tcl_GetStringFromObj(valueObj, &len);
+	while (len > 0 && isspace((unsigned char) *s)) {
+	    ++s;
+	    --len;
 	}
-	if (TransferResultError(interp, res) != TCL_OK) {
-	    PQclear(res);
-	    goto err;
+	if (len > 0 && *s == '{'
+	    && (Tcl_ListObjLength(NULL, valueObj, &elemc) != TCL_OK
+		|| elemc == 1)) {
+	    return NULL;
 	}
-
-	PQclear(res);
-
-	/* Record this statement in the connection's statements hash table */
-
-	DBG("Recording %s/%s in cdata->statements\n", name(cdata), name(sdata));
-	Tcl_SetHashValue(he, sdata);
+    }
+    if (Tcl_ListObjGetElements(NULL, valueObj, &elemc, &elemv) != TCL_OK) {
+	return NULL;
     }
 
-    newIr.twoPtrValue.ptr1 = sdata;
-    newIr.twoPtrValue.ptr2 = cdata->pgPtr;
-    Tcl_StoreInternalRep(obj, &pgStatementType, &newIr);
-
-    /* Add a ref for our intrep */
-
-    AddStatementRef(obj, sdata);
-
-    /* Drop the ref for our sdata pointer */
-
-    DecrStatementRefCount(sdata);
-    sdata = NULL;
-
-    *sdataOut = newIr.twoPtrValue.ptr1;
-
-    return TCL_OK;
+    /*
+     * Binary format: the number of dimensions, a flag for NULL elements,
+     * the element type, the length and lower bound of the dimension, and
+     * then each element preceded by its length.
+     */
 
+    Tcl_DStringInit(&ds);
+    PutNetworkOrder(header, (elemc > 0), 4);
+    PutNetworkOrder(header + 4, 0, 4);
+    PutNetworkOrder(header + 8, elementType, 4);
+    PutNetworkOrder(header + 12, (Tcl_WideUInt) elemc, 4);
+    PutNetworkOrder(header + 16, 1, 4);
+    Tcl_DStringAppend(&ds, header, (elemc > 0) ? 20 : 12);
+    for (i = 0; i < elemc; ++i) {
+	bufPtr = slot;
+	switch (elementType) {
+	case TEXTOID:
+	case VARCHAROID:
+	case BPCHAROID:
+	case NAMEOID:
+	    s = Tcl_GetStringFromObj(elemv[i], &len);
+	    break;
+	case BYTEAOID:
+	    s = (const char*) Tcl_GetByteArrayFromObj(elemv[i], &len);
+	    break;
+	default:
+	    if (!EncodeBinaryParam(cdata, elementType, elemv[i],
+				   &bufPtr, &len)) {
+		goto textFormat;
+	    }
+	    s = bufPtr;
+	    break;
+	}
+	PutNetworkOrder(header, (Tcl_WideUInt) len, 4);
+	Tcl_DStringAppend(&ds, header, 4);
+	Tcl_DStringAppend(&ds, s, len);
+	if (bufPtr != slot) {
+	    ckfree(bufPtr);
+	}
+    }
+    *formatPtr = 1;
+    goto done;
 
-    /* On error, unwind all the resource allocations */
+    /*
+     * Text format: {"element","element",...} with backslashes before
+     * quotes and backslashes in the elements.
+     */
 
- err:
-    if (nativeSql) {
-	Tcl_DecrRefCount(nativeSql);
-	nativeSql = NULL;
-    }
-    if (subVars) {
-	Tcl_DecrRefCount(subVars);
-	subVars = NULL;
-    }
-    if (tokens) {
-	Tcl_DecrRefCount(tokens);
-	tokens = NULL;
-    }
-    if (new && he) {
-	Tcl_DeleteHashEntry(he);
-	he = NULL;
-    }
-    if (sdata) {
-	DecrStatementRefCount(sdata);
-	sdata = NULL;
-    }
-    return TCL_ERROR;
+ textFormat:
+    Tcl_DStringSetLength(&ds, 0);
+    Tcl_DStringAppend(&ds, "{", 1);
+    for (i = 0; i < elemc; ++i) {
+	const char* p;
+
+	s = Tcl_GetStringFromObj(elemv[i], &len);
+	Tcl_DStringAppend(&ds, (i > 0) ? ",\"" : "\"", -1);
+	for (p = s; p < s + len; ++p) {
+	    if (*p == '"' || *p == '\\') {
+		Tcl_DStringAppend(&ds, s, p - s);
+		Tcl_DStringAppend(&ds, "\\", 1);
+		s = p;
+	    }
+	}
+	Tcl_DStringAppend(&ds, s, p - s);
+	Tcl_DStringAppend(&ds, "\"", 1);
+    }
+    Tcl_DStringAppend(&ds, "}", 1);
+    *formatPtr = 0;
+
+ done:
+    *lengthPtr = Tcl_DStringLength(&ds);
+    buffer = ckalloc(*lengthPtr + 1);
+    memcpy(buffer, Tcl_DStringValue(&ds), *lengthPtr + 1);
+    Tcl_DStringFree(&ds);
+    return buffer;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * ResultSetConstructor --
+ * BlobCmd --
  *
- *	Constructs a new result set.
+ *	Wraps a channel so that its contents are bound to a parameter.
  *
  * Usage:
- *	$resultSet new statement ?dictionary?
- *	$resultSet create name statement ?dictionary?
- *
- * Parameters:
- *	statement -- Statement handle to which this resultset belongs
- *	dictionary -- Dictionary containing the substitutions for named
- *		      parameters in the given statement.
+ *	::tdbc::postgres::blob channel
  *
  * Results:
- *	Returns a standard Tcl result.  On error, the interpreter result
- *	contains an appropriate message.
+ *	Returns a standard Tcl result. The interpreter result is a handle
+ *	that, given as a parameter, is read from the channel when the
+ *	statement is executed.
+ *
+ * Side effects:
+ *	Records the handle in the interpreter's table of handles, until
+ *	the channel is closed.
  *
  *-----------------------------------------------------------------------------
  */
 
 static int
-ResultSetConstructor(
+BlobCmd(
     ClientData clientData,	/* Not used */
     Tcl_Interp* interp,		/* Tcl interpreter */
-    Tcl_ObjectContext context,	/* Object context  */
-    int objc, 			/* Parameter count */
+    int objc,			/* Parameter count */
     Tcl_Obj *const objv[]	/* Parameter vector */
 ) {
-    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
-				/* The current result set object */
-    int skip = Tcl_ObjectContextSkippedArgs(context);
-				/* Number of args to skip */
-    Tcl_Object statementObject;	/* The current statement object */
-    ConnectionData* cdata;	/* The Postgres connection object's data */
-
-    StatementData* sdata;	/* The statement object's data */
-    ResultSetData* rdata;	/* THe result set object's data */
-    Tcl_Obj* paramNameObj;	/* Name of the current parameter */
-    const char* paramName;	/* Name of the current parameter */
-    Tcl_Obj* paramValObj;	/* Value of the current parameter */
-
-    const char** paramValues;	/* Table of values */
-    int* paramLengths;		/* Table of parameter lengths */
-    int* paramFormats;		/* Table of parameter formats
-				 * (binary or string) */
-    char* paramNeedsFreeing;	/* Flags for whether a parameter needs
-				 * its memory released */
-    Tcl_Obj** paramTempObjs;	/* Temporary parameter objects allocated
-				 * to canonicalize numeric parameter values */
+    BlobTable* table;		/* Table of handles */
+    BlobHandle* handle;		/* New handle */
+    Tcl_Channel chan;		/* Channel to wrap */
+    Tcl_Obj* nameObj;		/* Name of the handle */
+    int mode;
+    int isNew;
 
-    PGresult* res;		/* Temporary result */
-    int i;
-    int status = TCL_ERROR;	/* Return status */
-
-    /* Check parameter count */
+    (void)clientData;
 
-    if (objc != skip+1 && objc != skip+2) {
-	Tcl_WrongNumArgs(interp, skip, objv, "statement ?dictionary?");
+    if (objc != 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "channel");
 	return TCL_ERROR;
     }
-
-    /* Initialize the base classes */
-
-    Tcl_ObjectContextInvokeNext(interp, context, skip, objv, skip);
-
-    /* Find the statement object, and get the statement data */
-
-    statementObject = Tcl_GetObjectFromObj(interp, objv[skip]);
-    if (statementObject == NULL) {
+    chan = Tcl_GetChannel(interp, Tcl_GetString(objv[1]), &mode);
+    if (chan == NULL) {
 	return TCL_ERROR;
     }
-    sdata = (StatementData*) Tcl_ObjectGetMetadata(statementObject,
-						   &statementDataType);
-    if (sdata == NULL) {
-	Tcl_AppendResult(interp, Tcl_GetString(objv[skip]),
-			 " does not refer to a Postgres statement", NULL);
+    if (!(mode & TCL_READABLE)) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf("channel \"%s\" wasn't "
+					       "opened for reading",
+					       Tcl_GetString(objv[1])));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
 	return TCL_ERROR;
     }
-    cdata = sdata->cdata;
+    table = GetBlobTable(interp, 1);
+    nameObj = Tcl_ObjPrintf("pgblob%d", ++table->counter);
+    handle = (BlobHandle*) ckalloc(sizeof(BlobHandle));
+    handle->entry = Tcl_CreateHashEntry(&table->handles,
+					Tcl_GetString(nameObj), &isNew);
+    handle->chan = chan;
+    Tcl_SetHashValue(handle->entry, (ClientData) handle);
+    Tcl_CreateCloseHandler(chan, BlobChannelClosed, (ClientData) handle);
+    Tcl_SetObjResult(interp, nameObj);
+    return TCL_OK;
+}
 
-    rdata = (ResultSetData*) ckalloc(sizeof(ResultSetData));
-    memset(rdata, 0, sizeof(ResultSetData));
-    rdata->refCount = 1;
-    rdata->sdata = sdata;
-    rdata->stmtName = NULL;
-    rdata->execResult = NULL;
-    rdata->rowCount = 0;
-    IncrStatementRefCount(sdata);
-    Tcl_ObjectSetMetadata(thisObject, &resultSetDataType, (ClientData) rdata);
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetBlobTable --
+ *
+ *	Finds the table of the handles made by ::tdbc::postgres::blob in
+ *	an interpreter.
+ *
+ * Results:
+ *	Returns the table, or NULL if there is none and 'create' is 0.
+ *
+ * Side effects:
+ *	Creates the table if there is none and 'create' is 1.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-    /*
-     * Find a statement handle that we can use to execute the SQL code.
-     * If the main statement handle associated with the statement
-     * is idle, we can use it.  Otherwise, we have to allocate and
-     * prepare a fresh one.
-     */
+static BlobTable*
+GetBlobTable(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    int create			/* Flag == 1 to create a missing table */
+) {
+    BlobTable* table = (BlobTable*)
+	Tcl_GetAssocData(interp, BLOB_TABLE_KEY, NULL);
 
-    if (sdata->flags & STMT_FLAG_BUSY) {
-	rdata->stmtName = GenStatementName(cdata);
-	res = PrepareStatement(interp, sdata, rdata->stmtName);
-	if (res == NULL) {
-	    return TCL_ERROR;
-	}
-	if (TransferResultError(interp, res) != TCL_OK) {
-	    PQclear(res);
-	    return TCL_ERROR;
-	}
-	PQclear(res);
-    } else {
-	rdata->stmtName = sdata->stmtName;
-	sdata->flags |= STMT_FLAG_BUSY;
+    if (table == NULL && create) {
+	table = (BlobTable*) ckalloc(sizeof(BlobTable));
+	Tcl_InitHashTable(&table->handles, TCL_STRING_KEYS);
+	table->counter = 0;
+	Tcl_SetAssocData(interp, BLOB_TABLE_KEY, DeleteBlobTable,
+			 (ClientData) table);
+    }
+    return table;
+}
 
-	/* We need to check if parameter types changed since the
-	 * statement was prepared. If so, the statement is no longer
-	 * usable, so we prepare it once again */
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteBlobTable --
+ *
+ *	Deletes the table of handles when its interpreter is deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Forgets the handles whose channels are still open.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-	if (sdata->paramTypesChanged) {
-	    UnallocateStatement(cdata->pgPtr, sdata->stmtName);
-	    ckfree(sdata->stmtName);
-	    sdata->stmtName = GenStatementName(cdata);
-	    rdata->stmtName = sdata->stmtName;
-	    res = PrepareStatement(interp, sdata, NULL);
-	    if (res == NULL) {
-		return TCL_ERROR;
-	    }
-	    if (TransferResultError(interp, res) != TCL_OK) {
-		PQclear(res);
-		return TCL_ERROR;
-	    }
-	    PQclear(res);
-	    sdata->paramTypesChanged = 0;
-	}
-    }
+static void
+DeleteBlobTable(
+    ClientData clientData,	/* Table of handles */
+    Tcl_Interp* interp		/* Not used */
+) {
+    BlobTable* table = (BlobTable*) clientData;
+    Tcl_HashSearch search;
+    Tcl_HashEntry* entry;
+    BlobHandle* handle;
 
-    paramValues = (const char**) ckalloc(sdata->nParams * sizeof(char* ));
-    paramLengths = (int*) ckalloc(sdata->nParams * sizeof(int*));
-    paramFormats = (int*) ckalloc(sdata->nParams * sizeof(int*));
-    paramNeedsFreeing = (char *)ckalloc(sdata->nParams);
-    paramTempObjs = (Tcl_Obj**) ckalloc(sdata->nParams * sizeof(Tcl_Obj*));
+    (void)interp;
 
-    memset(paramNeedsFreeing, 0, sdata->nParams);
-    for (i = 0; i < sdata->nParams; i++) {
-	paramTempObjs[i] = NULL;
+    for (entry = Tcl_FirstHashEntry(&table->handles, &search);
+	 entry != NULL;
+	 entry = Tcl_NextHashEntry(&search)) {
+	handle = (BlobHandle*) Tcl_GetHashValue(entry);
+	Tcl_DeleteCloseHandler(handle->chan, BlobChannelClosed,
+			       (ClientData) handle);
+	ckfree(handle);
     }
+    Tcl_DeleteHashTable(&table->handles);
+    ckfree(table);
+}
 
-    for (i=0; i<sdata->nParams; i++) {
-	Tcl_ListObjIndex(NULL, sdata->subVars, i, &paramNameObj);
-	paramName = Tcl_GetString(paramNameObj);
-	if (objc == skip+2) {
-	    /* Param from a dictionary */
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BlobChannelClosed --
+ *
+ *	Forgets a handle when its channel is closed.
+ *
+ * Results:
+ *	None.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-	    if (Tcl_DictObjGet(interp, objv[skip+1],
-			       paramNameObj, &paramValObj) != TCL_OK) {
-		goto freeParamTables;
-	    }
-	} else {
-	    /* Param from a variable */
+static void
+BlobChannelClosed(
+    ClientData clientData	/* Handle of the channel */
+) {
+    BlobHandle* handle = (BlobHandle*) clientData;
 
-	    paramValObj = Tcl_GetVar2Ex(interp, paramName, NULL,
-					TCL_LEAVE_ERR_MSG);
+    Tcl_DeleteHashEntry(handle->entry);
+    ckfree(handle);
+}
 
-	}
-	/* At this point, paramValObj contains the parameter value */
-	if (paramValObj != NULL) {
-	    char * bufPtr;
-	    int32_t tmp32;
-	    int16_t tmp16;
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FindBlobHandle --
+ *
+ *	Tells whether a value is a handle made by ::tdbc::postgres::blob
+ *	whose channel is still open.
+ *
+ * Results:
+ *	Returns the handle, or NULL if the value is not one.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-	    switch (sdata->paramDataTypes[i]) {
-	    case INT2OID:
-		bufPtr = (char *)ckalloc(sizeof(int));
-		if (Tcl_GetIntFromObj(interp, paramValObj,
-				      (int*) bufPtr) != TCL_OK) {
-		    goto freeParamTables;
-		}
-		paramValues[i] = (char *)ckalloc(sizeof(int16_t));
-		paramNeedsFreeing[i] = 1;
-		tmp16 = *(int*) bufPtr;
-		ckfree(bufPtr);
-		*(int16_t*)(paramValues[i])=htons(tmp16);
-		paramFormats[i] = 1;
-		paramLengths[i] = sizeof(int16_t);
-		break;
+static BlobHandle*
+FindBlobHandle(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_Obj* objPtr		/* Value to test */
+) {
+    BlobTable* table = GetBlobTable(interp, 0);
+    Tcl_HashEntry* entry;
 
-	    case INT4OID:
-		bufPtr = (char *)ckalloc(sizeof(long));
-		if (Tcl_GetLongFromObj(interp, paramValObj,
-				       (long*) bufPtr) != TCL_OK) {
-		    goto freeParamTables;
-		}
-		paramValues[i] = (char *)ckalloc(sizeof(int32_t));
-		paramNeedsFreeing[i] = 1;
-		tmp32 = *(long*) bufPtr;
-		ckfree(bufPtr);
-		*((int32_t*)(paramValues[i]))=htonl(tmp32);
-		paramFormats[i] = 1;
-		paramLengths[i] = sizeof(int32_t);
-		break;
+    /* Without any handle, no value need have its string looked up */
 
-		/*
-		 * With INT8, FLOAT4, FLOAT8, and NUMERIC, we will be passing
-		 * the parameter as text, but it may not be in a canonical
-		 * format, because Tcl will recognize binary, octal, and hex
-		 * constants where Postgres will not. Begin by extracting
-		 * wide int, float, or bignum from the parameter. If that
-		 * succeeds, reconvert the result to text to canonicalize
-		 * it, and send that text over.
-		 */
+    if (table == NULL || table->handles.numEntries == 0) {
+	return NULL;
+    }
+    entry = Tcl_FindHashEntry(&table->handles, Tcl_GetString(objPtr));
+    return (entry == NULL) ? NULL : (BlobHandle*) Tcl_GetHashValue(entry);
+}
 
-	    case INT8OID:
-	    case NUMERICOID:
-		{
-		    Tcl_WideInt val;
-		    if (Tcl_GetWideIntFromObj(NULL, paramValObj, &val)
-			== TCL_OK) {
-			paramTempObjs[i] = Tcl_NewWideIntObj(val);
-			Tcl_IncrRefCount(paramTempObjs[i]);
-			paramFormats[i] = 0;
-			paramValues[i] =
-			    Tcl_GetStringFromObj(paramTempObjs[i],
-						 &paramLengths[i]);
-		    } else {
-			goto convertString;
-				/* If Tcl can't parse it, let SQL try */
-		    }
-		}
-		break;
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetBlobChannel --
+ *
+ *	Finds the channel of a value made by ::tdbc::postgres::blob, and
+ *	readies it for reading.
+ *
+ * Results:
+ *	Returns the channel, or NULL with an error message in the
+ *	interpreter if it cannot be set up.
+ *
+ * Side effects:
+ *	Sets the channel to binary translation, since the value is read
+ *	as bytes.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-	    case FLOAT4OID:
-	    case FLOAT8OID:
-		{
-		    double val;
-		    if (Tcl_GetDoubleFromObj(NULL, paramValObj, &val)
-			== TCL_OK) {
-			paramTempObjs[i] = Tcl_NewDoubleObj(val);
-			Tcl_IncrRefCount(paramTempObjs[i]);
-			paramFormats[i] = 0;
-			paramValues[i] =
-			    Tcl_GetStringFromObj(paramTempObjs[i],
-						 &paramLengths[i]);
-		    } else {
-			goto convertString;
-				/* If Tcl can't parse it, let SQL try */
-		    }
-		}
-		break;
+static Tcl_Channel
+GetBlobChannel(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_Obj* blobObj		/* Handle made by ::tdbc::postgres::blob */
+) {
+    Tcl_Channel chan = FindBlobHandle(interp, blobObj)->chan;
 
-	    case BYTEAOID:
-		paramFormats[i] = 1;
-		paramValues[i] =
-		    (char*)Tcl_GetByteArrayFromObj(paramValObj,
-						   &paramLengths[i]);
-		break;
+    if (Tcl_SetChannelOption(interp, chan, "-translation",
+			     "binary") != TCL_OK) {
+	return NULL;
+    }
+    return chan;
+}
 
-	    default:
-	    convertString:
-		paramFormats[i] = 0;
-		paramValues[i] = Tcl_GetStringFromObj(paramValObj,
-						      &paramLengths[i]);
-		break;
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReadBlobChunk --
+ *
+ *	Reads the next chunk of a channel bound to a parameter.
+ *
+ * Results:
+ *	Returns the number of bytes read, which is 0 at the end of the
+ *	channel, or -1 with an error message in the interpreter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ReadBlobChunk(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_Channel chan,		/* Channel to read */
+    char* buffer		/* Buffer of BLOB_CHUNK_BYTES bytes */
+) {
+    int n;
+
+    n = Tcl_Read(chan, buffer, BLOB_CHUNK_BYTES);
+    if (n < 0) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf("error reading \"%s\": %s",
+					       Tcl_GetChannelName(chan),
+					       Tcl_PosixError(interp)));
+	return -1;
+    }
+    if (n == 0 && Tcl_InputBlocked(chan)) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf("channel \"%s\" has no data "
+					       "ready; a channel bound to a "
+					       "parameter must be blocking",
+					       Tcl_GetChannelName(chan)));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
+	return -1;
+    }
+    return n;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReadBlobParam --
+ *
+ *	Reads the contents of a channel bound to a parameter.
+ *
+ * Results:
+ *	Returns a buffer, allocated with ckalloc, holding the contents
+ *	followed by a NUL byte, and stores their length in '*lengthPtr'.
+ *	Returns NULL with an error message in the interpreter if the
+ *	channel cannot be read or holds more than the connection's
+ *	-maxblobbytes limit or a field allows.
+ *
+ * Side effects:
+ *	Reads the channel to its end, or until the limit is exceeded.
+ *
+ * The protocol sends a parameter in one message, so the contents must be
+ * in memory in full; they are read a chunk at a time straight into the
+ * buffer, and never become a Tcl value.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static char*
+ReadBlobParam(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ConnectionData* cdata,	/* Connection data */
+    Tcl_Obj* blobObj,		/* Handle made by ::tdbc::postgres::blob */
+    int* lengthPtr		/* OUTPUT: Length of the contents */
+) {
+    Tcl_Channel chan;		/* Channel to read */
+    char* buffer = NULL;	/* Contents read so far */
+    size_t size = 0;		/* Allocated size of the buffer */
+    size_t length = 0;		/* Length of the contents read so far */
+    Tcl_WideInt limit = BLOB_MAX_BYTES;
+				/* Most bytes that may be read */
+    int n;
+
+    if ((chan = GetBlobChannel(interp, blobObj)) == NULL) {
+	return NULL;
+    }
+    if (cdata->maxBlobBytes > 0 && cdata->maxBlobBytes < limit) {
+	limit = cdata->maxBlobBytes;
+    }
+    do {
+	if ((Tcl_WideInt) length > limit) {
+	    if (limit == BLOB_MAX_BYTES) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "channel \"%s\" holds more than %d bytes, the largest "
+		    "value of a field", Tcl_GetChannelName(chan),
+		    BLOB_MAX_BYTES));
+	    } else {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "channel \"%s\" holds more than %" TCL_LL_MODIFIER "d "
+		    "bytes, the limit set by -maxblobbytes",
+		    Tcl_GetChannelName(chan), limit));
 	    }
-	} else {
-	    paramValues[i] = NULL;
-	    paramFormats[i] = 0;
+	    Tcl_SetErrorCode(interp, "TDBC", "PROGRAM_LIMIT_EXCEEDED",
+			     "54000", "POSTGRES", "-1", NULL);
+	    ckfree(buffer);
+	    return NULL;
+	}
+	if (size - length < BLOB_CHUNK_BYTES + 1) {
+	    size = (size == 0) ? 4 * BLOB_CHUNK_BYTES : 2 * size;
+	    buffer = (char*) ckrealloc(buffer, size);
+	}
+	n = ReadBlobChunk(interp, chan, buffer + length);
+	if (n < 0) {
+	    ckfree(buffer);
+	    return NULL;
+	}
+	length += n;
+    } while (n > 0);
+    buffer[length] = '\0';
+    *lengthPtr = (int) length;
+    return buffer;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * WriteBlobParam --
+ *
+ *	Copies the contents of a channel bound to an oid parameter into
+ *	a new large object.
+ *
+ * Results:
+ *	Returns a standard Tcl result, and stores the oid of the large
+ *	object in '*oidPtr' if successful.
+ *
+ * Side effects:
+ *	Reads the channel to its end. The contents pass through a buffer
+ *	of BLOB_CHUNK_BYTES, so that no more than that is ever in memory.
+ *	Large objects are accessed only within a transaction; if none is
+ *	open, one is opened and committed around the copy.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+WriteBlobParam(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ConnectionData* cdata,	/* Connection data */
+    Tcl_Obj* blobObj,		/* Handle made by ::tdbc::postgres::blob */
+    Oid* oidPtr			/* OUTPUT: Oid of the large object */
+) {
+    PGconn* pgPtr = cdata->pgPtr;
+				/* Connection handle */
+    Tcl_Channel chan;		/* Channel to read */
+    char* buffer;		/* Chunk of the contents */
+    int ownTransaction;		/* Flag == 1 if the copy is a transaction
+				 * of its own */
+    Oid oid;			/* Oid of the large object */
+    int fd;			/* Descriptor of the large object */
+    int n;
+
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK
+	|| (chan = GetBlobChannel(interp, blobObj)) == NULL) {
+	return TCL_ERROR;
+    }
+    ownTransaction = (PQtransactionStatus(pgPtr) == PQTRANS_IDLE);
+    if (ownTransaction
+	&& ExecSimpleQuery(interp, pgPtr, "BEGIN", NULL) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    buffer = (char*) ckalloc(BLOB_CHUNK_BYTES);
+    if ((oid = lo_creat(pgPtr, INV_READ | INV_WRITE)) == 0
+	|| (fd = lo_open(pgPtr, oid, INV_WRITE)) < 0) {
+	TransferPostgresError(interp, pgPtr);
+	goto error;
+    }
+    while ((n = ReadBlobChunk(interp, chan, buffer)) > 0) {
+	if (lo_write(pgPtr, fd, buffer, n) != n) {
+	    TransferPostgresError(interp, pgPtr);
+	    goto error;
 	}
     }
+    if (n < 0) {
+	goto error;
+    }
+    if (lo_close(pgPtr, fd) < 0) {
+	TransferPostgresError(interp, pgPtr);
+	goto error;
+    }
+    ckfree(buffer);
+    if (ownTransaction
+	&& ExecSimpleQuery(interp, pgPtr, "COMMIT", NULL) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    *oidPtr = oid;
+    return TCL_OK;
 
-    /* Execute the statement */
-    rdata->execResult = PQexecPrepared(cdata->pgPtr, rdata->stmtName,
-				       sdata->nParams, paramValues,
-				       paramLengths, paramFormats, 0);
-    if (TransferResultError(interp, rdata->execResult) != TCL_OK) {
-	goto freeParamTables;
+ error:
+    ckfree(buffer);
+    if (ownTransaction) {
+	PQclear(PQexec(pgPtr, "ROLLBACK"));
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetParamScratch --
+ *
+ *	Finds storage for marshalling the parameters of one execution of
+ *	a statement; see PARAM_SCRATCH_BYTES for its layout.
+ *
+ * Results:
+ *	Returns the storage, which the caller gives back with
+ *	ReleaseParamScratch.
+ *
+ * Side effects:
+ *	The statement's storage is allocated on first use and kept, so
+ *	that executing the statement again allocates nothing. If the
+ *	storage is already in use, as it is when a variable trace run
+ *	while the parameters are gathered executes the same statement,
+ *	separate storage is allocated.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static char*
+GetParamScratch(
+    StatementData* sdata	/* Statement being executed */
+) {
+    size_t size = PARAM_SCRATCH_BYTES(sdata->nParams);
+
+    if (size == 0) {
+	return NULL;
+    }
+    if (sdata->flags & STMT_FLAG_SCRATCH_BUSY) {
+	return ckalloc(size);
+    }
+    if (size > sdata->paramScratchSize) {
+	sdata->paramScratch = ckrealloc(sdata->paramScratch, size);
+	sdata->paramScratchSize = size;
+    }
+    sdata->flags |= STMT_FLAG_SCRATCH_BUSY;
+    return sdata->paramScratch;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReleaseParamScratch --
+ *
+ *	Gives back storage obtained from GetParamScratch.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees the storage if it is not the statement's own.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+ReleaseParamScratch(
+    StatementData* sdata,	/* Statement that was executed */
+    char* scratch		/* Storage to give back */
+) {
+    if (scratch == NULL) {
+	return;
+    }
+    if (scratch == sdata->paramScratch) {
+	sdata->flags &= ~STMT_FLAG_SCRATCH_BUSY;
+    } else {
+	ckfree(scratch);
     }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * NewDecodePlan --
+ *
+ *	Makes a plan for decoding the rows of a statement's results.
+ *
+ * Results:
+ *	Returns the plan, with a reference count of 1.
+ *
+ * Side effects:
+ *	Replaces the statement's list of column names with the names in
+ *	the given result.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static DecodePlan*
+NewDecodePlan(
+    StatementData* sdata,	/* Statement that was executed */
+    PGresult* res		/* Result of the execution */
+) {
+    DecodePlan* plan = (DecodePlan*) ckalloc(sizeof(DecodePlan));
+    Tcl_Obj** names;		/* Column names */
+    ColumnDecoder* decoder;	/* Decoder for a column */
+    int i;
 
-    sdata->columnNames = ResultDescToTcl(rdata->execResult, 0);
+    if (sdata->columnNames != NULL) {
+	Tcl_DecrRefCount(sdata->columnNames);
+    }
+    sdata->columnNames = ResultDescToTcl(res, 0);
     Tcl_IncrRefCount(sdata->columnNames);
-    status = TCL_OK;
+    Tcl_ListObjGetElements(NULL, sdata->columnNames, &plan->nColumns, &names);
+
+    plan->refCount = 1;
+    plan->format = (plan->nColumns > 0) ? PQfformat(res, 0) : 0;
+    plan->columnNames = (Tcl_Obj**) ckalloc(plan->nColumns * sizeof(Tcl_Obj*));
+    plan->decoders = (ColumnDecoder**)
+	ckalloc(plan->nColumns * sizeof(ColumnDecoder*));
+    plan->enums = (char*) ckalloc(plan->nColumns + 1);
+    plan->cells = (Tcl_Obj**) ckalloc(2 * plan->nColumns * sizeof(Tcl_Obj*));
+    for (i = 0; i < plan->nColumns; ++i) {
+	plan->columnNames[i] = names[i];
+	Tcl_IncrRefCount(names[i]);
+	decoder = NULL;
+	if (PQfformat(res, i) == 1) {
+	    decoder = BinaryDecoderForType(PQftype(res, i));
+	} else if (PQftype(res, i) == BYTEAOID) {
+	    decoder = DecodeByteaText;
+	}
+	plan->decoders[i] = (decoder != NULL) ? decoder : DecodeText;
+	plan->enums[i] = (char) IsEnumType(sdata->cdata, PQftype(res, i));
+    }
+    return plan;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * StatementPlan --
+ *
+ *	Finds the plan for decoding a result of a statement.
+ *
+ * Results:
+ *	Returns the statement's plan, which the caller must add a reference
+ *	to if it keeps it.
+ *
+ * Side effects:
+ *	Makes a new plan if the statement has none yet, or if the result
+ *	is not in the format of the one that it has: whether results come
+ *	in binary can depend on the session's settings when the statement
+ *	is executed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static DecodePlan*
+StatementPlan(
+    StatementData* sdata,	/* Statement that was executed */
+    PGresult* res		/* Result of the execution */
+) {
+    if (sdata->plan != NULL && PQnfields(res) > 0
+	&& PQfformat(res, 0) != sdata->plan->format) {
+	DecrDecodePlanRefCount(sdata->plan);
+	sdata->plan = NULL;
+    }
+    if (sdata->plan == NULL) {
+	sdata->plan = NewDecodePlan(sdata, res);
+    }
+    return sdata->plan;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteDecodePlan --
+ *
+ *	Frees a plan for decoding rows once nothing refers to it.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DeleteDecodePlan(
+    DecodePlan* plan		/* Plan to free */
+) {
+    int i;
+
+    for (i = 0; i < plan->nColumns; ++i) {
+	Tcl_DecrRefCount(plan->columnNames[i]);
+    }
+    ckfree(plan->columnNames);
+    ckfree(plan->decoders);
+    ckfree(plan->enums);
+    ckfree(plan->cells);
+    ckfree(plan);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultDescToTcl --
+ *
+ *	Converts a Postgres result description for return as a Tcl list.
+ *
+ * Results:
+ *	Returns a Tcl object holding the result description
+ *
+ * If any column names are duplicated, they are disambiguated by
+ * appending '#n' where n increments once for each occurrence of the
+ * column name.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj*
+ResultDescToTcl(
+    PGresult* result,		/* Result set description */
+    int flags			/* Flags governing the conversion */
+) {
+    Tcl_Obj* retval = Tcl_NewObj();
+    Tcl_HashTable names;	/* Hash table to resolve name collisions */
+    char * fieldName;
+    Tcl_InitHashTable(&names, TCL_STRING_KEYS);
+    if (result != NULL) {
+	unsigned int fieldCount = PQnfields(result);
+	unsigned int i;
+	char numbuf[16];
+	for (i = 0; i < fieldCount; ++i) {
+	    int isNew;
+	    int count = 1;
+	    Tcl_Obj* nameObj;
+	    Tcl_HashEntry* entry;
+	    fieldName = PQfname(result, i);
+	    nameObj = Tcl_NewStringObj(fieldName, -1);
+	    Tcl_IncrRefCount(nameObj);
+	    entry =
+		Tcl_CreateHashEntry(&names, fieldName, &isNew);
+	    while (!isNew) {
+	        count = PTR2INT(Tcl_GetHashValue(entry));
+		++count;
+		Tcl_SetHashValue(entry, INT2PTR(count));
+		sprintf(numbuf, "#%d", count);
+		Tcl_AppendToObj(nameObj, numbuf, -1);
+		entry = Tcl_CreateHashEntry(&names, Tcl_GetString(nameObj),
+					    &isNew);
+	    }
+	    Tcl_SetHashValue(entry, INT2PTR(count));
+	    Tcl_ListObjAppendElement(NULL, retval, nameObj);
+	    Tcl_DecrRefCount(nameObj);
+	}
+    }
+    Tcl_DeleteHashTable(&names);
+    return retval;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * StatementConstructor --
+ *
+ *	C-level initialization for the object representing an Postgres prepared
+ *	statement.
+ *
+ * Usage:
+ *	statement new connection statementText
+ *	statement create name connection statementText
+ *
+ * Parameters:
+ *      connection -- the Postgres connection object
+ *	statementText -- text of the statement to prepare.
+ *
+ * Results:
+ *	Returns a standard Tcl result
+ *
+ * Side effects:
+ *	Prepares the statement, and stores it (plus a reference to the
+ *	connection) in instance metadata.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+StatementConstructor(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current statement object */
+    int skip = Tcl_ObjectContextSkippedArgs(context);
+				/* Number of args to skip before the
+				 * payload arguments */
+    Tcl_Object connectionObject;
+				/* The database connection as a Tcl_Object */
+    ConnectionData* cdata;	/* The connection object's data */
+    StatementData* sdata = NULL;
+    				/* The statement's object data */
+
+    /* Find the connection object, and get its data. */
+
+    thisObject = Tcl_ObjectContextObject(context);
+    if (objc != skip+2) {
+	Tcl_WrongNumArgs(interp, skip, objv, "connection statementText");
+	return TCL_ERROR;
+    }
+
+    connectionObject = Tcl_GetObjectFromObj(interp, objv[skip]);
+    if (connectionObject == NULL) {
+	return TCL_ERROR;
+    }
+    cdata = (ConnectionData*) Tcl_ObjectGetMetadata(connectionObject,
+						    &connectionDataType);
+    if (cdata == NULL) {
+	Tcl_AppendResult(interp, Tcl_GetString(objv[skip]),
+			 " does not refer to a Postgres connection", NULL);
+	return TCL_ERROR;
+    }
+
+    /*
+     * All the work is done by the GetPgStatementFromObj, which will
+     * cache the StatementData in objv[skip+1] for future calls
+     */
+
+    TIME("GetPgStatementFromObj",
+    if (GetPgStatementFromObj(interp, objv[skip+1], cdata, &sdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    );
+
+    /* Attach the current statement data as metadata to the current object */
+
+    IncrStatementRefCount(sdata);
+    Tcl_ObjectSetMetadata(thisObject, &statementDataType, (ClientData) sdata);
+
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * StatementParamsMethod --
+ *
+ *	Lists the parameters in a Postgres statement.
+ *
+ * Usage:
+ *	$statement params
+ *
+ * Results:
+ *	Returns a standard Tcl result containing a dictionary. The keys
+ *	of the dictionary are parameter names, and the values are parameter
+ *	types, themselves expressed as dictionaries containing the keys,
+ *	'name', 'direction', 'type', 'precision', 'scale' and 'nullable'.
+ *
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+StatementParamsMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current statement object */
+    StatementData* sdata	/* The current statement */
+	= (StatementData*) Tcl_ObjectGetMetadata(thisObject,
+						 &statementDataType);
+    ConnectionData* cdata = sdata->cdata;
+    PerInterpData* pidata = cdata->pidata; /* Per-interp data */
+    Tcl_Obj** literals = pidata->literals; /* Literal pool */
+    Tcl_Obj* paramName;		/* Name of a parameter */
+    Tcl_Obj* paramDesc;		/* Description of one parameter */
+    Tcl_Obj* dataTypeName;	/* Name of a parameter's data type */
+    Tcl_Obj* retVal;		/* Return value from this command */
+    Tcl_HashEntry* typeHashEntry;
+    int i;
+
+    if (objc != 2) {
+	Tcl_WrongNumArgs(interp, 2, objv, "");
+	return TCL_ERROR;
+    }
+
+    retVal = Tcl_NewObj();
+    for (i = 0; i < sdata->nParams; ++i) {
+	paramDesc = Tcl_NewObj();
+	Tcl_ListObjIndex(NULL, sdata->subVars, i, &paramName);
+	Tcl_DictObjPut(NULL, paramDesc, literals[LIT_NAME], paramName);
+	switch (sdata->params[i].flags & (PARAM_IN | PARAM_OUT)) {
+	case PARAM_IN:
+	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_DIRECTION],
+			   literals[LIT_IN]);
+	    break;
+	case PARAM_OUT:
+	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_DIRECTION],
+			   literals[LIT_OUT]);
+	    break;
+	case PARAM_IN | PARAM_OUT:
+	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_DIRECTION],
+			   literals[LIT_INOUT]);
+	    break;
+	default:
+	    break;
+	}
+	typeHashEntry =
+	    Tcl_FindHashEntry(&(pidata->typeNumHash),
+			      INT2PTR(sdata->paramDataTypes[i]));
+	if (typeHashEntry != NULL) {
+	    dataTypeName = (Tcl_Obj*) Tcl_GetHashValue(typeHashEntry);
+	    Tcl_DictObjPut(NULL, paramDesc, literals[LIT_TYPE], dataTypeName);
+	}
+	Tcl_DictObjPut(NULL, paramDesc, literals[LIT_PRECISION],
+		       Tcl_NewWideIntObj(sdata->params[i].precision));
+	Tcl_DictObjPut(NULL, paramDesc, literals[LIT_SCALE],
+		       Tcl_NewWideIntObj(sdata->params[i].scale));
+	Tcl_DictObjPut(NULL, retVal, paramName, paramDesc);
+    }
+
+    Tcl_SetObjResult(interp, retVal);
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * StatementParamtypeMethod --
+ *
+ *	Defines a parameter type in a Postgres statement.
+ *
+ * Usage:
+ *	$statement paramtype paramName ?direction? type ?precision ?scale??
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Updates the description of the given parameter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+StatementParamtypeMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current statement object */
+    StatementData* sdata	/* The current statement */
+	= (StatementData*) Tcl_ObjectGetMetadata(thisObject,
+						 &statementDataType);
+    static const struct {
+	const char* name;
+	int flags;
+    } directions[] = {
+	{ "in", 	PARAM_IN },
+	{ "out",	PARAM_OUT },
+	{ "inout",	PARAM_IN | PARAM_OUT },
+	{ NULL,		0 }
+    };
+    int direction;
+    int typeNum;		/* Data type number of a parameter */
+    Oid typeOid;		/* Type number of the parameter */
+    Tcl_Obj* typeObj;		/* Name of the data type, or of the element
+				 * type of an array type */
+    const char* typeName;	/* Name of the data type */
+    int typeLen;		/* Length of the name */
+    int status;
+    int precision = 0;		/* Data precision */
+    int scale = 0;		/* Data scale */
+
+    const char* paramName;	/* Name of the parameter being set */
+    Tcl_Obj* targetNameObj;	/* Name of the ith parameter in the statement */
+    const char* targetName;	/* Name of a candidate parameter in the
+				 * statement */
+    int matchCount = 0;		/* Number of parameters matching the name */
+    Tcl_Obj* errorObj;		/* Error message */
+
+    int i;
+
+    /* Check parameters */
+
+    if (objc < 4) {
+	goto wrongNumArgs;
+    }
+
+    i = 3;
+    if (Tcl_GetIndexFromObjStruct(interp, objv[i], directions,
+				  sizeof(directions[0]), "direction",
+				  TCL_EXACT, &direction) != TCL_OK) {
+	direction = PARAM_IN;
+	Tcl_ResetResult(interp);
+    } else {
+	++i;
+    }
+    if (i >= objc) goto wrongNumArgs;
+
+    /* An array type is written as its element type followed by [] */
+
+    typeName = Tcl_GetStringFromObj(objv[i], &typeLen);
+    if (typeLen > 2 && strcmp(typeName + typeLen - 2, "[]") == 0) {
+	typeObj = Tcl_NewStringObj(typeName, typeLen - 2);
+    } else {
+	typeObj = objv[i];
+    }
+    Tcl_IncrRefCount(typeObj);
+    status = Tcl_GetIndexFromObjStruct(interp, typeObj, dataTypes,
+				       sizeof(dataTypes[0]), "SQL data type",
+				       TCL_EXACT, &typeNum);
+    Tcl_DecrRefCount(typeObj);
+    if (status != TCL_OK) {
+	return TCL_ERROR;
+    }
+    typeOid = dataTypes[typeNum].oid;
+    if (typeObj != objv[i]) {
+	int j;
+
+	for (j = 0; arrayTypes[j].arrayOid != 0; ++j) {
+	    if (arrayTypes[j].elementOid == typeOid) {
+		break;
+	    }
+	}
+	if (arrayTypes[j].arrayOid == 0) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf("no array type for "
+						   "\"%s\"",
+						   dataTypes[typeNum].name));
+	    Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY004",
+			     "POSTGRES", "-1", NULL);
+	    return TCL_ERROR;
+	}
+	typeOid = arrayTypes[j].arrayOid;
+    }
+    ++i;
+    if (i < objc) {
+	if (Tcl_GetIntFromObj(interp, objv[i], &precision) == TCL_OK) {
+	    ++i;
+	} else {
+	    return TCL_ERROR;
+	}
+    }
+    if (i < objc) {
+	if (Tcl_GetIntFromObj(interp, objv[i], &scale) == TCL_OK) {
+	    ++i;
+	} else {
+	    return TCL_ERROR;
+	}
+    }
+    if (i != objc) {
+	goto wrongNumArgs;
+    }
+
+    /* Look up parameters by name. */
+
+    paramName = Tcl_GetString(objv[2]);
+    for (i = 0; i < sdata->nParams; ++i) {
+	Tcl_ListObjIndex(NULL, sdata->subVars, i, &targetNameObj);
+	targetName = Tcl_GetString(targetNameObj);
+	if (!strcmp(paramName, targetName)) {
+	    ++matchCount;
+	    sdata->params[i].flags = direction;
+	    if (sdata->paramDataTypes[i] != typeOid) {
+		sdata->paramTypesChanged = 1;
+	    }
+	    sdata->paramDataTypes[i] = typeOid;
+	    sdata->params[i].precision = precision;
+	    sdata->params[i].scale = scale;
+	}
+    }
+    if (matchCount == 0) {
+	errorObj = Tcl_NewStringObj("unknown parameter \"", -1);
+	Tcl_AppendToObj(errorObj, paramName, -1);
+	Tcl_AppendToObj(errorObj, "\": must be ", -1);
+	for (i = 0; i < sdata->nParams; ++i) {
+	    Tcl_ListObjIndex(NULL, sdata->subVars, i, &targetNameObj);
+	    Tcl_AppendObjToObj(errorObj, targetNameObj);
+	    if (i < sdata->nParams-2) {
+		Tcl_AppendToObj(errorObj, ", ", -1);
+	    } else if (i == sdata->nParams-2) {
+		Tcl_AppendToObj(errorObj, " or ", -1);
+	    }
+	}
+	Tcl_SetObjResult(interp, errorObj);
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+
+ wrongNumArgs:
+    Tcl_WrongNumArgs(interp, 2, objv,
+		     "name ?direction? type ?precision ?scale??");
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CheckPositionalCount --
+ *
+ *	Checks that a statement is given a value for each of its
+ *	parameters by position.
+ *
+ * Results:
+ *	Returns a standard Tcl result. On error, the message names the
+ *	parameters in the order their values are expected.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CheckPositionalCount(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    StatementData* sdata,	/* Statement to execute */
+    int count			/* Number of values given */
+) {
+    if (count == sdata->nParams) {
+	return TCL_OK;
+    }
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf("wrong # of positional "
+					   "parameters: expected %d (%s), "
+					   "got %d", sdata->nParams,
+					   Tcl_GetString(sdata->subVars),
+					   count));
+    Tcl_SetErrorCode(interp, "TDBC", "DYNAMIC_SQL_ERROR", "07001",
+		     "POSTGRES", "-1", NULL);
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * StatementBindMethod --
+ *
+ *	Makes a command that executes a statement with positional
+ *	parameters.
+ *
+ * Usage:
+ *	$statement bind cmdName ?-as lists|dicts?
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is the fully qualified
+ *	name of the command.
+ *
+ * Side effects:
+ *	Creates the command, replacing any command of the same name. The
+ *	command is deleted when the statement is closed.
+ *
+ * The command, 'cmdName ?value...?', binds the values to the distinct
+ * parameters of the statement in order of their first appearance, and
+ * returns all the rows of the result, as 'allrows' would, or the number
+ * of rows affected if the statement returns no columns. No result set
+ * object is made, and no parameter is looked up by name.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+StatementBindMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current statement object */
+    StatementData* sdata = (StatementData*)
+	Tcl_ObjectGetMetadata(thisObject, &statementDataType);
+				/* The current statement */
+    BoundCommands* bound = (BoundCommands*)
+	Tcl_ObjectGetMetadata(thisObject, &boundCommandsDataType);
+				/* Commands bound to the statement */
+    BoundStatement* bsdata;	/* The new command's data */
+    Tcl_Obj* nameObj;		/* Full name of the command */
+    int lists;			/* Flag == 1 for lists, 0 for dicts */
+    int i;
+
+    if (objc < 3) {
+	goto wrongNumArgs;
+    }
+    i = ParseRowOptions(interp, objc-1, objv+1, 0, &lists, NULL);
+    if (i < 0) {
+	return TCL_ERROR;
+    }
+    if (i != objc-1) {
+	goto wrongNumArgs;
+    }
+
+    if (bound == NULL) {
+	bound = (BoundCommands*) ckalloc(sizeof(BoundCommands));
+	bound->interp = interp;
+	bound->first = NULL;
+	Tcl_ObjectSetMetadata(thisObject, &boundCommandsDataType,
+			      (ClientData) bound);
+    }
+    bsdata = (BoundStatement*) ckalloc(sizeof(BoundStatement));
+    bsdata->sdata = sdata;
+    IncrStatementRefCount(sdata);
+    bsdata->lists = lists;
+    bsdata->owner = bound;
+    bsdata->next = bound->first;
+    bound->first = bsdata;
+    bsdata->token = Tcl_CreateObjCommand(interp, Tcl_GetString(objv[2]),
+					 BoundStatementCmd,
+					 (ClientData) bsdata,
+					 DeleteBoundStatement);
+
+    nameObj = Tcl_NewObj();
+    Tcl_GetCommandFullName(interp, bsdata->token, nameObj);
+    Tcl_SetObjResult(interp, nameObj);
+    return TCL_OK;
+
+ wrongNumArgs:
+    Tcl_WrongNumArgs(interp, 2, objv, "cmdName ?-as lists|dicts?");
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BoundStatementCmd --
+ *
+ *	Executes a statement bound to a command by 'bind'.
+ *
+ * Usage:
+ *	cmdName ?value...?
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is the list of rows of
+ *	the result, or the number of rows affected if the statement
+ *	returns no columns.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+BoundStatementCmd(
+    ClientData clientData,	/* The bound statement */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    BoundStatement* bsdata = (BoundStatement*) clientData;
+    StatementData* sdata = bsdata->sdata;
+				/* Statement to execute */
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    int lists = bsdata->lists;	/* Flag == 1 for lists, 0 for dicts */
+    ResultSetData* rdata;	/* Result of this execution */
+    Tcl_Obj* rowsObj;		/* Rows of the result */
+    int status;
+
+    if (CheckPositionalCount(interp, sdata, objc-1) != TCL_OK
+	|| CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * The result set is private to this call, so it can be read whole
+     * before it is discarded whatever the connection's fetch mode.
+     */
+
+    rdata = NewResultSet(sdata, FETCH_MATERIALIZE, -1, -1, -1, 0);
+    status = ExecuteResultSet(interp, rdata, NULL, objv+1, -1, -1);
+    if (status == TCL_OK) {
+	status = AwaitPipelinedResult(interp, rdata);
+    }
+    if (status == TCL_OK) {
+	if (rdata->plan->nColumns == 0) {
+	    Tcl_SetObjResult(interp, ResultSetRowcount(rdata));
+	} else {
+	    status = CollectRows(interp, rdata, lists, -1,
+				 cdata->pidata->literals, &rowsObj);
+	    if (status == TCL_OK) {
+		Tcl_SetObjResult(interp, rowsObj);
+	    }
+	}
+    }
+    DecrResultSetRefCount(rdata);
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteBoundStatement --
+ *
+ *	Cleans up when a command made by 'bind' is deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Removes the command from the statement's list of bound commands,
+ *	and releases its reference to the statement.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DeleteBoundStatement(
+    ClientData clientData	/* The bound statement */
+) {
+    BoundStatement* bsdata = (BoundStatement*) clientData;
+    BoundStatement** link;
+
+    for (link = &bsdata->owner->first; *link != NULL;
+	 link = &(*link)->next) {
+	if (*link == bsdata) {
+	    *link = bsdata->next;
+	    break;
+	}
+    }
+    DecrStatementRefCount(bsdata->sdata);
+    ckfree(bsdata);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * StatementExecutemanyMethod --
+ *
+ *	Executes a statement once for each of a list of sets of
+ *	parameters.
+ *
+ * Usage:
+ *	$statement executemany paramSets ?-positional?
+ *
+ * Parameters:
+ *	paramSets - List of dictionaries of parameter values, or with
+ *		    -positional, of lists of values bound by position as by
+ *		    'execute -positional'
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is the list of the
+ *	numbers of rows affected by each execution.
+ *
+ * Side effects:
+ *	If no transaction is open, the executions are made a transaction
+ *	of their own, so that on error none of them takes effect. Rows
+ *	that the statement returns are discarded.
+ *
+ * No result set object is made. Where the client library supports
+ * pipeline mode, the executions are sent back to back, EXECUTEMANY_BATCH
+ * at a time, without waiting for the result of each; otherwise, they are
+ * made one at a time.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+StatementExecutemanyMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current statement object */
+    StatementData* sdata = (StatementData*)
+	Tcl_ObjectGetMetadata(thisObject, &statementDataType);
+				/* The current statement */
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    PGconn* pgPtr = cdata->pgPtr;
+				/* Connection handle */
+    static const char *const options[] = {
+	"-positional", NULL
+    };
+    int positional = 0;		/* Flag == 1 if sets are bound by position */
+    int nSets;			/* Number of sets of parameters */
+    Tcl_Obj** sets;		/* Sets of parameters */
+    char* stmtName = NULL;	/* Name of the prepared statement */
+    ParamTables tables;		/* Marshalled parameters */
+    int ownTransaction;		/* Flag == 1 if the executions are a
+				 * transaction of their own */
+    Tcl_Obj* countsObj;		/* Numbers of rows affected */
+    int status;
+    int idx;
+
+    if (objc < 3 || objc > 4) {
+	Tcl_WrongNumArgs(interp, 2, objv, "paramSets ?-positional?");
+	return TCL_ERROR;
+    }
+    if (objc == 4) {
+	if (Tcl_GetIndexFromObj(interp, objv[3], options, "option",
+				0, &idx) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	positional = 1;
+    }
+    if (Tcl_ListObjGetElements(interp, objv[2], &nSets, &sets) != TCL_OK
+	|| CheckManyBlobs(interp, sdata, nSets, sets, positional) != TCL_OK
+	|| CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * Hold a reference to the list, so that the sets stay put however
+     * the parameters are marshalled.
+     */
+
+    Tcl_IncrRefCount(objv[2]);
+    countsObj = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(countsObj);
+    status = AcquireStatementName(interp, sdata, &stmtName);
+    if (status == TCL_OK) {
+	GetParamTables(sdata, &tables);
+	ownTransaction = (PQtransactionStatus(pgPtr) == PQTRANS_IDLE);
+	cdata->flags |= CONN_FLAG_BATCH;
+	if (PQenterPipelineMode != NULL && PQenterPipelineMode(pgPtr)) {
+	    status = ExecuteManyPipelined(interp, sdata, stmtName, &tables,
+					  nSets, sets, positional,
+					  ownTransaction, countsObj);
+	    PQexitPipelineMode(pgPtr);
+	} else {
+	    status = ExecuteManySerially(interp, sdata, stmtName, &tables,
+					 nSets, sets, positional,
+					 ownTransaction, countsObj);
+	}
+	cdata->flags &= ~CONN_FLAG_BATCH;
+	ReleaseParamScratch(sdata, tables.scratch);
+
+	/* On error, a transaction of our own is left to roll back */
+
+	if (ownTransaction
+	    && PQtransactionStatus(pgPtr) != PQTRANS_IDLE) {
+	    PQclear(PQexec(pgPtr, "ROLLBACK"));
+	}
+    }
+    if (stmtName != NULL) {
+	ReleaseStatementName(sdata, stmtName);
+    }
+    if (status == TCL_OK) {
+	Tcl_SetObjResult(interp, countsObj);
+    }
+    Tcl_DecrRefCount(countsObj);
+    Tcl_DecrRefCount(objv[2]);
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CheckManyBlobs --
+ *
+ *	Checks that none of the sets of parameters given to 'executemany'
+ *	binds a channel to an oid parameter.
+ *
+ * Results:
+ *	Returns a standard Tcl result. On error, the message names the
+ *	parameter and the set.
+ *
+ * Such a channel is copied into a new large object as the parameters
+ * are marshalled, which takes requests to the server of its own; these
+ * cannot be made while the connection is busy with the executions, so
+ * the sets are refused before any of them is executed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CheckManyBlobs(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    StatementData* sdata,	/* Statement to execute */
+    int nSets,			/* Number of sets of parameters */
+    Tcl_Obj *const sets[],	/* Sets of parameters */
+    int positional		/* Flag == 1 if sets are bound by position */
+) {
+    Tcl_Obj* paramNameObj;	/* Name of the current parameter */
+    Tcl_Obj* paramValObj;	/* Value of the current parameter */
+    int i, j;
+
+    for (i = 0; i < sdata->nParams; ++i) {
+	if (sdata->paramDataTypes[i] != OIDOID) {
+	    continue;
+	}
+	Tcl_ListObjIndex(NULL, sdata->subVars, i, &paramNameObj);
+	for (j = 0; j < nSets; ++j) {
+	    paramValObj = NULL;
+	    if (positional) {
+		Tcl_ListObjIndex(NULL, sets[j], i, &paramValObj);
+	    } else {
+		Tcl_DictObjGet(NULL, sets[j], paramNameObj, &paramValObj);
+	    }
+	    if (paramValObj != NULL
+		&& FindBlobHandle(interp, paramValObj) != NULL) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "cannot bind a channel to oid parameter \"%s\" in "
+		    "executemany (parameter set %d)",
+		    Tcl_GetString(paramNameObj), j));
+		Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HYC00",
+				 "POSTGRES", "-1", NULL);
+		return TCL_ERROR;
+	    }
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * MarshalParamSet --
+ *
+ *	Converts one of the sets of parameters given to 'executemany'
+ *	into the form in which they are sent to the server.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	As for MarshalParams. On error, the error information says which
+ *	set was in error.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+MarshalParamSet(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    StatementData* sdata,	/* Statement being executed */
+    Tcl_Obj* setObj,		/* Set of parameters */
+    int positional,		/* Flag == 1 if the set is a list of
+				 * values bound by position */
+    int setNum,			/* Index of the set, for error reports */
+    ParamTables* tables		/* Tables to fill in */
+) {
+    Tcl_Obj** valuev;		/* Values bound by position */
+    int valuec;			/* Number of values bound by position */
+    int status;
+
+    if (positional) {
+	status = Tcl_ListObjGetElements(interp, setObj, &valuec, &valuev);
+	if (status == TCL_OK) {
+	    status = CheckPositionalCount(interp, sdata, valuec);
+	}
+	if (status == TCL_OK) {
+	    status = MarshalParams(interp, sdata, NULL, valuev, tables);
+	}
+    } else {
+	status = MarshalParams(interp, sdata, setObj, NULL, tables);
+    }
+    if (status != TCL_OK) {
+	Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf(
+	    "\n    (parameter set %d)", setNum));
+    }
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * AppendRowcount --
+ *
+ *	Appends the number of rows affected by a command to a list.
+ *
+ * Results:
+ *	None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+AppendRowcount(
+    ConnectionData* cdata,	/* Connection data */
+    Tcl_Obj* countsObj,		/* List to append to */
+    PGresult* res		/* Result of the command */
+) {
+    const char* nTuples = PQcmdTuples(res);
+
+    Tcl_ListObjAppendElement(NULL, countsObj,
+			     (*nTuples == '\0')
+			     ? cdata->pidata->literals[LIT_0]
+			     : Tcl_NewStringObj(nTuples, -1));
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ExecuteManySerially --
+ *
+ *	Executes a statement for each of a list of sets of parameters,
+ *	one at a time.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Appends the number of rows affected by each execution to
+ *	'countsObj'. Opens a transaction and commits it around the
+ *	executions if 'ownTransaction' is set; on error, the caller rolls
+ *	it back.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ExecuteManySerially(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    StatementData* sdata,	/* Statement to execute */
+    char* stmtName,		/* Name of the prepared statement */
+    ParamTables* tables,	/* Storage for marshalled parameters */
+    int nSets,			/* Number of sets of parameters */
+    Tcl_Obj *const sets[],	/* Sets of parameters */
+    int positional,		/* Flag == 1 if sets are bound by position */
+    int ownTransaction,		/* Flag == 1 to make the executions a
+				 * transaction of their own */
+    Tcl_Obj* countsObj		/* List of numbers of rows affected */
+) {
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    PGresult* res;		/* Result of one execution */
+    int i;
+
+    if (ownTransaction
+	&& ExecSimpleQuery(interp, cdata->pgPtr, "BEGIN", NULL) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    for (i = 0; i < nSets; ++i) {
+	if (MarshalParamSet(interp, sdata, sets[i], positional, i,
+			    tables) != TCL_OK) {
+	    FreeParamValues(sdata, tables);
+	    return TCL_ERROR;
+	}
+	res = PQexecPrepared(cdata->pgPtr, stmtName, sdata->nParams,
+			     tables->values, tables->lengths,
+			     tables->formats, 0);
+	FreeParamValues(sdata, tables);
+	if (TransferResultError(interp, res) != TCL_OK) {
+	    PQclear(res);
+	    Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf(
+		"\n    (parameter set %d)", i));
+	    return TCL_ERROR;
+	}
+	AppendRowcount(cdata, countsObj, res);
+	PQclear(res);
+    }
+    if (ownTransaction
+	&& ExecSimpleQuery(interp, cdata->pgPtr, "COMMIT", NULL) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ExecuteManyPipelined --
+ *
+ *	Executes a statement for each of a list of sets of parameters,
+ *	on a connection in pipeline mode.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Appends the number of rows affected by each execution to
+ *	'countsObj'. Opens a transaction and commits it around the
+ *	executions if 'ownTransaction' is set; on error, the caller rolls
+ *	it back.
+ *
+ * The executions are sent EXECUTEMANY_BATCH at a time, each batch
+ * followed by a synchronization point, and the results of a batch are
+ * read before the next is sent. A client that sends without reading can
+ * fill the network buffers in both directions, and stall; a batch is
+ * small enough that its results fit in them. Once the server reports an
+ * error, it skips the rest of the batch, and no further batch is sent.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ExecuteManyPipelined(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    StatementData* sdata,	/* Statement to execute */
+    char* stmtName,		/* Name of the prepared statement */
+    ParamTables* tables,	/* Storage for marshalled parameters */
+    int nSets,			/* Number of sets of parameters */
+    Tcl_Obj *const sets[],	/* Sets of parameters */
+    int positional,		/* Flag == 1 if sets are bound by position */
+    int ownTransaction,		/* Flag == 1 to make the executions a
+				 * transaction of their own */
+    Tcl_Obj* countsObj		/* List of numbers of rows affected */
+) {
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    PGconn* pgPtr = cdata->pgPtr;
+				/* Connection handle */
+    const char* command;	/* Transaction command sent with a batch */
+    int first = 0;		/* Index of the first set of a batch */
+    int sent;			/* Number of sets of the batch sent */
+    int status = TCL_OK;
+
+    do {
+	command = (first == 0 && ownTransaction) ? "BEGIN" : NULL;
+	if (command != NULL
+	    && !PQsendQueryParams(pgPtr, command, 0, NULL, NULL, NULL,
+				  NULL, 0)) {
+	    TransferPostgresError(interp, pgPtr);
+	    return TCL_ERROR;
+	}
+
+	/* Send the batch */
+
+	for (sent = 0;
+	     first + sent < nSets && sent < EXECUTEMANY_BATCH;
+	     ++sent) {
+	    if (MarshalParamSet(interp, sdata, sets[first + sent],
+				positional, first + sent,
+				tables) != TCL_OK) {
+		status = TCL_ERROR;
+	    } else if (!PQsendQueryPrepared(pgPtr, stmtName, sdata->nParams,
+					    tables->values, tables->lengths,
+					    tables->formats, 0)) {
+		TransferPostgresError(interp, pgPtr);
+		status = TCL_ERROR;
+	    }
+	    FreeParamValues(sdata, tables);
+	    if (status != TCL_OK) {
+		break;
+	    }
+	}
+
+	/*
+	 * The last batch commits a transaction of our own. If this one
+	 * failed before it was all sent, what was sent must still be
+	 * synchronized and read; the caller rolls the transaction back.
+	 */
+
+	if (status == TCL_OK && first + sent == nSets && ownTransaction) {
+	    if (!PQsendQueryParams(pgPtr, "COMMIT", 0, NULL, NULL, NULL,
+				   NULL, 0)) {
+		TransferPostgresError(interp, pgPtr);
+		status = TCL_ERROR;
+	    }
+	}
+	if (!PQpipelineSync(pgPtr)) {
+	    if (status == TCL_OK) {
+		TransferPostgresError(interp, pgPtr);
+	    }
+	    return TCL_ERROR;
+	}
+
+	/* Read the results of the batch */
+
+	if (ReadPipelineBatch(interp, cdata, command != NULL, first, sent,
+			      countsObj, status) != TCL_OK) {
+	    status = TCL_ERROR;
+	}
+	first += sent;
+    } while (status == TCL_OK && first < nSets);
+
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReadPipelineBatch --
+ *
+ *	Reads the results of a batch of executions sent by
+ *	ExecuteManyPipelined, up to and including its synchronization
+ *	point.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Appends the number of rows affected by each execution to
+ *	'countsObj'. Unless 'status' says that an error has already been
+ *	reported, reports the first error in the batch, and which set of
+ *	parameters it was for.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ReadPipelineBatch(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ConnectionData* cdata,	/* Connection data */
+    int leading,		/* Number of commands sent before the sets */
+    int first,			/* Index of the first set of the batch */
+    int nSent,			/* Number of sets sent */
+    Tcl_Obj* countsObj,		/* List of numbers of rows affected */
+    int status			/* Status of the batch so far */
+) {
+    PGconn* pgPtr = cdata->pgPtr;
+				/* Connection handle */
+    PGresult* res;		/* Result of one command */
+    int setNum;			/* Index of the set of a result, or -1
+				 * for a transaction command */
+    int i;
+
+    /*
+     * Each command has at least one result, and its results are followed
+     * by a NULL. Commands beyond those counted are transaction commands;
+     * the synchronization point ends the batch.
+     */
+
+    for (i = 0; ; ++i) {
+	setNum = (i >= leading && i < leading + nSent)
+	    ? first + i - leading : -1;
+	res = PQgetResult(pgPtr);
+	if (res == NULL) {
+
+	    /* The connection has failed */
+
+	    if (status == TCL_OK) {
+		TransferPostgresError(interp, pgPtr);
+	    }
+	    return TCL_ERROR;
+	}
+	if (PQresultStatus(res) == PGRES_PIPELINE_SYNC) {
+	    PQclear(res);
+	    return status;
+	}
+	for (; res != NULL; res = PQgetResult(pgPtr)) {
+	    switch (PQresultStatus(res)) {
+	    case PGRES_COMMAND_OK:
+	    case PGRES_TUPLES_OK:
+		if (setNum >= 0 && status == TCL_OK) {
+		    AppendRowcount(cdata, countsObj, res);
+		}
+		break;
+	    case PGRES_PIPELINE_ABORTED:
+		break;
+	    default:
+		if (status == TCL_OK) {
+		    status = TransferResultError(interp, res);
+		    if (status != TCL_OK && setNum >= 0) {
+			Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf(
+			    "\n    (parameter set %d)", setNum));
+		    }
+		}
+		break;
+	    }
+	    PQclear(res);
+	}
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteBoundCommands --
+ *
+ *	Deletes the commands bound to a statement object when the object
+ *	is destroyed.
+ *
+ * Results:
+ *	None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DeleteBoundCommands(
+    ClientData clientData	/* List of bound commands */
+) {
+    BoundCommands* bound = (BoundCommands*) clientData;
+
+    while (bound->first != NULL) {
+	Tcl_DeleteCommandFromToken(bound->interp, bound->first->token);
+    }
+    ckfree(bound);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CloneBoundCommands --
+ *
+ *	Handles the bound commands when a statement object is copied.
+ *
+ * Results:
+ *	Returns TCL_OK, leaving the copy without bound commands.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CloneBoundCommands(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ClientData oldClientData,	/* List of bound commands */
+    ClientData* newClientData	/* OUTPUT: List for the copy */
+) {
+    *newClientData = NULL;
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteStatementMetadata, DeleteStatement --
+ *
+ *	Cleans up when a Postgres statement is no longer required.
+ *
+ * Side effects:
+ *	Frees all resources associated with the statement.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DeleteStatementMetadata(
+    ClientData clientData	/* Instance data for the connection */
+) {
+    DecrStatementRefCount((StatementData*)clientData);
+}
+static void
+DeleteStatement(
+    StatementData* sdata	/* Metadata for the statement */
+) {
+    Tcl_HashEntry* he = NULL;
+
+    DBG("  ==> DeleteStatement %s\n", name(sdata));
+    if (sdata->columnNames != NULL) {
+	Tcl_DecrRefCount(sdata->columnNames);
+    }
+    if (sdata->stmtName != NULL) {
+	UnallocateStatement(sdata->cdata, sdata->stmtName);
+	ckfree(sdata->stmtName);
+    }
+    if (sdata->nativeSql != NULL) {
+	Tcl_DecrRefCount(sdata->nativeSql);
+    }
+    if (sdata->origSql != NULL) {
+	/*
+	 * Non-frozen entries in the statements hash table don't hold
+	 * references to sdata, so when the refcount goes to zero
+	 * we remove the entry from the hash.  This way the the
+	 * statements hash contains only the currently referenced
+	 * statements (as metadata for statement objects, or intrep
+	 * for pgStatement ObjTypes), or frozen statements from
+	 * previous incarnations.
+	 *
+	 * If we're here and sdata->cdata is NULL it means that the
+	 * connection is being explicitly destroyed and the connection
+	 * destructor will take care of removing the hash entries itself.
+	 */
+	if (sdata->cdata) {
+	    he = Tcl_FindHashEntry(sdata->cdata->statements, sdata->origSql);
+	    if (he) {
+		Tcl_DeleteHashEntry(he);
+	    }
+	}
+	ckfree(sdata->origSql);
+	sdata->origSql = NULL;
+    }
+    if (sdata->params != NULL) {
+	ckfree(sdata->params);
+    }
+    if (sdata->paramDataTypes != NULL) {
+	ckfree(sdata->paramDataTypes);
+    }
+    if (sdata->paramScratch != NULL) {
+	ckfree(sdata->paramScratch);
+    }
+    if (sdata->columnTypes != NULL) {
+	ckfree(sdata->columnTypes);
+    }
+    if (sdata->plan != NULL) {
+	DecrDecodePlanRefCount(sdata->plan);
+    }
+    if (sdata->subVars != NULL) {
+	Tcl_DecrRefCount(sdata->subVars);
+	sdata->subVars = NULL;
+    }
+    if (sdata->cdata) {
+	/*
+	 * sdata->cdata == NULL means this statement is frozen, and doesn't
+	 * hold a reference to cdata (which will have moved location when
+	 * we're thawed anyway).  The dependency on cdata->pgPtr for prepared
+	 * statements is implicit in that the only way to reach a frozen
+	 * statement is via the correct cdata's statements hash table.
+	 */
+	DecrConnectionRefCount(sdata->cdata);
+    }
+    ckfree(sdata);
+    DBG("  <== DeleteStatement %s, statements remaining: %d\n", name(sdata), --g_statements);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CloneStatement --
+ *
+ *	Attempts to clone a Postgres statement's metadata.
+ *
+ * Results:
+ *	Returns the new metadata
+ *
+ * At present, we don't attempt to clone statements - it's not obvious
+ * that such an action would ever even make sense.  Instead, we return NULL
+ * to indicate that the metadata should not be cloned. (Note that this
+ * action isn't right, either. What *is* right is to indicate that the object
+ * is not clonable, but the API gives us no way to do that.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CloneStatement(
+    Tcl_Interp* interp,		/* Tcl interpreter for error reporting */
+    ClientData metadata,	/* Metadata to be cloned */
+    ClientData* newMetaData	/* Where to put the cloned metadata */
+) {
+    Tcl_SetObjResult(interp,
+		     Tcl_NewStringObj("Postgres statements are not clonable",
+				      -1));
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * AddStatementRef --
+ *
+ *	Adds obj as a reference to sdata in the pgStatement linked list,
+ *	and increments the StatementData ref count
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+AddStatementRef(
+    Tcl_Obj* obj,
+    StatementData* sdata
+) {
+    struct pgStatementRef* myRef = ckalloc(sizeof(struct pgStatementRef));
+
+    myRef->obj = obj;
+    DBG("Adding obj statement ref: %s: %s\n", name(obj), Tcl_GetString(obj));
+    myRef->next = sdata->pgStatements;
+    sdata->pgStatements = myRef;
+    IncrStatementRefCount(sdata);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RemoveStatementRef --
+ *
+ *	Removes obj as a reference to sdata from the pgStatement linked list,
+ *	and decrements the StatementData ref count (if a ref to obj was found).
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+RemoveStatementRef(
+    Tcl_Obj* obj,
+    StatementData* sdata
+) {
+    struct pgStatementRef* p = sdata->pgStatements;
+    struct pgStatementRef* t = NULL;
+
+    if (p == NULL) return;
+
+    if (p->obj == obj) {
+	sdata->pgStatements = p->next;
+	ckfree(p);
+	p = NULL;
+	DecrStatementRefCount(sdata);
+	return;
+    }
+
+    while (p->next && p->next->obj != obj) {
+	p = p->next;
+    }
+
+    if (p->next == NULL) {
+	return;
+    }
+
+    t = p->next;
+    p->next = p->next->next;
+    ckfree(t);
+    t = NULL;
+    DecrStatementRefCount(sdata);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * RemoveAllStatementRefs --
+ *
+ *	Removes all pgStatement Intrep refs from sdata, invalidating the
+ *	referring objects' intreps and decrementing the StatementData for
+ *	each removed reference.
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+RemoveAllStatementRefs(
+    StatementData* sdata
+) {
+    struct pgStatementRef* p = sdata->pgStatements;
+    struct pgStatementRef* n = NULL;
+    Tcl_ObjInternalRep* ir = NULL;
+
+    sdata->pgStatements = NULL;
+
+    while (p) {
+	ir = Tcl_FetchInternalRep(p->obj, &pgStatementType);
+	if (ir) {
+	    if (ir->twoPtrValue.ptr1) {
+		DBG("\t  Unlinking pgStatement Tcl_Obj %s from %s/%s\n", name(p->obj), name(sdata->cdata), name(sdata));
+		DecrStatementRefCount((StatementData*) ir->twoPtrValue.ptr1);
+		ir->twoPtrValue.ptr1 = NULL;
+	    }
+	    ir->twoPtrValue.ptr2 = NULL;
+	}
+	
+	n = p->next;
+	p->obj = NULL;
+	p->next = NULL;
+	ckfree(p);
+	p = n;
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FreeStatement --
+ *
+ *	Frees a pgStatement ObjType intrep
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FreeStatement(
+    Tcl_Obj* obj
+) {
+    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &pgStatementType);
+    StatementData* sdata = ir->twoPtrValue.ptr1;
+
+    DBG("FreeIntRep on pgStatement %s\n", name(obj));
+    if (ir->twoPtrValue.ptr1) {
+	/*
+	 * May be NULL already if the StatementData was unlinked from this
+	 * intrep when the associated connection was frozen.
+	 */
+	RemoveStatementRef(obj, sdata);
+    }
+    ir->twoPtrValue.ptr1 = NULL;
+    ir->twoPtrValue.ptr2 = NULL;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DupStatement --
+ *
+ *	Duplicates a pgStatement ObjType intrep
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DupStatement(
+    Tcl_Obj* src,
+    Tcl_Obj* dup
+) {
+    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(src, &pgStatementType);
+    StatementData* sdata = ir->twoPtrValue.ptr1;
+
+    AddStatementRef(dup, sdata);
+    Tcl_StoreInternalRep(dup, &pgStatementType, ir);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * UpdateStringOfStatement --
+ *
+ *	Duplicates a pgStatement ObjType intrep
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+UpdateStringOfStatement(
+    Tcl_Obj* obj
+) {
+    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &pgStatementType);
+    StatementData* sdata = ir->twoPtrValue.ptr1;
+
+    Tcl_InitStringRep(obj, sdata->origSql, strlen(sdata->origSql));
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetPgStatementFromObj --
+ *
+ *	Duplicates a pgStatement ObjType intrep
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+ThawTclObj(
+    Tcl_Obj** obj
+) {
+    char* frozenStr = NULL;	/* Frozen string while replacing with Tcl_Obj */
+
+    if (*obj == NULL) {
+	return;
+    }
+
+    frozenStr = (char*)*obj;
+    *obj = Tcl_NewStringObj(frozenStr, -1);
+    Tcl_IncrRefCount(*obj);
+    ckfree(frozenStr);
+    frozenStr = NULL;
+}
+
+static int
+GetPgStatementFromObj(
+    Tcl_Interp* interp,
+    Tcl_Obj* obj,
+    ConnectionData* cdata,
+    StatementData** sdataOut
+) {
+    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &pgStatementType);
+    Tcl_ObjInternalRep newIr;
+    StatementData* sdata = NULL;
+    Tcl_Obj* tokens = NULL;	/* The tokens of the statement to be prepared */
+    int tokenc;			/* Length of the 'tokens' list */
+    Tcl_Obj** tokenv;		/* Exploded tokens from the list */
+    Tcl_Obj* nativeSql = NULL;	/* SQL statement mapped to native form */
+    Tcl_Obj* subVars = NULL;	/* Substition variables, in order */
+    char* tokenStr;		/* Token string */
+    int tokenLen;		/* Length of a token */
+    char tmpstr[30];		/* Temporary array for strings */
+    PGresult* res;		/* Temporary result of libpq calls */
+    Tcl_HashEntry* he = NULL;	/* Frozen prepared statement */
+    Tcl_HashTable paramNums;	/* Numbers of the parameters, by name */
+    Tcl_HashEntry* paramEntry;	/* Entry in paramNums */
+    int i, j, new;
+    const char* origSql = NULL;
+    int origSqlLen;
+
+    DBG("GetPgStatementFromObj %s \"%s\"\n", name(obj), Tcl_GetString(obj));
+    /*
+     * Cached StatementData is only valid if the pgPtr matches the connection
+     * we used to prepare.  If ptr1 is NULL then the StatementData was unlinked
+     * from under us and we need to regenerate it.
+     */
+    if (ir && ir->twoPtrValue.ptr1 && ir->twoPtrValue.ptr2 == cdata->pgPtr) {
+	*sdataOut = ir->twoPtrValue.ptr1;
+	return TCL_OK;
+    }
+
+    /*
+     * Not a pgStatementType, or not valid for this ConnectionData:
+     * attempt to convert it to one.
+     *
+     * Look for a frozen (previously detached) prepared statement.
+     */
+
+    he = Tcl_CreateHashEntry(cdata->statements, Tcl_GetString(obj), &new);
+    if (!new) {
+	sdata = Tcl_GetHashValue(he);
+	DBG("\tRetrieved StatementData from statements hash: %s\n", name(sdata));
+	IncrStatementRefCount(sdata);	/* For sdata pointer */
+
+	if (sdata->cdata == NULL) {
+	    DBG("\t\tWas frozen, thawing\n");
+	    /* cdata == NULL means this statement was frozen, thaw it */
+
+	    sdata->cdata = cdata;
+	    IncrConnectionRefCount(sdata->cdata);
+
+	    /*
+	     * To survive freezing the Tcl_Objs in StatementData are reduced to
+	     * char*s.  Reverse that here.
+	     */
+
+	    ThawTclObj(&sdata->subVars);
+	    ThawTclObj(&sdata->nativeSql);
+	    ThawTclObj(&sdata->columnNames);
+
+	    /* Frozen entries in the hash have their own references
+	     * (nothing else references them).  Thawed ones don't,
+	     * remove the cdata->statements ref now that we've thawed
+	     * this one.
+	     */
+	    DecrStatementRefCount(sdata);
+	}
+    } else {
+	DBG("query not found in cdata->statements: %s, existing statements:\n", Tcl_GetString(obj));
+	DUMP_STATEMENTS(cdata);
+
+	/* Preparing the statement needs the connection */
+
+	if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	    goto err;
+	}
+
+	/* Tokenize the statement */
+
+	tokens = Tdbc_TokenizeSql(interp, Tcl_GetString(obj));
+	if (tokens == NULL) {
+	    goto err;
+	}
+	Tcl_IncrRefCount(tokens);
+
+	/*
+	 * Rewrite the tokenized statement to Postgres syntax. Reject the
+	 * statement if it is actually multiple statements.
+	 */
+
+	if (Tcl_ListObjGetElements(interp, tokens, &tokenc, &tokenv) != TCL_OK) {
+	    goto err;
+	}
+
+	nativeSql = Tcl_NewObj();
+	Tcl_IncrRefCount(nativeSql);
+
+	subVars = Tcl_NewListObj(0, NULL);
+	Tcl_IncrRefCount(subVars);
+
+	/*
+	 * Each distinct parameter name gets one placeholder, however many
+	 * times it appears, so that its value is sent once.
+	 */
+
+	Tcl_InitHashTable(&paramNums, TCL_STRING_KEYS);
+	j=0;
+
+	for (i = 0; i < tokenc; ++i) {
+	    tokenStr = Tcl_GetStringFromObj(tokenv[i], &tokenLen);
+
+	    switch (tokenStr[0]) {
+	    case '$':
+	    case ':':
+		/*
+		 * A PostgreSQL cast is not a parameter!
+		 */
+		if (tokenStr[0] == ':' && tokenStr[1] == tokenStr[0]) {
+		    Tcl_AppendToObj(nativeSql, tokenStr, tokenLen);
+		    break;
+		}
+
+		paramEntry = Tcl_CreateHashEntry(&paramNums, tokenStr+1, &new);
+		if (new) {
+		    j+=1;
+		    Tcl_SetHashValue(paramEntry, INT2PTR(j));
+		    Tcl_ListObjAppendElement(NULL, subVars,
+					Tcl_NewStringObj(tokenStr+1, tokenLen-1));
+		}
+		snprintf(tmpstr, 30, "$%d",
+			 (int) PTR2INT(Tcl_GetHashValue(paramEntry)));
+		Tcl_AppendToObj(nativeSql, tmpstr, -1);
+		break;
+
+	    case ';':
+		Tcl_DeleteHashTable(&paramNums);
+		Tcl_SetObjResult(interp,
+				Tcl_NewStringObj("tdbc::postgres"
+						" does not support semicolons "
+						"in statements", -1));
+		goto err;
+		break;
+
+	    default:
+		Tcl_AppendToObj(nativeSql, tokenStr, tokenLen);
+		break;
+
+	    }
+	}
+
+	Tcl_DeleteHashTable(&paramNums);
+	Tcl_DecrRefCount(tokens);
+	tokens = NULL;
+
+	/*
+	 * Allocate an object to hold data about this statement
+	 */
+
+	sdata = NewStatement(cdata);
+	DBG("\nCreated fresh StatementData: %s\n", name(sdata));
+
+	/*
+	 * Can't point origSql to obj - it would be a circular reference (obj
+	 * referenced in obj's intrep), so it would never be freed
+	 */
+	origSql = Tcl_GetStringFromObj(obj, &origSqlLen);
+	sdata->origSql = ckalloc(origSqlLen+1);
+	memcpy(sdata->origSql, origSql, origSqlLen+1);
+
+	sdata->nativeSql = nativeSql;
+	nativeSql = NULL;
+	sdata->subVars = subVars;
+	subVars = NULL;
+
+	Tcl_ListObjLength(NULL, sdata->subVars, &sdata->nParams);
+	sdata->params = (ParamData*) ckalloc(sdata->nParams * sizeof(ParamData));
+	memset(sdata->params, 0, sdata->nParams * sizeof(ParamData));
+	sdata->paramDataTypes = (Oid*) ckalloc(sdata->nParams * sizeof(Oid));
+	memset(sdata->paramDataTypes, 0, sdata->nParams * sizeof(Oid));
+	for (i = 0; i < sdata->nParams; ++i) {
+	    sdata->params[i].flags = PARAM_IN;
+	    sdata->paramDataTypes[i] = UNTYPEDOID ;
+	    sdata->params[i].precision = 0;
+	    sdata->params[i].scale = 0;
+	}
+
+	/* Prepare the statement */
+
+	res = PrepareStatement(interp, sdata, NULL);
+	if (res == NULL) {
+	    goto err;
+	}
+	if (TransferResultError(interp, res) != TCL_OK) {
+	    PQclear(res);
+	    goto err;
+	}
+
+	PQclear(res);
+
+	/* Record this statement in the connection's statements hash table */
+
+	DBG("Recording %s/%s in cdata->statements\n", name(cdata), name(sdata));
+	Tcl_SetHashValue(he, sdata);
+    }
+
+    newIr.twoPtrValue.ptr1 = sdata;
+    newIr.twoPtrValue.ptr2 = cdata->pgPtr;
+    Tcl_StoreInternalRep(obj, &pgStatementType, &newIr);
+
+    /* Add a ref for our intrep */
+
+    AddStatementRef(obj, sdata);
+
+    /* Drop the ref for our sdata pointer */
+
+    DecrStatementRefCount(sdata);
+    sdata = NULL;
+
+    *sdataOut = newIr.twoPtrValue.ptr1;
+
+    return TCL_OK;
+
+
+    /* On error, unwind all the resource allocations */
+
+ err:
+    if (nativeSql) {
+	Tcl_DecrRefCount(nativeSql);
+	nativeSql = NULL;
+    }
+    if (subVars) {
+	Tcl_DecrRefCount(subVars);
+	subVars = NULL;
+    }
+    if (tokens) {
+	Tcl_DecrRefCount(tokens);
+	tokens = NULL;
+    }
+    if (new && he) {
+	Tcl_DeleteHashEntry(he);
+	he = NULL;
+    }
+    if (sdata) {
+	DecrStatementRefCount(sdata);
+	sdata = NULL;
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetConstructor --
+ *
+ *	Constructs a new result set.
+ *
+ * Usage:
+ *	$resultSet new statement ?-option value?... ?dictionary?
+ *	$resultSet create name statement ?-option value?... ?dictionary?
+ *
+ * Parameters:
+ *	statement -- Statement handle to which this resultset belongs
+ *	dictionary -- Dictionary containing the substitutions for named
+ *		      parameters in the given statement.
+ *
+ * Options:
+ *	-fetchmode -- 'materialize' to read the whole result at once, or
+ *		      'stream' to read rows from the server as they are
+ *		      asked for. Defaults to the connection's -fetchmode.
+ *	-fetchmode -- may also be 'cursor', to FETCH rows in batches from
+ *		      a server-side cursor.
+ *	-chunksize -- Number of rows to transfer at a time when streaming,
+ *		      if the client library supports chunked rows, or to
+ *		      FETCH at a time from a cursor (0 lets the cursor
+ *		      adapt the number to the rows). Defaults to the
+ *		      connection's -chunksize.
+ *	-withhold -- Flag == 1 if a cursor is to outlive the transaction
+ *		      that declares it. Defaults to the connection's
+ *		      -withhold.
+ *	-cancelonclose -- Flag == 1 if a streaming query may be cancelled
+ *		      when its remaining rows are discarded. Defaults to
+ *		      the connection's -cancelonclose.
+ *	-positional -- List of values for the distinct parameters, in
+ *		      order of their first appearance, in place of the
+ *		      dictionary.
+ *
+ * Results:
+ *	Returns a standard Tcl result.  On error, the interpreter result
+ *	contains an appropriate message.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetConstructor(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    int skip = Tcl_ObjectContextSkippedArgs(context);
+				/* Number of args to skip */
+    Tcl_Object statementObject;	/* The current statement object */
+    ConnectionData* cdata;	/* The Postgres connection object's data */
+
+    StatementData* sdata;	/* The statement object's data */
+    ResultSetData* rdata;	/* THe result set object's data */
+    Tcl_Obj* paramDict = NULL;	/* Dictionary of parameter values */
+    Tcl_Obj* positionalObj = NULL;
+				/* List of parameter values */
+    int positionalc = 0;	/* Number of parameter values */
+    Tcl_Obj** positionalv = NULL;
+				/* Parameter values */
+    int fetchMode = FETCH_NONE;	/* Fetch mode requested by the caller */
+    int chunkSize = -1;		/* Chunk size requested by the caller */
+    int withHold = -1;		/* Cursor holding requested by the caller */
+    int cancelOnClose = -1;	/* Cancellation requested by the caller */
+    int intern = -1;		/* Interning requested by the caller */
+    int reuse = 0;		/* Flag == 1 to update rows in place */
+    Tcl_WideInt spillThreshold = -1;
+				/* Spill threshold requested by the caller */
+    int optionIndex;		/* Index of an option in ResultSetOptions */
+    int i;
+
+    /* Check parameter count */
+
+    if (objc < skip+1) {
+	goto wrongNumArgs;
+    }
+
+    /*
+     * Munch options off the front of the arguments. Anything that is not
+     * an option name followed by a value is the parameter dictionary.
+     */
+
+    for (i = skip+1; i+1 < objc; i += 2) {
+	if (Tcl_GetIndexFromObjStruct(NULL, objv[i], ResultSetOptions,
+				      sizeof(ResultSetOptions[0]), "option",
+				      TCL_EXACT, &optionIndex) != TCL_OK) {
+	    break;
+	}
+	switch (ResultSetOptions[optionIndex].type) {
+	case TYPE_FETCHMODE:
+	    if (Tcl_GetIndexFromObjStruct(interp, objv[i+1], FetchModes,
+					  sizeof(char *), "fetch mode",
+					  TCL_EXACT, &fetchMode) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_CHUNKSIZE:
+	    if (GetChunkSizeFromObj(interp, objv[i+1], &chunkSize) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_WITHHOLD:
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &withHold)
+		!= TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_CANCELONCLOSE:
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &cancelOnClose)
+		!= TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_INTERN:
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &intern)
+		!= TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_REUSE:
+	    if (Tcl_GetBooleanFromObj(interp, objv[i+1], &reuse)
+		!= TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_SPILLTHRESHOLD:
+	    if (GetByteCountFromObj(interp, objv[i+1], "spill threshold",
+				    &spillThreshold) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    break;
+	case TYPE_POSITIONAL:
+	    positionalObj = objv[i+1];
+	    break;
+	default:
+	    break;
+	}
+    }
+    if (i == objc-1) {
+	paramDict = objv[i];
+    } else if (i != objc) {
+	goto wrongNumArgs;
+    }
+    if (paramDict != NULL && positionalObj != NULL) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj("cannot give both "
+						  "-positional and a "
+						  "parameter dictionary", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+
+    /* Initialize the base classes */
+
+    Tcl_ObjectContextInvokeNext(interp, context, skip, objv, skip);
+
+    /* Find the statement object, and get the statement data */
+
+    statementObject = Tcl_GetObjectFromObj(interp, objv[skip]);
+    if (statementObject == NULL) {
+	return TCL_ERROR;
+    }
+    sdata = (StatementData*) Tcl_ObjectGetMetadata(statementObject,
+						   &statementDataType);
+    if (sdata == NULL) {
+	Tcl_AppendResult(interp, Tcl_GetString(objv[skip]),
+			 " does not refer to a Postgres statement", NULL);
+	return TCL_ERROR;
+    }
+    cdata = sdata->cdata;
+    if (CheckConnectionAvailable(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (positionalObj != NULL
+	&& (Tcl_ListObjGetElements(interp, positionalObj, &positionalc,
+				   &positionalv) != TCL_OK
+	    || CheckPositionalCount(interp, sdata, positionalc) != TCL_OK)) {
+	return TCL_ERROR;
+    }
+
+    rdata = NewResultSet(sdata, fetchMode, chunkSize, withHold,
+			 cancelOnClose, reuse);
+    Tcl_ObjectSetMetadata(thisObject, &resultSetDataType, (ClientData) rdata);
+
+    return ExecuteResultSet(interp, rdata, paramDict, positionalv,
+			    spillThreshold, intern);
+
+ wrongNumArgs:
+    Tcl_WrongNumArgs(interp, skip, objv,
+		     "statement ?-option value?... ?dictionary?");
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * NewResultSet --
+ *
+ *	Makes the data for a result set of a statement, before it is
+ *	executed.
+ *
+ * Results:
+ *	Returns the data, with a reference count of 1.
+ *
+ * Side effects:
+ *	Takes a reference to the statement.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static ResultSetData*
+NewResultSet(
+    StatementData* sdata,	/* Statement to execute */
+    int fetchMode,		/* Fetch mode, or FETCH_NONE for the
+				 * connection's */
+    int chunkSize,		/* Chunk size, or -1 for the connection's */
+    int withHold,		/* Cursor holding, or -1 for the
+				 * connection's */
+    int cancelOnClose,		/* Cancelling abandoned streams, or -1 for
+				 * the connection's */
+    int reuse			/* Flag == 1 to update rows in place */
+) {
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    ResultSetData* rdata;	/* Result set data */
+
+    rdata = (ResultSetData*) ckalloc(sizeof(ResultSetData));
+    memset(rdata, 0, sizeof(ResultSetData));
+    rdata->refCount = 1;
+    rdata->sdata = sdata;
+    rdata->stmtName = NULL;
+    rdata->plan = NULL;
+    rdata->execResult = NULL;
+    rdata->buffer = NULL;
+    rdata->rowCount = 0;
+    rdata->batchStart = 0;
+    rdata->fetchMode = (fetchMode != FETCH_NONE) ? fetchMode
+	: cdata->fetchMode;
+    rdata->chunkSize = (chunkSize != -1) ? chunkSize : cdata->chunkSize;
+    rdata->withHold = (withHold != -1) ? withHold : cdata->withHold;
+    rdata->cancelOnClose = (cancelOnClose != -1) ? cancelOnClose
+	: cdata->cancelOnClose;
+    rdata->spool = NULL;
+    rdata->cursorName = NULL;
+    rdata->cursorXact = -1;
+    rdata->internTable = NULL;
+    rdata->internCounts = NULL;
+    rdata->reuse = reuse;
+    rdata->varsSpec = NULL;
+    rdata->varNames = NULL;
+    rdata->fetchSize = 0;
+    rdata->batchTime.sec = 0;
+    rdata->batchTime.usec = 0;
+    rdata->pipelineNext = NULL;
+    rdata->flags = 0;
+    IncrStatementRefCount(sdata);
+    return rdata;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * AcquireStatementName --
+ *
+ *	Finds a prepared statement on the server with which to execute
+ *	a statement.
+ *
+ * Results:
+ *	Returns a standard Tcl result, and stores the name of the
+ *	prepared statement in '*stmtNamePtr'. The caller gives the name
+ *	back with ReleaseStatementName, even on failure if a name was
+ *	stored.
+ *
+ * Side effects:
+ *	If the main statement handle associated with the statement is
+ *	idle, it is used, after preparing it again if the types of the
+ *	parameters have changed. Otherwise, a fresh one is prepared.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+AcquireStatementName(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    StatementData* sdata,	/* Statement to execute */
+    char** stmtNamePtr		/* OUTPUT: Name of the prepared statement */
+) {
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    PGresult* res;		/* Temporary result */
+
+    if (sdata->flags & STMT_FLAG_BUSY) {
+	*stmtNamePtr = GenStatementName(cdata);
+	res = PrepareStatement(interp, sdata, *stmtNamePtr);
+	if (res == NULL) {
+	    return TCL_ERROR;
+	}
+	if (TransferResultError(interp, res) != TCL_OK) {
+	    PQclear(res);
+	    return TCL_ERROR;
+	}
+	PQclear(res);
+    } else {
+	*stmtNamePtr = sdata->stmtName;
+	sdata->flags |= STMT_FLAG_BUSY;
+
+	/* We need to check if parameter types changed since the
+	 * statement was prepared. If so, the statement is no longer
+	 * usable, so we prepare it once again */
+
+	if (sdata->paramTypesChanged) {
+	    UnallocateStatement(cdata, sdata->stmtName);
+	    ckfree(sdata->stmtName);
+	    sdata->stmtName = GenStatementName(cdata);
+	    *stmtNamePtr = sdata->stmtName;
+	    res = PrepareStatement(interp, sdata, NULL);
+	    if (res == NULL) {
+		return TCL_ERROR;
+	    }
+	    if (TransferResultError(interp, res) != TCL_OK) {
+		PQclear(res);
+		return TCL_ERROR;
+	    }
+	    PQclear(res);
+	    sdata->paramTypesChanged = 0;
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReleaseStatementName --
+ *
+ *	Gives back a name obtained from AcquireStatementName.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Unallocates the prepared statement if it was prepared for the
+ *	purpose, otherwise marks the statement's own handle idle.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+ReleaseStatementName(
+    StatementData* sdata,	/* Statement that was executed */
+    char* stmtName		/* Name to give back */
+) {
+    if (stmtName != sdata->stmtName) {
+	UnallocateStatement(sdata->cdata, stmtName);
+	ckfree(stmtName);
+    } else {
+	sdata->flags &= ~ STMT_FLAG_BUSY;
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetParamTables --
+ *
+ *	Locates the tables of marshalled parameters in storage obtained
+ *	from GetParamScratch.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Fills in 'tables'. The caller gives the storage back with
+ *	ReleaseParamScratch(sdata, tables->scratch).
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+GetParamTables(
+    StatementData* sdata,	/* Statement being executed */
+    ParamTables* tables		/* OUTPUT: Tables of parameters */
+) {
+    tables->scratch = GetParamScratch(sdata);
+    tables->values = (const char**) tables->scratch;
+    tables->slots = tables->scratch + sdata->nParams * sizeof(char*);
+    tables->lengths =
+	(int*) (tables->slots + sdata->nParams * PARAM_SLOT_BYTES);
+    tables->formats = tables->lengths + sdata->nParams;
+    tables->needsFreeing = (char*) (tables->formats + sdata->nParams);
+    memset(tables->needsFreeing, 0, sdata->nParams);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * MarshalParams --
+ *
+ *	Converts the parameters of one execution of a statement into the
+ *	form in which they are sent to the server.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Fills in 'tables' from 'positionalv', in the order of first
+ *	appearance of the parameters in the statement, if it is not NULL,
+ *	else from 'paramDict' if that is not NULL, else from variables in
+ *	the current scope. Values allocated for the purpose, including
+ *	those made before an error, are released by FreeParamValues.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+MarshalParams(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    StatementData* sdata,	/* Statement being executed */
+    Tcl_Obj* paramDict,		/* Dictionary of parameter values, or NULL */
+    Tcl_Obj* const* positionalv,
+				/* Parameter values in order, or NULL */
+    ParamTables* tables		/* Tables to fill in */
+) {
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    Tcl_Obj* paramNameObj;	/* Name of the current parameter */
+    const char* paramName;	/* Name of the current parameter */
+    Tcl_Obj* paramValObj;	/* Value of the current parameter */
+    int i;
+
+    for (i=0; i<sdata->nParams; i++) {
+	if (positionalv != NULL) {
+	    /* Param from the list of values */
+
+	    paramValObj = positionalv[i];
+	} else if (paramDict != NULL) {
+	    /* Param from a dictionary */
+
+	    Tcl_ListObjIndex(NULL, sdata->subVars, i, &paramNameObj);
+	    if (Tcl_DictObjGet(interp, paramDict,
+			       paramNameObj, &paramValObj) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+	    /* Param from a variable */
+
+	    Tcl_ListObjIndex(NULL, sdata->subVars, i, &paramNameObj);
+	    paramName = Tcl_GetString(paramNameObj);
+	    paramValObj = Tcl_GetVar2Ex(interp, paramName, NULL,
+					TCL_LEAVE_ERR_MSG);
+
+	}
+	/* At this point, paramValObj contains the parameter value */
+	if (paramValObj != NULL && FindBlobHandle(interp, paramValObj) != NULL) {
+
+	    /*
+	     * The contents of a channel. For an oid parameter, they are
+	     * copied into a new large object, whose oid is the value;
+	     * otherwise they are the value.
+	     */
+
+	    char* bufPtr = tables->slots + i * PARAM_SLOT_BYTES;
+	    Oid blobOid;
+
+	    if (sdata->paramDataTypes[i] == OIDOID) {
+		if (WriteBlobParam(interp, cdata, paramValObj,
+				   &blobOid) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		PutNetworkOrder(bufPtr, (Tcl_WideUInt) blobOid,
+				sizeof(int32_t));
+		tables->values[i] = bufPtr;
+		tables->formats[i] = 1;
+		tables->lengths[i] = sizeof(int32_t);
+	    } else {
+		bufPtr = ReadBlobParam(interp, cdata, paramValObj,
+				       &tables->lengths[i]);
+		if (bufPtr == NULL) {
+		    return TCL_ERROR;
+		}
+		tables->values[i] = bufPtr;
+		tables->needsFreeing[i] = 1;
+		tables->formats[i] = (sdata->paramDataTypes[i] == BYTEAOID);
+	    }
+	} else if (paramValObj != NULL) {
+	    char* bufPtr = tables->slots + i * PARAM_SLOT_BYTES;
+	    int tmpInt;
+	    long tmpLong;
+	    Oid elementType;
+
+	    switch (sdata->paramDataTypes[i]) {
+	    case INT2OID:
+		if (Tcl_GetIntFromObj(interp, paramValObj,
+				      &tmpInt) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		PutNetworkOrder(bufPtr, (Tcl_WideUInt) tmpInt,
+				sizeof(int16_t));
+		tables->values[i] = bufPtr;
+		tables->formats[i] = 1;
+		tables->lengths[i] = sizeof(int16_t);
+		break;
+
+	    case INT4OID:
+		if (Tcl_GetLongFromObj(interp, paramValObj,
+				       &tmpLong) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		PutNetworkOrder(bufPtr, (Tcl_WideUInt) tmpLong,
+				sizeof(int32_t));
+		tables->values[i] = bufPtr;
+		tables->formats[i] = 1;
+		tables->lengths[i] = sizeof(int32_t);
+		break;
+
+		/*
+		 * These types are sent in binary, which spares both sides
+		 * formatting and parsing text, and lets Tcl's notations for
+		 * numbers (hex, octal, binary) through. Values that the
+		 * encoder does not recognize are sent as text, for SQL to
+		 * make what it can of them.
+		 */
+
+	    case BOOLOID:
+	    case INT8OID:
+	    case OIDOID:
+	    case FLOAT4OID:
+	    case FLOAT8OID:
+	    case NUMERICOID:
+	    case DATEOID:
+	    case TIMESTAMPOID:
+	    case UUIDOID:
+		if (!EncodeBinaryParam(cdata, sdata->paramDataTypes[i],
+				       paramValObj, &bufPtr,
+				       &tables->lengths[i])) {
+		    goto convertString;
+		}
+		tables->values[i] = bufPtr;
+		tables->needsFreeing[i] =
+		    (bufPtr != tables->slots + i * PARAM_SLOT_BYTES);
+		tables->formats[i] = 1;
+		break;
+
+	    case BYTEAOID:
+		tables->formats[i] = 1;
+		tables->values[i] =
+		    (char*)Tcl_GetByteArrayFromObj(paramValObj,
+						   &tables->lengths[i]);
+		break;
+
+	    default:
+
+		/* A list for an array parameter */
+
+		elementType = ArrayElementType(sdata->paramDataTypes[i]);
+		if (elementType != UNTYPEDOID) {
+		    bufPtr = EncodeArrayParam(cdata, elementType, paramValObj,
+					      &tables->lengths[i],
+					      &tables->formats[i]);
+		    if (bufPtr != NULL) {
+			tables->values[i] = bufPtr;
+			tables->needsFreeing[i] = 1;
+			break;
+		    }
+		}
+
+	    convertString:
+		tables->formats[i] = 0;
+		tables->values[i] = Tcl_GetStringFromObj(paramValObj,
+						      &tables->lengths[i]);
+		break;
+	    }
+	} else {
+	    tables->values[i] = NULL;
+	    tables->formats[i] = 0;
+	}
+    }
+
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FreeParamValues --
+ *
+ *	Releases the values that MarshalParams allocated.
+ *
+ * Results:
+ *	None.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FreeParamValues(
+    StatementData* sdata,	/* Statement that was executed */
+    ParamTables* tables		/* Marshalled parameters */
+) {
+    int i;
+
+    for (i = 0; i < sdata->nParams; ++i) {
+	if (tables->needsFreeing[i]) {
+	    ckfree(tables->values[i]);
+	    tables->needsFreeing[i] = 0;
+	}
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ExecuteResultSet --
+ *
+ *	Executes the statement of a result set.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Binds the parameters, from 'positionalv' in the order of their
+ *	first appearance in the statement if it is not NULL, else from
+ *	'paramDict' if that is not NULL, else from variables in the
+ *	current scope. Sends the statement to the server, and reads its
+ *	result or the first batch of it, according to the fetch mode.
+ *	Inside a 'pipeline' script, a statement whose result is read
+ *	whole is queued instead, and its result is read later; otherwise
+ *	the statements queued so far are synchronized first.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ExecuteResultSet(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set to execute */
+    Tcl_Obj* paramDict,		/* Dictionary of parameter values, or NULL */
+    Tcl_Obj* const* positionalv,
+				/* Parameter values in order, or NULL */
+    Tcl_WideInt spillThreshold,	/* Spill threshold, or -1 for the
+				 * connection's */
+    int intern			/* Interning, or -1 for the connection's */
+) {
+    StatementData* sdata = rdata->sdata;
+				/* Statement data */
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    ParamTables tables;		/* Marshalled parameters */
+    int resultFormat;		/* Format in which to request results */
+    int spooled;		/* Flag == 1 if a materialized result is
+				 * to be read into a spool */
+    int status = TCL_ERROR;	/* Return status */
+
+    if (CanPipeline(rdata, spillThreshold)) {
+	GetParamTables(sdata, &tables);
+	if (MarshalParams(interp, sdata, paramDict, positionalv,
+			  &tables) == TCL_OK
+	    && SendPipelined(interp, rdata, &tables) == TCL_OK) {
+	    if ((intern != -1) ? intern : cdata->intern) {
+		rdata->flags |= RS_FLAG_INTERN;
+	    }
+	    status = TCL_OK;
+	}
+	goto freeParamTables;
+    }
+
+    if (SyncPipeline(interp, cdata) != TCL_OK
+	|| AcquireStatementName(interp, sdata, &rdata->stmtName) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    GetParamTables(sdata, &tables);
+    if (MarshalParams(interp, sdata, paramDict, positionalv,
+		      &tables) != TCL_OK) {
+	goto freeParamTables;
+    }
+
+    /* Execute the statement */
+
+    resultFormat = BinaryResultsWanted(sdata);
+    if (spillThreshold == -1) {
+	spillThreshold = cdata->spillThreshold;
+    }
+
+    /*
+     * A materialized result that may spill goes through a spool. So does
+     * one held to a memory limit, if the client library can hand rows
+     * over a chunk at a time; reading it a row at a time would cost far
+     * more than the limit saves, so without chunks the whole result is
+     * received and its size checked afterwards.
+     */
+
+    spooled = (spillThreshold > 0
+	       || (cdata->maxResultBytes > 0
+		   && PQsetChunkedRowsMode != NULL));
+    if (rdata->fetchMode == FETCH_STREAM
+	|| (rdata->fetchMode == FETCH_MATERIALIZE && spooled)) {
+
+	/*
+	 * Send the query, and ask for the rows to be handed over one
+	 * at a time, or a chunk at a time if the client library knows how.
+	 * Only the first batch is read here; ResultSetCurrentRow reads
+	 * the rest as the caller consumes them. A spooled result is read
+	 * whole, a spool batch at a time.
+	 */
+
+	int chunkRows = (rdata->fetchMode == FETCH_STREAM)
+	    ? rdata->chunkSize : SPOOL_BATCH_ROWS;
+				/* Rows per transfer */
+
+	/*
+	 * Where the caller vouches that a query has no effects that
+	 * cancelling it could undo - a plain query can still call a
+	 * function that writes - its unwanted rows can be dropped by
+	 * cancelling it rather than by reading them all. Within a
+	 * transaction, cancelling would abort the transaction.
+	 */
+
+	if (rdata->cancelOnClose
+	    && PQtransactionStatus(cdata->pgPtr) == PQTRANS_IDLE
+	    && StatementIsQuery(sdata, 0)) {
+	    rdata->flags |= RS_FLAG_CANCELLABLE;
+	}
+	if (!PQsendQueryPrepared(cdata->pgPtr, rdata->stmtName,
+				 sdata->nParams, tables.values,
+				 tables.lengths, tables.formats, resultFormat)) {
+	    TransferPostgresError(interp, cdata->pgPtr);
+	    goto freeParamTables;
+	}
+	if (chunkRows <= 1 || PQsetChunkedRowsMode == NULL
+	    || !PQsetChunkedRowsMode(cdata->pgPtr, chunkRows)) {
+	    PQsetSingleRowMode(cdata->pgPtr);
+	}
+	rdata->flags |= RS_FLAG_STREAMING;
+	cdata->streamOwner = rdata;
+	if (rdata->fetchMode == FETCH_MATERIALIZE) {
+
+	    /*
+	     * Materialize the rows into a spool rather than into one
+	     * PGresult, so that a large result costs no more memory than
+	     * the spill threshold, and one that is too large for the
+	     * memory limit is caught before it is all in memory.
+	     */
+
+	    if (SpoolResult(interp, rdata, spillThreshold) != TCL_OK) {
+		goto freeParamTables;
+	    }
+	} else if (ReadStreamBatch(interp, rdata) != TCL_OK) {
+	    goto freeParamTables;
+	}
+    } else if (rdata->fetchMode == FETCH_CURSOR && StatementIsQuery(sdata, 1)) {
+	if (OpenCursor(interp, rdata, tables.values, tables.lengths,
+		       tables.formats) != TCL_OK) {
+	    goto freeParamTables;
+	}
+    } else {
+	rdata->execResult = PQexecPrepared(cdata->pgPtr, rdata->stmtName,
+					   sdata->nParams, tables.values,
+					   tables.lengths, tables.formats,
+					   resultFormat);
+	if (TransferResultError(interp, rdata->execResult) != TCL_OK
+	    || (cdata->maxResultBytes > 0
+		&& CheckResultLimit(interp, rdata,
+				    ResultMemorySize(rdata->execResult))
+		   != TCL_OK)) {
+	    goto freeParamTables;
+	}
+    }
+
+    /* Plan the decoding of the rows, unless an earlier execution did */
+
+    rdata->plan = StatementPlan(sdata, rdata->execResult);
+    IncrDecodePlanRefCount(rdata->plan);
+    SetupInterning(rdata, (intern != -1) ? intern : cdata->intern);
+    status = TCL_OK;
+
+    /* Clean up allocated memory */
+
+ freeParamTables:
+    FreeParamValues(sdata, &tables);
+    ReleaseParamScratch(sdata, tables.scratch);
+
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReadStreamBatch --
+ *
+ *	Reads the next batch of rows of a streaming result set from the
+ *	connection.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Replaces rdata->execResult with the batch just read. When the
+ *	result that ends the stream arrives, it is kept in
+ *	rdata->execResult for the sake of the 'rowcount' method, and the
+ *	connection is released for other commands. Errors reported by
+ *	the server are left in the interpreter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ReadStreamBatch(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata	/* Streaming result set */
+) {
+    ConnectionData* cdata = rdata->sdata->cdata;
+				/* Connection that carries the stream */
+    PGresult* res;		/* Next result from the server */
+    int status = TCL_OK;
+
+    res = PQgetResult(cdata->pgPtr);
+    if (res == NULL) {
+	FinishStream(rdata);
+	return TCL_OK;
+    }
+    ReleaseExecResult(rdata);
+    rdata->execResult = res;
+    rdata->batchStart = rdata->rowCount;
+
+    switch (PQresultStatus(res)) {
+    case PGRES_SINGLE_TUPLE:
+    case PGRES_TUPLES_CHUNK:
+	status = CheckResultLimit(interp, rdata, ResultMemorySize(res));
+	break;
+    default:
+
+	/*
+	 * Anything else, whether the empty result that terminates a
+	 * stream of rows, a command status or an error, is the last word
+	 * from the server about this statement.
+	 */
+
+	status = TransferResultError(interp, res);
+	FinishStream(rdata);
+	break;
+    }
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FinishStream --
+ *
+ *	Ends the streaming of rows for a result set, discarding any
+ *	results that are still to come.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Makes the connection available for other commands, and issues
+ *	any DEALLOCATE commands that were waiting for it.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FinishStream(
+    ResultSetData* rdata	/* Streaming result set */
+) {
+    ConnectionData* cdata = rdata->sdata->cdata;
+				/* Connection that carries the stream */
+    PGresult* res;		/* Result to discard */
+
+    if (!(rdata->flags & RS_FLAG_STREAMING)) {
+	return;
+    }
+    while ((res = PQgetResult(cdata->pgPtr)) != NULL) {
+	PQclear(res);
+    }
+    rdata->flags &= ~RS_FLAG_STREAMING;
+    if (cdata->streamOwner == rdata) {
+	cdata->streamOwner = NULL;
+	RunDeferredDeallocs(cdata);
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SpoolResult --
+ *
+ *	Reads the whole of a result that is being streamed into a spool,
+ *	moving the spool to a temporary file once it outgrows a threshold.
+ *	A spool that stays in memory is held to the connection's
+ *	-maxresultbytes limit.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Finishes the stream. If any rows arrived, attaches the spool to the
+ *	result set and loads its first batch of rows into
+ *	rdata->execResult. Otherwise, the result that ended the stream is
+ *	left in rdata->execResult as for any materialized result.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+SpoolResult(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Streaming result set */
+    Tcl_WideInt threshold	/* Bytes to keep in memory, or 0 to keep
+				 * all of them */
+) {
+    ResultSpool* spool = NULL;	/* Spool being filled */
+    PGresult* res;		/* Batch of rows from the server */
+    int nTuples;		/* Number of rows in the batch */
+    int len;			/* Length of a value, or -1 for NULL */
+    int nBatches;		/* Number of batches in the spool */
+    int i, j;
+
+    while (rdata->flags & RS_FLAG_STREAMING) {
+	ReleaseExecResult(rdata);
+	if (ReadStreamBatch(interp, rdata) != TCL_OK) {
+	    goto error;
+	}
+	res = rdata->execResult;
+	if (res == NULL) {
+	    continue;
+	}
+	switch (PQresultStatus(res)) {
+	case PGRES_SINGLE_TUPLE:
+	case PGRES_TUPLES_CHUNK:
+	    break;
+	default:
+	    continue;
+	}
+
+	if (spool == NULL) {
+	    spool = (ResultSpool*) ckalloc(sizeof(ResultSpool));
+	    memset(spool, 0, sizeof(ResultSpool));
+	    spool->nColumns = PQnfields(res);
+	    spool->attrs = (PGresAttDesc*)
+		ckalloc((spool->nColumns + 1) * sizeof(PGresAttDesc));
+	    for (i = 0; i < spool->nColumns; ++i) {
+		const char* name = PQfname(res, i);
+		PGresAttDesc* attr = spool->attrs + i;
+
+		attr->name = ckalloc(strlen(name) + 1);
+		strcpy(attr->name, name);
+		attr->tableid = PQftable(res, i);
+		attr->columnid = PQftablecol(res, i);
+		attr->format = PQfformat(res, i);
+		attr->typid = PQftype(res, i);
+		attr->typlen = PQfsize(res, i);
+		attr->atttypmod = PQfmod(res, i);
+	    }
+	}
+
+	nTuples = PQntuples(res);
+	for (i = 0; i < nTuples; ++i) {
+	    if (spool->nRows % SPOOL_BATCH_ROWS == 0) {
+		nBatches = spool->nRows / SPOOL_BATCH_ROWS;
+		if (nBatches >= spool->batchCapacity) {
+		    spool->batchCapacity = 2 * spool->batchCapacity + 16;
+		    spool->batchOffsets = (Tcl_WideInt*)
+			ckrealloc((char*) spool->batchOffsets,
+				  spool->batchCapacity * sizeof(Tcl_WideInt));
+		}
+		spool->batchOffsets[nBatches] = spool->size;
+	    }
+	    for (j = 0; j < spool->nColumns; ++j) {
+		len = PQgetisnull(res, i, j) ? -1 : PQgetlength(res, i, j);
+		SpoolAppend(spool, &len, sizeof(int));
+		if (len > 0) {
+		    SpoolAppend(spool, PQgetvalue(res, i, j), len);
+		}
+	    }
+	    ++spool->nRows;
+	}
+
+	/* Move the spool to a temporary file once it is too big */
+
+	if (spool->chan == NULL && threshold > 0 && spool->size > threshold) {
+	    Tcl_Obj* cmd[2];
+	    int mode;
+	    int status;
+
+	    cmd[0] = Tcl_NewStringObj("::file", -1);
+	    cmd[1] = Tcl_NewStringObj("tempfile", -1);
+	    Tcl_IncrRefCount(cmd[0]);
+	    Tcl_IncrRefCount(cmd[1]);
+	    status = Tcl_EvalObjv(interp, 2, cmd, TCL_EVAL_GLOBAL);
+	    Tcl_DecrRefCount(cmd[0]);
+	    Tcl_DecrRefCount(cmd[1]);
+	    if (status != TCL_OK) {
+		goto error;
+	    }
+	    spool->chan = Tcl_GetChannel(interp,
+					 Tcl_GetString(Tcl_GetObjResult(interp)),
+					 &mode);
+	    if (spool->chan == NULL) {
+		goto error;
+	    }
+
+	    /*
+	     * Hold the channel privately, so that the script cannot see
+	     * or close it.
+	     */
+
+	    Tcl_RegisterChannel(NULL, spool->chan);
+	    Tcl_UnregisterChannel(interp, spool->chan);
+	    Tcl_ResetResult(interp);
+	    if (Tcl_SetChannelOption(interp, spool->chan, "-translation",
+				     "binary") != TCL_OK) {
+		goto error;
+	    }
+	}
+	if (spool->chan != NULL && spool->nBytes >= SPOOL_BLOCK_BYTES
+	    && FlushSpool(interp, spool) != TCL_OK) {
+	    goto error;
+	}
+	if (spool->chan == NULL
+	    && CheckResultLimit(interp, rdata, spool->size) != TCL_OK) {
+	    goto error;
+	}
+    }
+
+    if (spool == NULL) {
+	return TCL_OK;
+    }
+    if (spool->chan != NULL && FlushSpool(interp, spool) != TCL_OK) {
+	goto error;
+    }
+    rdata->spool = spool;
+    return LoadSpoolBatch(interp, rdata, 0);
+
+ error:
+    if (spool != NULL) {
+	DeleteSpool(spool);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SpoolAppend --
+ *
+ *	Appends bytes to a spool.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The bytes are added to the spool's buffer, which grows as needed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+SpoolAppend(
+    ResultSpool* spool,		/* Spool */
+    const void* data,		/* Bytes to append */
+    size_t n			/* Number of bytes */
+) {
+    if (spool->nBytes + n > spool->capacity) {
+	spool->capacity = 2 * spool->capacity;
+	if (spool->capacity < spool->nBytes + n) {
+	    spool->capacity = spool->nBytes + n;
+	}
+	spool->bytes = ckrealloc(spool->bytes, spool->capacity);
+    }
+    memcpy(spool->bytes + spool->nBytes, data, n);
+    spool->nBytes += n;
+    spool->size += n;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FlushSpool --
+ *
+ *	Writes the buffered bytes of a spool to its temporary file.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Empties the spool's buffer. Leaves an error in the interpreter if
+ *	the file cannot be written.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+FlushSpool(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSpool* spool		/* Spool */
+) {
+    if (Tcl_Write(spool->chan, spool->bytes, spool->nBytes) < 0
+	|| Tcl_Flush(spool->chan) != TCL_OK) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "error writing result spool: %s", Tcl_PosixError(interp)));
+	return TCL_ERROR;
+    }
+    spool->nBytes = 0;
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * LoadSpoolBatch --
+ *
+ *	Rebuilds a batch of rows of a spooled result set.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Replaces rdata->execResult with a result holding the rows of the
+ *	batch, and sets rdata->batchStart to the number of its first row.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+LoadSpoolBatch(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    int batch			/* Number of the batch */
+) {
+    ResultSpool* spool = rdata->spool;
+				/* Spool holding the rows */
+    int first = batch * SPOOL_BATCH_ROWS;
+				/* First row of the batch */
+    int nRows = spool->nRows - first;
+				/* Number of rows in the batch */
+    Tcl_WideInt start = spool->batchOffsets[batch];
+				/* Offset of the batch in the spool */
+    Tcl_WideInt end;		/* Offset of the end of the batch */
+    char* scratch = NULL;	/* Batch read from the temporary file */
+    const char* p;		/* Current position in the batch */
+    PGresult* res;		/* Rebuilt result */
+    int len;			/* Length of a value, or -1 for NULL */
+    int i, j;
+
+    if (nRows > SPOOL_BATCH_ROWS) {
+	nRows = SPOOL_BATCH_ROWS;
+	end = spool->batchOffsets[batch + 1];
+    } else {
+	end = spool->size;
+    }
+
+    if (spool->chan == NULL) {
+	p = spool->bytes + start;
+    } else {
+	scratch = ckalloc(end - start);
+	if (Tcl_Seek(spool->chan, start, SEEK_SET) < 0
+	    || Tcl_Read(spool->chan, scratch, end - start) != end - start) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"error reading result spool: %s", Tcl_PosixError(interp)));
+	    ckfree(scratch);
+	    return TCL_ERROR;
+	}
+	p = scratch;
+    }
+
+    res = PQmakeEmptyPGresult(rdata->sdata->cdata->pgPtr, PGRES_TUPLES_OK);
+    if (res == NULL
+	|| !PQsetResultAttrs(res, spool->nColumns, spool->attrs)) {
+	goto outOfMemory;
+    }
+    for (i = 0; i < nRows; ++i) {
+	for (j = 0; j < spool->nColumns; ++j) {
+	    memcpy(&len, p, sizeof(int));
+	    p += sizeof(int);
+	    if (!PQsetvalue(res, i, j, (char*) p, len)) {
+		goto outOfMemory;
+	    }
+	    if (len > 0) {
+		p += len;
+	    }
+	}
+    }
+    if (scratch != NULL) {
+	ckfree(scratch);
+    }
+
+    ReleaseExecResult(rdata);
+    rdata->execResult = res;
+    rdata->batchStart = first;
+    return TCL_OK;
+
+ outOfMemory:
+    if (res != NULL) {
+	PQclear(res);
+    }
+    if (scratch != NULL) {
+	ckfree(scratch);
+    }
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	"not enough memory to rebuild rows of the result spool", -1));
+    Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY001",
+		     "POSTGRES", "-1", NULL);
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DeleteSpool --
+ *
+ *	Frees a spool of rows.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Closes the temporary file, if there is one, which deletes it.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DeleteSpool(
+    ResultSpool* spool		/* Spool to free */
+) {
+    int i;
+
+    if (spool->chan != NULL) {
+	Tcl_UnregisterChannel(NULL, spool->chan);
+    }
+    for (i = 0; i < spool->nColumns; ++i) {
+	ckfree(spool->attrs[i].name);
+    }
+    ckfree(spool->attrs);
+    if (spool->batchOffsets != NULL) {
+	ckfree(spool->batchOffsets);
+    }
+    if (spool->bytes != NULL) {
+	ckfree(spool->bytes);
+    }
+    ckfree(spool);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetCurrentRow --
+ *
+ *	Locates the next row to be returned from a result set, reading
+ *	another batch from the server if the result set is streaming and
+ *	the rows at hand are used up, or from the spool if it is spooled.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Stores in '*rowPtr' the number of the row within rdata->execResult,
+ *	or -1 if the result set has no more rows. Releases the last batch
+ *	of rows of a cursor once it is exhausted.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetCurrentRow(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    int* rowPtr			/* OUTPUT: Row number within execResult */
+) {
+    int row;
+
+    for (;;) {
+	row = rdata->rowCount - rdata->batchStart;
+	if (row >= 0 && row < PQntuples(rdata->execResult)) {
+	    *rowPtr = row;
+	    return TCL_OK;
+	}
+	if (rdata->spool != NULL) {
+	    if (rdata->rowCount >= rdata->spool->nRows) {
+		*rowPtr = -1;
+		return TCL_OK;
+	    }
+	    if (LoadSpoolBatch(interp, rdata,
+			       rdata->rowCount / SPOOL_BATCH_ROWS) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (rdata->flags & RS_FLAG_STREAMING) {
+	    if (ReadStreamBatch(interp, rdata) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else if (rdata->flags & RS_FLAG_CURSOR) {
+	    if (FetchCursorBatch(interp, rdata) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	} else {
+
+	    /*
+	     * The rows are exhausted. If they came from a cursor, let go of
+	     * its last batch, so that the memory is reclaimed as soon as no
+	     * lazy cell refers to it rather than when the result set is
+	     * destroyed; the count of rows is kept for the 'rowcount'
+	     * method. A materialized result is kept whole for the random
+	     * access methods.
+	     */
+
+	    if (row > 0 && (rdata->flags & RS_FLAG_BATCHED)) {
+		ReleaseExecResult(rdata);
+		rdata->batchStart = rdata->rowCount;
+	    }
+	    *rowPtr = -1;
+	    return TCL_OK;
+	}
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * StatementIsQuery --
+ *
+ *	Determines whether a statement is a query that can be declared
+ *	as a cursor.
+ *
+ * Results:
+ *	Returns 1 if the statement begins with SELECT, VALUES, TABLE or,
+ *	if 'withAllowed' is true, WITH, and 0 otherwise. A statement
+ *	beginning with WITH may modify data.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+StatementIsQuery(
+    StatementData* sdata,	/* Statement to examine */
+    int withAllowed		/* Flag == 1 if WITH queries count */
+) {
+    static const char *const queryWords[] = {
+	"SELECT", "VALUES", "TABLE", "WITH", NULL
+    };
+    const char* sql = Tcl_GetString(sdata->nativeSql);
+    size_t len;
+    int i;
+
+    while (*sql == '(' || isspace((unsigned char) *sql)) {
+	++sql;
+    }
+    for (i = 0; queryWords[i] != NULL; ++i) {
+	if (!withAllowed && !strcmp(queryWords[i], "WITH")) {
+	    continue;
+	}
+	len = strlen(queryWords[i]);
+	if (Tcl_UtfNcasecmp(sql, queryWords[i], len) == 0
+	    && !isalnum((unsigned char) sql[len]) && sql[len] != '_') {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * OpenCursor --
+ *
+ *	Declares a server-side cursor for the statement of a result set,
+ *	and fetches its first batch of rows.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Leaves the first batch of rows in rdata->execResult. Errors are
+ *	left in the interpreter.
+ *
+ * Outside a transaction, a cursor would vanish as soon as it was
+ * declared, so it is always declared WITH HOLD there. The implicit
+ * transaction of the DECLARE then ends at once, and the server
+ * materializes the whole result before the first FETCH.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+OpenCursor(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    const char *const* paramValues,
+				/* Values of the parameters */
+    const int* paramLengths,	/* Lengths of the parameter values */
+    const int* paramFormats	/* Formats of the parameter values */
+) {
+    StatementData* sdata = rdata->sdata;
+				/* Statement being executed */
+    ConnectionData* cdata = sdata->cdata;
+				/* Connection data */
+    Tcl_Obj* sqlQuery;		/* DECLARE command */
+    PGresult* res;		/* Result of the DECLARE */
+    int status;
+
+    rdata->cursorName = GenCursorName(cdata);
+    sqlQuery = Tcl_NewStringObj("DECLARE ", -1);
+    Tcl_IncrRefCount(sqlQuery);
+    Tcl_AppendToObj(sqlQuery, rdata->cursorName, -1);
+    if (BinaryResultsWanted(sdata)) {
+	Tcl_AppendToObj(sqlQuery, " BINARY", -1);
+    }
+    Tcl_AppendToObj(sqlQuery, " NO SCROLL CURSOR ", -1);
+    if (rdata->withHold
+	|| PQtransactionStatus(cdata->pgPtr) == PQTRANS_IDLE) {
+	Tcl_AppendToObj(sqlQuery, "WITH HOLD ", -1);
+	rdata->cursorXact = -1;
+    } else {
+	rdata->cursorXact = cdata->xactCounter;
+    }
+    Tcl_AppendToObj(sqlQuery, "FOR ", -1);
+    Tcl_AppendObjToObj(sqlQuery, sdata->nativeSql);
+
+    res = PQexecParams(cdata->pgPtr, Tcl_GetString(sqlQuery),
+		       sdata->nParams, sdata->paramDataTypes, paramValues,
+		       paramLengths, paramFormats, 0);
+    Tcl_DecrRefCount(sqlQuery);
+    if (res == NULL) {
+	TransferPostgresError(interp, cdata->pgPtr);
+	status = TCL_ERROR;
+    } else {
+	status = TransferResultError(interp, res);
+	PQclear(res);
+    }
+    if (status != TCL_OK) {
+	ckfree(rdata->cursorName);
+	rdata->cursorName = NULL;
+	return TCL_ERROR;
+    }
+
+    rdata->flags |= RS_FLAG_CURSOR | RS_FLAG_BATCHED;
+    rdata->fetchSize = (rdata->chunkSize > 0) ? rdata->chunkSize
+	: CURSOR_FETCH_INITIAL;
+    return FetchCursorBatch(interp, rdata);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FetchCursorBatch --
+ *
+ *	Fetches the next batch of rows from the cursor of a result set.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Replaces rdata->execResult with the rows just fetched, and closes
+ *	the cursor once it is exhausted. Unless the result set was given
+ *	a chunk size, the size of the next FETCH is adjusted to the
+ *	width of the rows and to the time that the server takes to
+ *	deliver them compared with the time the script spends on them.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+FetchCursorBatch(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata	/* Result set */
+) {
+    ConnectionData* cdata = rdata->sdata->cdata;
+				/* Connection data */
+    char sqlQuery[80];		/* FETCH command */
+    PGresult* res;		/* Result of the FETCH */
+    Tcl_Time start;		/* Time at which the FETCH began */
+    Tcl_Time end;		/* Time at which the FETCH finished */
+    Tcl_WideInt fetchTime;	/* Microseconds spent in the FETCH */
+    Tcl_WideInt consumeTime;	/* Microseconds spent on the last batch */
+    Tcl_WideInt bytes = 0;	/* Size of the data fetched */
+    Tcl_WideInt maxRows;	/* Rows that fit in CURSOR_BATCH_BYTES */
+    int nRows;			/* Number of rows fetched */
+    int nColumns;		/* Number of columns per row */
+    int newSize;		/* Size of the next FETCH */
+    int i, j;
+
+    if (CheckConnectionIdle(interp, cdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    Tcl_GetTime(&start);
+    snprintf(sqlQuery, sizeof(sqlQuery), "FETCH FORWARD %d FROM %s",
+	     rdata->fetchSize, rdata->cursorName);
+    res = PQexec(cdata->pgPtr, sqlQuery);
+    if (res == NULL) {
+	TransferPostgresError(interp, cdata->pgPtr);
+	return TCL_ERROR;
+    }
+    if (TransferResultError(interp, res) != TCL_OK) {
+	PQclear(res);
+	return TCL_ERROR;
+    }
+    Tcl_GetTime(&end);
+
+    ReleaseExecResult(rdata);
+    rdata->execResult = res;
+    rdata->batchStart = rdata->rowCount;
+    if (CheckResultLimit(interp, rdata, ResultMemorySize(res)) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    nRows = PQntuples(res);
+
+    if (nRows < rdata->fetchSize) {
+
+	/* The cursor is exhausted */
+
+	rdata->flags &= ~RS_FLAG_CURSOR;
+	CloseCursor(cdata, rdata->cursorName, rdata->cursorXact);
+	ckfree(rdata->cursorName);
+	rdata->cursorName = NULL;
+
+    } else if (rdata->chunkSize == 0) {
+
+	/*
+	 * Double the batch if the round trip is a noticeable part of
+	 * the time per batch; then trim it to the byte budget.
+	 */
+
+	newSize = rdata->fetchSize;
+	fetchTime = (Tcl_WideInt) (end.sec - start.sec) * 1000000
+	    + (end.usec - start.usec);
+	if (rdata->batchTime.sec != 0 || rdata->batchTime.usec != 0) {
+	    consumeTime = (Tcl_WideInt) (start.sec - rdata->batchTime.sec)
+		* 1000000 + (start.usec - rdata->batchTime.usec);
+	    if (fetchTime * CURSOR_LATENCY_RATIO > consumeTime) {
+		newSize *= 2;
+	    }
+	}
+	nColumns = PQnfields(res);
+	for (i = 0; i < nRows; ++i) {
+	    for (j = 0; j < nColumns; ++j) {
+		bytes += PQgetlength(res, i, j);
+	    }
+	}
+	maxRows = (Tcl_WideInt) CURSOR_BATCH_BYTES * nRows / (bytes + 1);
+	if (newSize > maxRows) {
+	    newSize = (int) maxRows;
+	}
+	if (newSize > CURSOR_FETCH_MAX) {
+	    newSize = CURSOR_FETCH_MAX;
+	}
+	if (newSize < 1) {
+	    newSize = 1;
+	}
+	rdata->fetchSize = newSize;
+    }
+    rdata->batchTime = end;
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetColumnsMethod --
+ *
+ *	Retrieves the list of columns from a result set.
+ *
+ * Usage:
+ *	$resultSet columns
+ *
+ * Results:
+ *	Returns the count of columns
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetColumnsMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+    StatementData* sdata = (StatementData*) rdata->sdata;
+
+    if (objc != 2) {
+	Tcl_WrongNumArgs(interp, 2, objv, "?pattern?");
+	return TCL_ERROR;
+    }
+
+    Tcl_SetObjResult(interp, (sdata->columnNames));
+
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetNextrowMethod --
+ *
+ *	Retrieves the next row from a result set.
+ *
+ * Usage:
+ *	$resultSet nextrow ?-as lists|dicts? ?--? variableName
+ *
+ * Options:
+ *	-as	Selects the desired form for returning the results.
+ *
+ * Parameters:
+ *	variableName -- Variable in which the results are to be returned
+ *
+ * Results:
+ *	Returns a standard Tcl result.  The interpreter result is 1 if there
+ *	are more rows remaining, and 0 if no more rows remain.
+ *
+ * Side effects:
+ *	Stores in the given variable either a list or a dictionary
+ *	containing one row of the result set.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetNextrowMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    int lists = PTR2INT(clientData);
+
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    StatementData* sdata = (StatementData*) rdata->sdata;
+				/* Statement that yielded the result set */
+    ConnectionData* cdata = (ConnectionData*) sdata->cdata;
+				/* Connection that opened the statement */
+    PerInterpData* pidata = (PerInterpData*) cdata->pidata;
+				/* Per interpreter data */
+    Tcl_Obj** literals = pidata->literals;
+
+    Tcl_Obj* resultRow;		/* Row of the result set under construction */
+    Tcl_Obj* prevRow = NULL;	/* Row left in the variable by the last
+				 * call, if it is to be reused */
+
+    int status = TCL_ERROR;	/* Status return from this command */
+
+    int row;			/* Row number within rdata->execResult */
+    int n;			/* Number of elements in the row */
+
+    if (objc != 3) {
+	Tcl_WrongNumArgs(interp, 2, objv, "varName");
+	return TCL_ERROR;
+    }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /* Check if row counter haven't already rech the last row */
+    if (ResultSetCurrentRow(interp, rdata, &row) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (row < 0 || rdata->plan->nColumns == 0) {
+	Tcl_SetObjResult(interp, literals[LIT_0]);
+	return TCL_OK;
+    }
+
+    if (rdata->reuse) {
+	prevRow = Tcl_ObjGetVar2(interp, objv[2], NULL, 0);
+    }
+    n = FillRow(rdata, row, lists, literals);
+    if (prevRow != NULL
+	&& UpdateRowInPlace(pidata, prevRow, lists, n, rdata->plan->cells)) {
+	resultRow = prevRow;
+    } else {
+	resultRow = Tcl_NewListObj(n, rdata->plan->cells);
+    }
+    Tcl_IncrRefCount(resultRow);
+
+    /* Advance to the next row */
+    rdata->rowCount += 1;
+
+    /* Save the row in the given variable */
+
+    if (Tcl_ObjSetVar2(interp, objv[2], NULL,
+		       resultRow, TCL_LEAVE_ERR_MSG) == NULL) {
+	goto cleanup;
+    }
+
+    Tcl_SetObjResult(interp, literals[LIT_1]);
+    status = TCL_OK;
+
+cleanup:
+    Tcl_DecrRefCount(resultRow);
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DecodeRow, FillRow --
+ *
+ *	Convert one row of a result to a Tcl list or dictionary, by
+ *	following the result set's decoding plan.
+ *
+ * Results:
+ *	DecodeRow returns a Tcl object with a zero reference count.
+ *	FillRow leaves the elements of the row in the plan's 'cells' array,
+ *	and returns their number.
+ *
+ * A dictionary row is built as a list of alternating column names and
+ * values, which Tcl converts to a dictionary the first time the row is
+ * used as one. NULL columns are omitted from dictionaries, and are empty
+ * elements of lists.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj*
+DecodeRow(
+    ResultSetData* rdata,	/* Result set */
+    int row,			/* Row number within rdata->execResult */
+    int lists,			/* Flag == 1 to make a list, 0 for a
+				 * dictionary */
+    Tcl_Obj** literals		/* Literal pool */
+) {
+    int n = FillRow(rdata, row, lists, literals);
+
+    return Tcl_NewListObj(n, rdata->plan->cells);
+}
+
+static int
+FillRow(
+    ResultSetData* rdata,	/* Result set */
+    int row,			/* Row number within rdata->execResult */
+    int lists,			/* Flag == 1 to make a list, 0 for a
+				 * dictionary */
+    Tcl_Obj** literals		/* Literal pool */
+) {
+    DecodePlan* plan = rdata->plan;
+    PGresult* res = rdata->execResult;
+    Tcl_Obj** cells = plan->cells;
+    int n = 0;			/* Number of elements in cells */
+    int i;
+
+    for (i = 0; i < plan->nColumns; ++i) {
+	if (PQgetisnull(res, row, i)) {
+	    if (lists) {
+		cells[n++] = literals[LIT_EMPTY];
+	    }
+	    continue;
+	}
+	if (!lists) {
+	    cells[n++] = plan->columnNames[i];
+	}
+	cells[n++] = DecodeCell(rdata, row, i);
+    }
+    return n;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DecodeCell --
+ *
+ *	Converts the value of one non-NULL cell of a result.
+ *
+ * Results:
+ *	Returns a Tcl object with a zero reference count, or a shared
+ *	value if the column is interned.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj*
+DecodeCell(
+    ResultSetData* rdata,	/* Result set */
+    int row,			/* Row number within rdata->execResult */
+    int column			/* Column number */
+) {
+    DecodePlan* plan = rdata->plan;
+    PGresult* res = rdata->execResult;
+
+    if (rdata->internCounts != NULL && rdata->internCounts[column] >= 0) {
+	return InternCell(rdata, column, PQgetvalue(res, row, column),
+			  PQgetlength(res, row, column));
+    } else if (plan->decoders[column] == DecodeText
+	       && PQgetlength(res, row, column) > 0) {
+	return NewLazyCell(rdata, PQgetvalue(res, row, column));
+    } else {
+	return plan->decoders[column](PQgetvalue(res, row, column),
+				      PQgetlength(res, row, column));
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * UpdateRowInPlace --
+ *
+ *	Overwrites the row that a previous call of 'nextlist' or 'nextdict'
+ *	left in a variable with the elements of the next row.
+ *
+ * Results:
+ *	Returns 1 if the row was updated, and 0 if it cannot be because it
+ *	is shared, is not a list or dictionary, or (for a dictionary) does
+ *	not have the same keys as the next row.
+ *
+ * Side effects:
+ *	Replaces the elements of 'rowObj'. An unshared row has no other
+ *	reference than the variable, so this cannot be told from storing a
+ *	fresh row, but it reuses the container's memory.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+UpdateRowInPlace(
+    PerInterpData* pidata,	/* Per-interpreter data */
+    Tcl_Obj* rowObj,		/* Row to update */
+    int lists,			/* Flag == 1 for a list, 0 for a
+				 * dictionary */
+    int n,			/* Number of elements of the next row */
+    Tcl_Obj** cells		/* Elements of the next row */
+) {
+    Tcl_Obj* value;		/* Value in the dictionary */
+    int size;			/* Size of the row */
+    int i;
+
+    if (Tcl_IsShared(rowObj)) {
+	return 0;
+    }
+    if (rowObj->typePtr == pidata->listType) {
+	Tcl_ListObjLength(NULL, rowObj, &size);
+	Tcl_ListObjReplace(NULL, rowObj, 0, size, n, cells);
+	return 1;
+    }
+
+    /*
+     * A dictionary is updated only if it has exactly the keys of the
+     * next row, so that the order of the keys is the same as in a fresh
+     * row.
+     */
+
+    if (lists || rowObj->typePtr != pidata->dictType) {
+	return 0;
+    }
+    Tcl_DictObjSize(NULL, rowObj, &size);
+    if (2 * size != n) {
+	return 0;
+    }
+    for (i = 0; i < n; i += 2) {
+	if (Tcl_DictObjGet(NULL, rowObj, cells[i], &value) != TCL_OK
+	    || value == NULL) {
+	    return 0;
+	}
+    }
+    for (i = 0; i < n; i += 2) {
+	Tcl_DictObjPut(NULL, rowObj, cells[i], cells[i+1]);
+    }
+    return 1;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * NewLazyCell --
+ *
+ *	Makes a value whose string representation is copied from the
+ *	current result of a result set only when it is needed.
+ *
+ * Results:
+ *	Returns the value, with a zero reference count.
+ *
+ * Side effects:
+ *	Shares rdata->execResult with the value, so that the PGresult
+ *	outlives the batch of rows if the value is not yet converted.
+ *
+ * Rows are usually scanned for a few of their columns; the values of the
+ * other columns then cost only a Tcl_Obj apiece.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj*
+NewLazyCell(
+    ResultSetData* rdata,	/* Result set */
+    const char* value		/* NUL-terminated text in execResult */
+) {
+    Tcl_Obj* obj = Tcl_NewObj();
+    Tcl_ObjInternalRep ir;
+
+    if (rdata->buffer == NULL) {
+	rdata->buffer = (ResultBuffer*) ckalloc(sizeof(ResultBuffer));
+	rdata->buffer->refCount = 1;
+	rdata->buffer->result = rdata->execResult;
+    }
+    IncrResultBufferRefCount(rdata->buffer);
+    Tcl_InvalidateStringRep(obj);
+    ir.twoPtrValue.ptr1 = rdata->buffer;
+    ir.twoPtrValue.ptr2 = (void*) value;
+    Tcl_StoreInternalRep(obj, &lazyCellType, &ir);
+    return obj;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * SetupInterning --
+ *
+ *	Decides which columns of a result set have their values interned.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Columns of enum types are interned always, and the other text
+ *	columns if 'intern' is true. If any are, creates the table of
+ *	shared values for the result set.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+SetupInterning(
+    ResultSetData* rdata,	/* Result set */
+    int intern			/* Flag == 1 to intern all text columns */
+) {
+    DecodePlan* plan = rdata->plan;
+    int any = 0;		/* Flag == 1 if any column is interned */
+    int i;
+
+    rdata->internCounts = (int*) ckalloc((plan->nColumns + 1) * sizeof(int));
+    for (i = 0; i < plan->nColumns; ++i) {
+	if (plan->decoders[i] == DecodeText && (intern || plan->enums[i])) {
+	    rdata->internCounts[i] = 0;
+	    any = 1;
+	} else {
+	    rdata->internCounts[i] = -1;
+	}
+    }
+    if (!any) {
+	ckfree(rdata->internCounts);
+	rdata->internCounts = NULL;
+	return;
+    }
+    rdata->internTable = (Tcl_HashTable*) ckalloc(sizeof(Tcl_HashTable));
+    Tcl_InitHashTable(rdata->internTable, TCL_STRING_KEYS);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * InternCell --
+ *
+ *	Makes the value of a cell of an interned column.
+ *
+ * Results:
+ *	Returns the value, shared with the other cells of the result set
+ *	that have the same text.
+ *
+ * Side effects:
+ *	Adds a value not seen before to rdata->internTable. A column that
+ *	adds more than INTERN_MAX_VALUES distinct values stops being
+ *	interned.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj*
+InternCell(
+    ResultSetData* rdata,	/* Result set */
+    int column,			/* Column number */
+    const char* value,		/* NUL-terminated text of the value */
+    int length			/* Length of the value */
+) {
+    Tcl_HashEntry* entry;
+    Tcl_Obj* obj;
+    int isNew;
+
+    entry = Tcl_CreateHashEntry(rdata->internTable, value, &isNew);
+    if (!isNew) {
+	return (Tcl_Obj*) Tcl_GetHashValue(entry);
+    }
+    if (++rdata->internCounts[column] > INTERN_MAX_VALUES) {
+	Tcl_DeleteHashEntry(entry);
+	rdata->internCounts[column] = -1;
+	return Tcl_NewStringObj(value, length);
+    }
+    obj = Tcl_NewStringObj(value, length);
+    Tcl_IncrRefCount(obj);
+    Tcl_SetHashValue(entry, obj);
+    return obj;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ReleaseExecResult --
+ *
+ *	Lets go of the current result of a result set.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Clears rdata->execResult, unless lazy cells still refer to it.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+ReleaseExecResult(
+    ResultSetData* rdata	/* Result set */
+) {
+    if (rdata->buffer != NULL) {
+	DecrResultBufferRefCount(rdata->buffer);
+	rdata->buffer = NULL;
+    } else if (rdata->execResult != NULL) {
+	PQclear(rdata->execResult);
+    }
+    rdata->execResult = NULL;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * FreeLazyCell --
+ *
+ *	Frees a pgLazyCell ObjType intrep
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+FreeLazyCell(
+    Tcl_Obj* obj
+) {
+    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &lazyCellType);
+
+    if (ir->twoPtrValue.ptr1 != NULL) {
+	DecrResultBufferRefCount((ResultBuffer*) ir->twoPtrValue.ptr1);
+    }
+    ir->twoPtrValue.ptr1 = NULL;
+    ir->twoPtrValue.ptr2 = NULL;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DupLazyCell --
+ *
+ *	Duplicates a pgLazyCell ObjType intrep
+ *
+ * Results:
+ *	None
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DupLazyCell(
+    Tcl_Obj* src,
+    Tcl_Obj* dup
+) {
+    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(src, &lazyCellType);
+
+    if (ir->twoPtrValue.ptr1 != NULL) {
+	IncrResultBufferRefCount((ResultBuffer*) ir->twoPtrValue.ptr1);
+    }
+    Tcl_StoreInternalRep(dup, &lazyCellType, ir);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * UpdateStringOfLazyCell --
+ *
+ *	Copies the text of a pgLazyCell out of its PGresult.
+ *
+ * Results:
+ *	None
+ *
+ * Side effects:
+ *	Releases the cell's reference to the PGresult, which is no longer
+ *	needed once the string representation exists.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+UpdateStringOfLazyCell(
+    Tcl_Obj* obj
+) {
+    Tcl_ObjInternalRep* ir = Tcl_FetchInternalRep(obj, &lazyCellType);
+    const char* value = ir->twoPtrValue.ptr2;
+
+    Tcl_InitStringRep(obj, value, strlen(value));
+    DecrResultBufferRefCount((ResultBuffer*) ir->twoPtrValue.ptr1);
+    ir->twoPtrValue.ptr1 = NULL;
+    ir->twoPtrValue.ptr2 = NULL;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ParseRowOptions --
+ *
+ *	Parses the options of the bulk row methods.
+ *
+ * Results:
+ *	Returns the index in objv of the first argument after the options,
+ *	or -1 if the options are in error. The last 'nArgs' words are never
+ *	taken as options, so that a negative count is not mistaken for one.
+ *
+ * Side effects:
+ *	Stores 1 in '*listsPtr' if rows are wanted as lists, and 0 for
+ *	dictionaries. If 'columnsVarPtr' is not NULL, the -columnsvariable
+ *	option is accepted and its value is stored there. Leaves an error
+ *	message in the interpreter on failure.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ParseRowOptions(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    int objc,			/* Parameter count */
+    Tcl_Obj *const objv[],	/* Parameter vector */
+    int nArgs,			/* Number of arguments following the
+				 * options */
+    int* listsPtr,		/* OUTPUT: Flag == 1 for lists */
+    Tcl_Obj** columnsVarPtr	/* OUTPUT: Variable to receive the column
+				 * names, or NULL if the option is not
+				 * allowed */
+) {
+    int i;
+    int optionIndex;
+    int form;
+
+    *listsPtr = 0;
+    for (i = 2; i < objc - nArgs; i += 2) {
+	if (Tcl_GetString(objv[i])[0] != '-') {
+	    break;
+	}
+	if (Tcl_GetIndexFromObj(interp, objv[i], RowOptions, "option",
+				0, &optionIndex) != TCL_OK) {
+	    return -1;
+	}
+	if (optionIndex == ROWOPT_END) {
+	    return i+1;
+	}
+	if (optionIndex == ROWOPT_COLUMNSVARIABLE && columnsVarPtr == NULL) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"bad option \"%s\": must be -as or --",
+		Tcl_GetString(objv[i])));
+	    Tcl_SetErrorCode(interp, "TCL", "LOOKUP", "INDEX", "option",
+			     Tcl_GetString(objv[i]), NULL);
+	    return -1;
+	}
+	if (i+1 >= objc - nArgs) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"missing value for option \"%s\"", Tcl_GetString(objv[i])));
+	    Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			     "POSTGRES", "-1", NULL);
+	    return -1;
+	}
+	switch (optionIndex) {
+	case ROWOPT_AS:
+	    if (Tcl_GetIndexFromObj(interp, objv[i+1], RowForms,
+				    "variable type", TCL_EXACT,
+				    &form) != TCL_OK) {
+		return -1;
+	    }
+	    *listsPtr = form;
+	    break;
+	case ROWOPT_COLUMNSVARIABLE:
+	    *columnsVarPtr = objv[i+1];
+	    break;
+	}
+    }
+    return i;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CollectRows --
+ *
+ *	Converts a block of rows from a result set into a Tcl list.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Stores in '*rowsPtr' a list, with a zero reference count, of up to
+ *	'maxRows' rows (all the remaining rows if 'maxRows' is negative),
+ *	and advances the result set past them. Streaming result sets and
+ *	cursors read further batches from the server as needed.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CollectRows(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    int lists,			/* Flag == 1 for lists, 0 for dicts */
+    int maxRows,		/* Maximum number of rows, or -1 */
+    Tcl_Obj** literals,		/* Literal pool */
+    Tcl_Obj** rowsPtr		/* OUTPUT: List of rows */
+) {
+    Tcl_Obj** rows = NULL;	/* Rows collected so far */
+    int nRows = 0;		/* Number of rows collected */
+    int capacity = 0;		/* Room in 'rows' */
+    int row;			/* Row number within rdata->execResult */
+    int avail;			/* Rows to take from the current batch */
+    int status = TCL_OK;
+    int i;
+
+    if (rdata->plan->nColumns == 0) {
+	*rowsPtr = Tcl_NewObj();
+	return TCL_OK;
+    }
+
+    while (maxRows < 0 || nRows < maxRows) {
+	if (ResultSetCurrentRow(interp, rdata, &row) != TCL_OK) {
+	    status = TCL_ERROR;
+	    break;
+	}
+	if (row < 0) {
+	    break;
+	}
+	avail = PQntuples(rdata->execResult) - row;
+	if (maxRows >= 0 && avail > maxRows - nRows) {
+	    avail = maxRows - nRows;
+	}
+	if (nRows + avail > capacity) {
+	    capacity = 2 * capacity;
+	    if (capacity < nRows + avail) {
+		capacity = nRows + avail;
+	    }
+	    rows = (Tcl_Obj**) ckrealloc((char*) rows,
+					 capacity * sizeof(Tcl_Obj*));
+	}
+	for (i = 0; i < avail; ++i) {
+	    rows[nRows++] = DecodeRow(rdata, row + i, lists, literals);
+	}
+	rdata->rowCount += avail;
+    }
+
+    *rowsPtr = Tcl_NewListObj(nRows, rows);
+    if (rows != NULL) {
+	ckfree(rows);
+    }
+    if (status != TCL_OK) {
+	Tcl_IncrRefCount(*rowsPtr);
+	Tcl_DecrRefCount(*rowsPtr);
+	*rowsPtr = NULL;
+    }
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetAllcolumnsMethod --
+ *
+ *	Retrieves all the remaining rows of a result set, column by column.
+ *
+ * Usage:
+ *	$resultSet allcolumns
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is a dictionary whose
+ *	keys are the column names and whose values are lists of the values
+ *	in the respective columns. NULLs appear as empty strings.
+ *
+ * Side effects:
+ *	Advances the result set to its end.
+ *
+ * Each batch of rows is walked column-major, so that no row lists are
+ * built only to be taken apart again.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetAllcolumnsMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+    DecodePlan* plan;		/* Plan for decoding the columns */
+    int nColumns;
+    Tcl_Obj*** values;		/* Values collected so far, per column */
+    Tcl_Obj** cells;		/* Values of one column */
+    Tcl_Obj* columns;		/* List of the values of one column */
+    Tcl_Obj* retval;		/* Dictionary of columns */
+    int nRows = 0;		/* Number of rows collected */
+    int capacity = 0;		/* Room in each array of values */
+    int row;			/* Row number within rdata->execResult */
+    int avail;			/* Rows in the current batch */
+    int status = TCL_OK;
+    PGresult* res;
+    int i, j;
+
+    if (objc != 2) {
+	Tcl_WrongNumArgs(interp, 2, objv, "");
+	return TCL_ERROR;
+    }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    plan = rdata->plan;
+    nColumns = plan->nColumns;
+
+    values = (Tcl_Obj***) ckalloc((nColumns + 1) * sizeof(Tcl_Obj**));
+    for (i = 0; i < nColumns; ++i) {
+	values[i] = NULL;
+    }
+
+    while (nColumns > 0) {
+	if (ResultSetCurrentRow(interp, rdata, &row) != TCL_OK) {
+	    status = TCL_ERROR;
+	    break;
+	}
+	if (row < 0) {
+	    break;
+	}
+	res = rdata->execResult;
+	avail = PQntuples(res) - row;
+	if (nRows + avail > capacity) {
+	    capacity = 2 * capacity;
+	    if (capacity < nRows + avail) {
+		capacity = nRows + avail;
+	    }
+	    for (i = 0; i < nColumns; ++i) {
+		values[i] = (Tcl_Obj**)
+		    ckrealloc((char*) values[i], capacity * sizeof(Tcl_Obj*));
+	    }
+	}
+	for (i = 0; i < nColumns; ++i) {
+	    ColumnDecoder* decoder = plan->decoders[i];
+	    cells = values[i] + nRows;
+	    for (j = 0; j < avail; ++j) {
+		if (PQgetisnull(res, row + j, i)
+		    || PQgetlength(res, row + j, i) == 0) {
+		    cells[j] = literals[LIT_EMPTY];
+		} else if (rdata->internCounts != NULL
+			   && rdata->internCounts[i] >= 0) {
+		    cells[j] = InternCell(rdata, i, PQgetvalue(res, row + j, i),
+					  PQgetlength(res, row + j, i));
+		} else {
+		    cells[j] = decoder(PQgetvalue(res, row + j, i),
+				       PQgetlength(res, row + j, i));
+		}
+	    }
+	}
+	nRows += avail;
+	rdata->rowCount += avail;
+    }
+
+    retval = Tcl_NewObj();
+    Tcl_IncrRefCount(retval);
+    for (i = 0; i < nColumns; ++i) {
+	columns = Tcl_NewListObj(nRows, values[i]);
+	Tcl_DictObjPut(NULL, retval, plan->columnNames[i], columns);
+	if (values[i] != NULL) {
+	    ckfree(values[i]);
+	}
+    }
+    ckfree(values);
+    if (status == TCL_OK) {
+	Tcl_SetObjResult(interp, retval);
+    }
+    Tcl_DecrRefCount(retval);
+    return status;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetAllrowsMethod --
+ *
+ *	Retrieves all the remaining rows of a result set.
+ *
+ * Usage:
+ *	$resultSet allrows ?-as lists|dicts? ?-columnsvariable varName? ?--?
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is a list of the rows.
+ *
+ * Side effects:
+ *	Stores the list of column names in the given variable if
+ *	-columnsvariable is given.
+ *
+ * This overrides the method of tdbc::resultset, which loops over the
+ * 'nextdict' or 'nextlist' method; here the rows become a single list in
+ * one call.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetAllrowsMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+    Tcl_Obj* columnsVar = NULL;	/* Variable to receive the column names */
+    Tcl_Obj* rows;		/* List of rows */
+    int lists;			/* Flag == 1 for lists, 0 for dicts */
+    int i;
+
+    i = ParseRowOptions(interp, objc, objv, 0, &lists, &columnsVar);
+    if (i < 0) {
+	return TCL_ERROR;
+    }
+    if (i != objc) {
+	Tcl_WrongNumArgs(interp, 2, objv, "?-option value?... ?--?");
+	return TCL_ERROR;
+    }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (columnsVar != NULL
+	&& Tcl_ObjSetVar2(interp, columnsVar, NULL, rdata->sdata->columnNames,
+			  TCL_LEAVE_ERR_MSG) == NULL) {
+	return TCL_ERROR;
+    }
+    if (CollectRows(interp, rdata, lists, -1, literals, &rows) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, rows);
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetNextrowsMethod --
+ *
+ *	Retrieves a block of rows from a result set.
+ *
+ * Usage:
+ *	$resultSet nextrows ?-as lists|dicts? ?--? count varName
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is the number of rows
+ *	retrieved. 0 means that the result set is exhausted.
+ *
+ * Side effects:
+ *	Stores a list of up to 'count' rows in the given variable.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetNextrowsMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+    Tcl_Obj* rows;		/* List of rows */
+    int lists;			/* Flag == 1 for lists, 0 for dicts */
+    int count;			/* Maximum number of rows to retrieve */
+    int nRows;			/* Number of rows retrieved */
+    int i;
+
+    i = ParseRowOptions(interp, objc, objv, 2, &lists, NULL);
+    if (i < 0) {
+	return TCL_ERROR;
+    }
+    if (i != objc-2) {
+	Tcl_WrongNumArgs(interp, 2, objv,
+			 "?-as lists|dicts? ?--? count varName");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetIntFromObj(interp, objv[i], &count) != TCL_OK
+	|| AwaitPipelinedResult(interp, rdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (count < 0) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "row count must be a non-negative integer", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+    if (CollectRows(interp, rdata, lists, count, literals, &rows) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    Tcl_ListObjLength(NULL, rows, &nRows);
+    if (Tcl_ObjSetVar2(interp, objv[i+1], NULL, rows,
+		       TCL_LEAVE_ERR_MSG) == NULL) {
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Tcl_NewWideIntObj(nRows));
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * BindRowVars --
+ *
+ *	Works out which variables the 'nextvars' method assigns the columns
+ *	of a result set to.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Fills in rdata->varNames, unless it was already made for the same
+ *	arguments. Scripts call 'nextvars' in a loop with the same literal
+ *	arguments, so the names are worked out once per result set rather
+ *	than once per row.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+BindRowVars(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    int objc,			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    DecodePlan* plan = rdata->plan;
+    Tcl_Obj** spec;		/* Arguments of the last binding */
+    int nSpec;			/* Number of arguments of the last binding */
+    Tcl_Obj* prefix = NULL;	/* Prefix of the variable names */
+    Tcl_Obj* name;		/* Name of a variable */
+    int first = 2;		/* Index of the first column variable */
+    int i;
+
+    /* Reuse the names if the arguments are the same as last time */
+
+    if (rdata->varsSpec != NULL) {
+	Tcl_ListObjGetElements(NULL, rdata->varsSpec, &nSpec, &spec);
+	if (nSpec == objc - 2) {
+	    for (i = 0; i < nSpec; ++i) {
+		if (spec[i] != objv[i+2]
+		    && strcmp(Tcl_GetString(spec[i]),
+			      Tcl_GetString(objv[i+2])) != 0) {
+		    break;
+		}
+	    }
+	    if (i == nSpec) {
+		return TCL_OK;
+	    }
+	}
+    }
+
+    if (objc >= 4 && strcmp(Tcl_GetString(objv[2]), "-prefix") == 0) {
+	prefix = objv[3];
+	first = 4;
+    }
+    if (objc - first > plan->nColumns) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "%d variable names given, but the result set has only "
+	    "%d columns", objc - first, plan->nColumns));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+
+    /* Discard the last binding */
+
+    if (rdata->varsSpec != NULL) {
+	for (i = 0; i < plan->nColumns; ++i) {
+	    if (rdata->varNames[i] != NULL) {
+		Tcl_DecrRefCount(rdata->varNames[i]);
+	    }
+	}
+	Tcl_DecrRefCount(rdata->varsSpec);
+    } else {
+	rdata->varNames = (Tcl_Obj**)
+	    ckalloc((plan->nColumns + 1) * sizeof(Tcl_Obj*));
+    }
+    rdata->varsSpec = Tcl_NewListObj(objc - 2, objv + 2);
+    Tcl_IncrRefCount(rdata->varsSpec);
+
+    /*
+     * Column variables are given positionally, and an empty name skips a
+     * column. Without them, each column goes to the variable of its name.
+     */
+
+    for (i = 0; i < plan->nColumns; ++i) {
+	if (first == objc) {
+	    name = plan->columnNames[i];
+	} else if (first + i < objc
+		   && Tcl_GetCharLength(objv[first + i]) > 0) {
+	    name = objv[first + i];
+	} else {
+	    rdata->varNames[i] = NULL;
+	    continue;
+	}
+	if (prefix != NULL) {
+	    name = Tcl_DuplicateObj(prefix);
+	    Tcl_AppendObjToObj(name, (first == objc) ? plan->columnNames[i]
+			       : objv[first + i]);
+	}
+	Tcl_IncrRefCount(name);
+	rdata->varNames[i] = name;
+    }
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetNextvarsMethod --
+ *
+ *	Assigns the columns of the next row of a result set to variables.
+ *
+ * Usage:
+ *	$resultSet nextvars ?-prefix prefix? ?varName...?
+ *
+ * Parameters:
+ *	prefix - String prepended to the names of the variables
+ *	varName - Names of the variables that receive the columns, in
+ *		  order. An empty name skips a column. If no names are given,
+ *		  each column is assigned to the variable named after it.
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is 1 if a row was
+ *	assigned, and 0 if the result set is exhausted.
+ *
+ * Side effects:
+ *	Sets the variables in the caller's scope. The variables of NULL
+ *	columns are unset.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetNextvarsMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+    int row;			/* Row number within rdata->execResult */
+    int i;
+
+    if (objc == 3 && strcmp(Tcl_GetString(objv[2]), "-prefix") == 0) {
+	Tcl_WrongNumArgs(interp, 2, objv, "?-prefix prefix? ?varName...?");
+	return TCL_ERROR;
+    }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK
+	|| BindRowVars(interp, rdata, objc, objv) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (ResultSetCurrentRow(interp, rdata, &row) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (row < 0 || rdata->plan->nColumns == 0) {
+	Tcl_SetObjResult(interp, literals[LIT_0]);
+	return TCL_OK;
+    }
+
+    for (i = 0; i < rdata->plan->nColumns; ++i) {
+	if (rdata->varNames[i] == NULL) {
+	    continue;
+	}
+	if (PQgetisnull(rdata->execResult, row, i)) {
+	    Tcl_UnsetVar2(interp, Tcl_GetString(rdata->varNames[i]), NULL, 0);
+	} else if (Tcl_ObjSetVar2(interp, rdata->varNames[i], NULL,
+				  DecodeCell(rdata, row, i),
+				  TCL_LEAVE_ERR_MSG) == NULL) {
+	    return TCL_ERROR;
+	}
+    }
+    rdata->rowCount += 1;
+
+    Tcl_SetObjResult(interp, literals[LIT_1]);
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CheckRandomAccess --
+ *
+ *	Checks that the rows of a result set are all in memory, so that
+ *	they can be visited in any order.
+ *
+ * Results:
+ *	Returns TCL_OK if the result set is materialized. Otherwise, leaves
+ *	an error in the interpreter and returns TCL_ERROR.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CheckRandomAccess(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata	/* Result set */
+) {
+    if (rdata->flags
+	& (RS_FLAG_STREAMING | RS_FLAG_CURSOR | RS_FLAG_BATCHED)) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "random access requires a materialized result set", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY106",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * GetRowNumberFromObj --
+ *
+ *	Gets a row number of a materialized result set from a Tcl object.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Stores the row number in '*rowPtr' if it is between 0 and
+ *	'maxRow'. Otherwise, leaves an error in the interpreter.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+GetRowNumberFromObj(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    Tcl_Obj* obj,		/* Row number */
+    int maxRow,			/* Greatest acceptable row number */
+    int* rowPtr			/* OUTPUT: Row number */
+) {
+    if (Tcl_GetIntFromObj(interp, obj, rowPtr) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (*rowPtr < 0 || *rowPtr > maxRow) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "row number %d is out of range: the result set has %d rows",
+	    *rowPtr, ResultSetRowTotal(rdata)));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY107",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultMemorySize --
+ *
+ *	Determines how much memory a result from the server occupies.
+ *
+ * Results:
+ *	Returns the size in bytes, or 0 if there is no result.
+ *
+ * PQresultMemorySize is new in PostgreSQL 12. Older client libraries
+ * cannot tell, and the size is taken to be that of the values, which
+ * falls somewhat short of the memory that the result occupies.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t
+ResultMemorySize(
+    const PGresult* res		/* Result, or NULL */
+) {
+    size_t bytes = 0;		/* Bytes in the values */
+    int nRows, nColumns;	/* Size of the result */
+    int i, j;
+
+    if (res == NULL) {
+	return 0;
+    }
+    if (PQresultMemorySize != NULL) {
+	return PQresultMemorySize(res);
+    }
+    nRows = PQntuples(res);
+    nColumns = PQnfields(res);
+    for (i = 0; i < nRows; ++i) {
+	for (j = 0; j < nColumns; ++j) {
+	    bytes += PQgetlength(res, i, j);
+	}
+    }
+    return bytes;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CheckResultLimit --
+ *
+ *	Checks the memory held by a result set against the connection's
+ *	-maxresultbytes limit.
+ *
+ * Results:
+ *	Returns TCL_OK if the result set is within the limit. Otherwise,
+ *	leaves an error in the interpreter and returns TCL_ERROR.
+ *
+ * Side effects:
+ *	A result set over the limit is ended: a query that is still
+ *	running is cancelled, a cursor is closed, and the rows at hand are
+ *	released, so that the result set appears exhausted.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+CheckResultLimit(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    Tcl_WideInt size		/* Bytes of memory that the result set
+				 * holds */
+) {
+    ConnectionData* cdata = rdata->sdata->cdata;
+				/* Connection data */
+
+    if (cdata->maxResultBytes == 0 || size <= cdata->maxResultBytes) {
+	return TCL_OK;
+    }
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	"result set needs more than %" TCL_LL_MODIFIER "d bytes of memory, "
+	"the limit set by -maxresultbytes", cdata->maxResultBytes));
+    Tcl_SetErrorCode(interp, "TDBC", "PROGRAM_LIMIT_EXCEEDED", "54000",
+		     "POSTGRES", "-1", NULL);
+
+    if (rdata->flags & RS_FLAG_STREAMING) {
+	CancelQuery(cdata);
+	FinishStream(rdata);
+    }
+    if (rdata->flags & RS_FLAG_CURSOR) {
+	rdata->flags &= ~RS_FLAG_CURSOR;
+	CloseCursor(cdata, rdata->cursorName, rdata->cursorXact);
+	ckfree(rdata->cursorName);
+	rdata->cursorName = NULL;
+    }
+    ReleaseExecResult(rdata);
+    rdata->batchStart = rdata->rowCount;
+    rdata->flags |= RS_FLAG_BATCHED;
+    return TCL_ERROR;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * CancelQuery --
+ *
+ *	Asks the server to stop executing the statement that is running on
+ *	a connection.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The statement, if it is still running, ends with an error, which
+ *	aborts the current transaction. The request is made on its own
+ *	connection to the server; if it fails, the rest of the results
+ *	simply arrive and are discarded.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+CancelQuery(
+    ConnectionData* cdata	/* Connection data */
+) {
+    PGcancel* cancel;		/* Cancellation request */
+    char errbuf[256];		/* Message of a failed request */
+
+    cancel = PQgetCancel(cdata->pgPtr);
+    if (cancel != NULL) {
+	PQcancel(cancel, errbuf, sizeof(errbuf));
+	PQfreeCancel(cancel);
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * DiscardRows --
+ *
+ *	Discards the rows of a result set that have not yet been read,
+ *	without decoding them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A streaming query is cancelled if -cancelonclose allowed it, and
+ *	its remaining results are dropped; otherwise they are read and
+ *	thrown away. A cursor is closed. The result set is left at its end, but a
+ *	materialized result is kept, so that it can be revisited with the
+ *	random access methods.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static void
+DiscardRows(
+    ResultSetData* rdata	/* Result set */
+) {
+    ConnectionData* cdata = rdata->sdata->cdata;
+				/* Connection data */
+    int batched = 0;		/* Flag == 1 if the rows at hand are to
+				 * be released */
+    int end;			/* Number of the row past the rows at hand */
+
+    if (rdata->flags & RS_FLAG_STREAMING) {
+	if (rdata->flags & RS_FLAG_CANCELLABLE) {
+	    CancelQuery(cdata);
+	}
+	FinishStream(rdata);
+	batched = 1;
+    }
+    if (rdata->flags & RS_FLAG_CURSOR) {
+	rdata->flags &= ~RS_FLAG_CURSOR;
+	CloseCursor(cdata, rdata->cursorName, rdata->cursorXact);
+	ckfree(rdata->cursorName);
+	rdata->cursorName = NULL;
+	batched = 1;
+    }
+
+    if (batched) {
+	ReleaseExecResult(rdata);
+	rdata->batchStart = rdata->rowCount;
+	rdata->flags |= RS_FLAG_BATCHED;
+    } else if (rdata->spool != NULL) {
+	rdata->rowCount = rdata->spool->nRows;
+    } else {
+	end = rdata->batchStart + PQntuples(rdata->execResult);
+	if (rdata->rowCount < end) {
+	    rdata->rowCount = end;
+	}
+    }
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetNextresultsMethod --
+ *
+ *	Advances a Postgres result set to its next set of results.
+ *
+ * Usage:
+ *	$resultSet nextresults
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is 0, because a
+ *	Postgres statement returns only one set of results.
+ *
+ * Side effects:
+ *	Discards the rows that remain in the result set.
+ *
+ * This overrides the method of tdbc::resultset, which would read the
+ * remaining rows with 'nextdict' only to throw them away.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetNextresultsMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+
+    if (objc != 2) {
+	Tcl_WrongNumArgs(interp, 2, objv, "");
+	return TCL_ERROR;
+    }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    DiscardRows(rdata);
+    Tcl_SetObjResult(interp, literals[LIT_0]);
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetRowTotal --
+ *
+ *	Counts the rows of a materialized result set.
+ *
+ * Results:
+ *	Returns the number of rows.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetRowTotal(
+    ResultSetData* rdata	/* Result set */
+) {
+    if (rdata->spool != NULL) {
+	return rdata->spool->nRows;
+    }
+    return PQntuples(rdata->execResult);
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * LocateRow --
+ *
+ *	Finds a row of a materialized result set in rdata->execResult.
+ *
+ * Results:
+ *	Returns a standard Tcl result.
+ *
+ * Side effects:
+ *	Stores in '*rowPtr' the number of the row within rdata->execResult,
+ *	first loading the batch that holds it if the result set is spooled.
+ *
+ *-----------------------------------------------------------------------------
+ */
 
-    /* Clean up allocated memory */
+static int
+LocateRow(
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    ResultSetData* rdata,	/* Result set */
+    int absRow,			/* Number of the row in the result set */
+    int* rowPtr			/* OUTPUT: Row number within execResult */
+) {
+    int row = absRow - rdata->batchStart;
 
- freeParamTables:
-    for (i = 0; i < sdata->nParams; ++i) {
-	if (paramNeedsFreeing[i]) {
-	    ckfree(paramValues[i]);
-	}
-	if (paramTempObjs[i] != NULL) {
-	    Tcl_DecrRefCount(paramTempObjs[i]);
+    if (rdata->spool != NULL
+	&& (row < 0 || row >= PQntuples(rdata->execResult))) {
+	if (LoadSpoolBatch(interp, rdata,
+			   absRow / SPOOL_BATCH_ROWS) != TCL_OK) {
+	    return TCL_ERROR;
 	}
+	row = absRow - rdata->batchStart;
     }
-
-    ckfree(paramValues);
-    ckfree(paramLengths);
-    ckfree(paramFormats);
-    ckfree(paramNeedsFreeing);
-    ckfree(paramTempObjs);
-
-    return status;
-
+    *rowPtr = row;
+    return TCL_OK;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * ResultSetColumnsMethod --
+ * ResultSetSeekMethod --
  *
- *	Retrieves the list of columns from a result set.
+ *	Positions a materialized result set at a given row.
  *
  * Usage:
- *	$resultSet columns
+ *	$resultSet seek rowNumber
  *
  * Results:
- *	Returns the count of columns
+ *	Returns a standard Tcl result, whose value is empty.
+ *
+ * Side effects:
+ *	The row becomes the next one returned by 'nextdict', 'nextlist'
+ *	and the other sequential methods. A row number equal to the number
+ *	of rows positions the result set at its end.
  *
  *-----------------------------------------------------------------------------
  */
 
 static int
-ResultSetColumnsMethod(
+ResultSetSeekMethod(
     ClientData clientData,	/* Not used */
     Tcl_Interp* interp,		/* Tcl interpreter */
     Tcl_ObjectContext context,	/* Object context  */
@@ -4208,153 +11871,197 @@ ResultSetColumnsMethod(
 				/* The current result set object */
     ResultSetData* rdata = (ResultSetData*)
 	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
-    StatementData* sdata = (StatementData*) rdata->sdata;
+				/* Data pertaining to the current result set */
+    int row;			/* Row to seek to */
 
-    if (objc != 2) {
-	Tcl_WrongNumArgs(interp, 2, objv, "?pattern?");
+    if (objc != 3) {
+	Tcl_WrongNumArgs(interp, 2, objv, "rowNumber");
 	return TCL_ERROR;
     }
-
-    Tcl_SetObjResult(interp, (sdata->columnNames));
-
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK
+	|| CheckRandomAccess(interp, rdata) != TCL_OK
+	|| GetRowNumberFromObj(interp, rdata, objv[2],
+			       ResultSetRowTotal(rdata), &row) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    rdata->rowCount = row;
     return TCL_OK;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
- * ResultSetNextrowMethod --
+ * ResultSetRowatMethod --
  *
- *	Retrieves the next row from a result set.
+ *	Retrieves a given row of a materialized result set.
  *
  * Usage:
- *	$resultSet nextrow ?-as lists|dicts? ?--? variableName
- *
- * Options:
- *	-as	Selects the desired form for returning the results.
- *
- * Parameters:
- *	variableName -- Variable in which the results are to be returned
+ *	$resultSet rowat rowNumber ?-as lists|dicts?
  *
  * Results:
- *	Returns a standard Tcl result.  The interpreter result is 1 if there
- *	are more rows remaining, and 0 if no more rows remain.
+ *	Returns a standard Tcl result, whose value is the row.
  *
  * Side effects:
- *	Stores in the given variable either a list or a dictionary
- *	containing one row of the result set.
+ *	None. The position of the result set is unchanged.
  *
  *-----------------------------------------------------------------------------
  */
 
 static int
-ResultSetNextrowMethod(
+ResultSetRowatMethod(
     ClientData clientData,	/* Not used */
     Tcl_Interp* interp,		/* Tcl interpreter */
     Tcl_ObjectContext context,	/* Object context  */
     int objc, 			/* Parameter count */
     Tcl_Obj *const objv[]	/* Parameter vector */
 ) {
-    int lists = PTR2INT(clientData);
-
     Tcl_Object thisObject = Tcl_ObjectContextObject(context);
 				/* The current result set object */
     ResultSetData* rdata = (ResultSetData*)
 	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
 				/* Data pertaining to the current result set */
-    StatementData* sdata = (StatementData*) rdata->sdata;
-				/* Statement that yielded the result set */
-    ConnectionData* cdata = (ConnectionData*) sdata->cdata;
-				/* Connection that opened the statement */
-    PerInterpData* pidata = (PerInterpData*) cdata->pidata;
-				/* Per interpreter data */
-    Tcl_Obj** literals = pidata->literals;
-
-    int nColumns = 0;		/* Number of columns in the result set */
-    Tcl_Obj* colObj;		/* Column obtained from the row */
-    Tcl_Obj* colName;		/* Name of the current column */
-    Tcl_Obj* resultRow;		/* Row of the result set under construction */
-
-    int status = TCL_ERROR;	/* Status return from this command */
-
-    char * buffer;		/* buffer containing field value */
-    int buffSize;		/* size of buffer containing field value */
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+    int lists;			/* Flag == 1 for lists, 0 for dicts */
+    int row;			/* Row to retrieve */
     int i;
 
-    if (objc != 3) {
-	Tcl_WrongNumArgs(interp, 2, objv, "varName");
+    /*
+     * The options follow the row number; shifting the parameter vector
+     * by one lets ParseRowOptions find them at its usual place.
+     */
+
+    if (objc < 3) {
+	goto wrongNumArgs;
+    }
+    i = ParseRowOptions(interp, objc-1, objv+1, 0, &lists, NULL);
+    if (i < 0) {
 	return TCL_ERROR;
     }
-
-    /* Check if row counter haven't already rech the last row */
-    if (rdata->rowCount >= PQntuples(rdata->execResult)) {
-	Tcl_SetObjResult(interp, literals[LIT_0]);
+    if (i != objc-1) {
+	goto wrongNumArgs;
+    }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK
+	|| CheckRandomAccess(interp, rdata) != TCL_OK
+	|| GetRowNumberFromObj(interp, rdata, objv[2],
+			       ResultSetRowTotal(rdata) - 1,
+			       &row) != TCL_OK
+	|| LocateRow(interp, rdata, row, &row) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (rdata->plan->nColumns == 0) {
 	return TCL_OK;
     }
+    Tcl_SetObjResult(interp, DecodeRow(rdata, row, lists, literals));
+    return TCL_OK;
 
-    /* Get the column names in the result set. */
+ wrongNumArgs:
+    Tcl_WrongNumArgs(interp, 2, objv, "rowNumber ?-as lists|dicts?");
+    return TCL_ERROR;
+}
 
-    Tcl_ListObjLength(NULL, sdata->columnNames, &nColumns);
-    if (nColumns == 0) {
-	Tcl_SetObjResult(interp, literals[LIT_0]);
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetSliceMethod --
+ *
+ *	Retrieves a range of rows of a materialized result set.
+ *
+ * Usage:
+ *	$resultSet slice start count ?-as lists|dicts?
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is a list of up to
+ *	'count' rows beginning at row 'start'.
+ *
+ * Side effects:
+ *	None. The position of the result set is unchanged.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetSliceMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+    Tcl_Obj** rows;		/* Rows of the slice */
+    int lists;			/* Flag == 1 for lists, 0 for dicts */
+    int start;			/* First row of the slice */
+    int count;			/* Number of rows in the slice */
+    int nTuples;		/* Number of rows in the result set */
+    int i;
+
+    if (objc < 4) {
+	goto wrongNumArgs;
+    }
+    i = ParseRowOptions(interp, objc-2, objv+2, 0, &lists, NULL);
+    if (i < 0) {
+	return TCL_ERROR;
+    }
+    if (i != objc-2) {
+	goto wrongNumArgs;
+    }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK
+	|| CheckRandomAccess(interp, rdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    nTuples = ResultSetRowTotal(rdata);
+    if (GetRowNumberFromObj(interp, rdata, objv[2], nTuples,
+			    &start) != TCL_OK
+	|| Tcl_GetIntFromObj(interp, objv[3], &count) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (count < 0) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+	    "row count must be a non-negative integer", -1));
+	Tcl_SetErrorCode(interp, "TDBC", "GENERAL_ERROR", "HY000",
+			 "POSTGRES", "-1", NULL);
+	return TCL_ERROR;
+    }
+    if (count > nTuples - start) {
+	count = nTuples - start;
+    }
+    if (count == 0 || rdata->plan->nColumns == 0) {
 	return TCL_OK;
     }
 
-    resultRow = Tcl_NewObj();
-    Tcl_IncrRefCount(resultRow);
-
-    /* Retrieve one column at a time. */
-    for (i = 0; i < nColumns; ++i) {
-	colObj = NULL;
-	if (PQgetisnull(rdata->execResult, rdata->rowCount, i) == 0) {
-	    buffSize = PQgetlength(rdata->execResult, rdata->rowCount, i);
-	    buffer = PQgetvalue(rdata->execResult, rdata->rowCount, i);
-	    if (PQftype(rdata->execResult, i) == BYTEAOID) {
-		/*
-		 * Postgres returns backslash-escape sequences for
-		 * binary data. Substitute them away.
-		 */
-		Tcl_Obj* toSubst;
-		toSubst = Tcl_NewStringObj(buffer, buffSize);
-		Tcl_IncrRefCount(toSubst);
-		colObj = Tcl_SubstObj(interp, toSubst, TCL_SUBST_BACKSLASHES);
-		Tcl_DecrRefCount(toSubst);
-	    } else {
-		colObj = Tcl_NewStringObj((char*)buffer, buffSize);
-	    }
-	}
+    rows = (Tcl_Obj**) ckalloc(count * sizeof(Tcl_Obj*));
+    for (i = 0; i < count; ++i) {
+	int row;		/* Row number within rdata->execResult */
 
-	if (lists) {
-	    if (colObj == NULL) {
-		colObj = Tcl_NewObj();
-	    }
-	    Tcl_ListObjAppendElement(NULL, resultRow, colObj);
-	} else {
-	    if (colObj != NULL) {
-		Tcl_ListObjIndex(NULL, sdata->columnNames, i, &colName);
-		Tcl_DictObjPut(NULL, resultRow, colName, colObj);
+	if (LocateRow(interp, rdata, start + i, &row) != TCL_OK) {
+	    while (i > 0) {
+		Tcl_DecrRefCount(rows[--i]);
 	    }
+	    ckfree(rows);
+	    return TCL_ERROR;
 	}
+	rows[i] = DecodeRow(rdata, row, lists, literals);
+	Tcl_IncrRefCount(rows[i]);
     }
-
-    /* Advance to the next row */
-    rdata->rowCount += 1;
-
-    /* Save the row in the given variable */
-
-    if (Tcl_SetVar2Ex(interp, Tcl_GetString(objv[2]), NULL,
-		      resultRow, TCL_LEAVE_ERR_MSG) == NULL) {
-	goto cleanup;
+    Tcl_SetObjResult(interp, Tcl_NewListObj(count, rows));
+    for (i = 0; i < count; ++i) {
+	Tcl_DecrRefCount(rows[i]);
     }
+    ckfree(rows);
+    return TCL_OK;
 
-    Tcl_SetObjResult(interp, literals[LIT_1]);
-    status = TCL_OK;
-
-cleanup:
-    Tcl_DecrRefCount(resultRow);
-    return status;
+ wrongNumArgs:
+    Tcl_WrongNumArgs(interp, 2, objv, "start count ?-as lists|dicts?");
+    return TCL_ERROR;
 }
-
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -4380,16 +12087,42 @@ DeleteResultSet(
 ) {
     StatementData* sdata = rdata->sdata;
 
+    DiscardRows(rdata);
     if (rdata->stmtName != NULL) {
-	if (rdata->stmtName != sdata->stmtName) {
-	    UnallocateStatement(sdata->cdata->pgPtr, rdata->stmtName);
-	    ckfree(rdata->stmtName);
-	} else {
-	    sdata->flags &= ~ STMT_FLAG_BUSY;
+	ReleaseStatementName(sdata, rdata->stmtName);
+    }
+    ReleaseExecResult(rdata);
+    if (rdata->spool != NULL) {
+	DeleteSpool(rdata->spool);
+    }
+    if (rdata->internTable != NULL) {
+	Tcl_HashSearch search;
+	Tcl_HashEntry* entry;
+
+	for (entry = Tcl_FirstHashEntry(rdata->internTable, &search);
+	     entry != NULL;
+	     entry = Tcl_NextHashEntry(&search)) {
+	    Tcl_DecrRefCount((Tcl_Obj*) Tcl_GetHashValue(entry));
 	}
+	Tcl_DeleteHashTable(rdata->internTable);
+	ckfree(rdata->internTable);
     }
-    if (rdata->execResult != NULL) {
-	PQclear(rdata->execResult);
+    if (rdata->internCounts != NULL) {
+	ckfree(rdata->internCounts);
+    }
+    if (rdata->varsSpec != NULL) {
+	int i;
+
+	for (i = 0; i < rdata->plan->nColumns; ++i) {
+	    if (rdata->varNames[i] != NULL) {
+		Tcl_DecrRefCount(rdata->varNames[i]);
+	    }
+	}
+	ckfree(rdata->varNames);
+	Tcl_DecrRefCount(rdata->varsSpec);
+    }
+    if (rdata->plan != NULL) {
+	DecrDecodePlanRefCount(rdata->plan);
     }
     DecrStatementRefCount(rdata->sdata);
     ckfree(rdata);
@@ -4448,33 +12181,153 @@ ResultSetRowcountMethod(
     int objc, 			/* Parameter count */
     Tcl_Obj *const objv[]	/* Parameter vector */
 ) {
-    char * nTuples;
     Tcl_Object thisObject = Tcl_ObjectContextObject(context);
 				/* The current result set object */
     ResultSetData* rdata = (ResultSetData*)
 	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
 				/* Data pertaining to the current result set */
-    StatementData* sdata = rdata->sdata;
-				/* The current statement */
-    ConnectionData* cdata = sdata->cdata;
-    PerInterpData* pidata = cdata->pidata; /* Per-interp data */
-    Tcl_Obj** literals = pidata->literals; /* Literal pool */
 
     if (objc != 2) {
 	Tcl_WrongNumArgs(interp, 2, objv, "");
 	return TCL_ERROR;
     }
+    if (AwaitPipelinedResult(interp, rdata) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, ResultSetRowcount(rdata));
+    return TCL_OK;
+}
+
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetRowcount --
+ *
+ *	Determines the number of rows affected by the statement of a
+ *	result set.
+ *
+ * Results:
+ *	Returns the count, or -1 if it is not yet known.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static Tcl_Obj*
+ResultSetRowcount(
+    ResultSetData* rdata	/* Result set */
+) {
+    Tcl_Obj** literals = rdata->sdata->cdata->pidata->literals;
+				/* Literal pool */
+    char * nTuples;
+
+    /* A spooled result knows how many rows it holds */
+
+    if (rdata->spool != NULL) {
+	return Tcl_NewWideIntObj(rdata->spool->nRows);
+    }
+
+    /* The count isn't known until the last row has been streamed */
+
+    if (rdata->flags & (RS_FLAG_STREAMING | RS_FLAG_CURSOR)) {
+	return Tcl_NewWideIntObj(-1);
+    }
+
+    /* A cursor's result holds just the last FETCH */
+
+    if (rdata->flags & RS_FLAG_BATCHED) {
+	return Tcl_NewWideIntObj(rdata->batchStart
+				 + PQntuples(rdata->execResult));
+    }
 
     nTuples = PQcmdTuples(rdata->execResult);
     if (strlen(nTuples) == 0) {
-	Tcl_SetObjResult(interp, literals[LIT_0]);
+	return literals[LIT_0];
     } else {
-	Tcl_SetObjResult(interp,
-	    Tcl_NewStringObj(nTuples, -1));
+	return Tcl_NewStringObj(nTuples, -1);
     }
-    return TCL_OK;
 }
 
+/*
+ *-----------------------------------------------------------------------------
+ *
+ * ResultSetMemoryMethod --
+ *
+ *	Reports the memory held by a Postgres result set.
+ *
+ * Usage:
+ *	$resultSet memory
+ *
+ * Results:
+ *	Returns a standard Tcl result, whose value is a dictionary giving
+ *	the bytes held in the 'result' received from the server (0 if the
+ *	client library cannot tell), in the in-memory part of a 'spool',
+ *	in the spool's temporary 'file', and in the Tcl 'objects' that the
+ *	result set keeps, which are its interned values.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+static int
+ResultSetMemoryMethod(
+    ClientData clientData,	/* Not used */
+    Tcl_Interp* interp,		/* Tcl interpreter */
+    Tcl_ObjectContext context,	/* Object context  */
+    int objc, 			/* Parameter count */
+    Tcl_Obj *const objv[]	/* Parameter vector */
+) {
+    Tcl_Object thisObject = Tcl_ObjectContextObject(context);
+				/* The current result set object */
+    ResultSetData* rdata = (ResultSetData*)
+	Tcl_ObjectGetMetadata(thisObject, &resultSetDataType);
+				/* Data pertaining to the current result set */
+    ResultSpool* spool = rdata->spool;
+				/* Spool of the result set, or NULL */
+    Tcl_WideInt spoolBytes = 0;	/* Bytes of the spool in memory */
+    Tcl_WideInt fileBytes = 0;	/* Bytes of the spool in the file */
+    Tcl_WideInt objBytes = 0;	/* Bytes of interned values */
+    Tcl_Obj* retval;
+
+    if (objc != 2) {
+	Tcl_WrongNumArgs(interp, 2, objv, "");
+	return TCL_ERROR;
+    }
+
+    if (spool != NULL) {
+	spoolBytes = sizeof(ResultSpool) + spool->capacity
+	    + spool->batchCapacity * sizeof(Tcl_WideInt)
+	    + spool->nColumns * sizeof(PGresAttDesc);
+	if (spool->chan != NULL) {
+	    fileBytes = spool->size - spool->nBytes;
+	}
+    }
+    if (rdata->internTable != NULL) {
+	Tcl_HashSearch search;
+	Tcl_HashEntry* entry;
+	int length;
+
+	for (entry = Tcl_FirstHashEntry(rdata->internTable, &search);
+	     entry != NULL;
+	     entry = Tcl_NextHashEntry(&search)) {
+	    Tcl_GetStringFromObj((Tcl_Obj*) Tcl_GetHashValue(entry), &length);
+	    objBytes += sizeof(Tcl_HashEntry) + sizeof(Tcl_Obj)
+		+ 2 * (length + 1);
+	}
+    }
+
+    retval = Tcl_NewObj();
+    Tcl_DictObjPut(NULL, retval, Tcl_NewStringObj("result", -1),
+		   Tcl_NewWideIntObj(
+		       (Tcl_WideInt) ResultMemorySize(rdata->execResult)));
+    Tcl_DictObjPut(NULL, retval, Tcl_NewStringObj("spool", -1),
+		   Tcl_NewWideIntObj(spoolBytes));
+    Tcl_DictObjPut(NULL, retval, Tcl_NewStringObj("file", -1),
+		   Tcl_NewWideIntObj(fileBytes));
+    Tcl_DictObjPut(NULL, retval, Tcl_NewStringObj("objects", -1),
+		   Tcl_NewWideIntObj(objBytes));
+    Tcl_SetObjResult(interp, retval);
+    return TCL_OK;
+}
+
 /*
  *-----------------------------------------------------------------------------
  *
@@ -4539,6 +12392,9 @@ Tdbcpostgres_Init(
 	pidata->literals[i] = Tcl_NewStringObj(LiteralValues[i], -1);
 	Tcl_IncrRefCount(pidata->literals[i]);
     }
+    pidata->listType = Tcl_GetObjType("list");
+    pidata->dictType = Tcl_GetObjType("dict");
+    pidata->doubleType = Tcl_GetObjType("double");
     Tcl_InitHashTable(&(pidata->typeNumHash), TCL_ONE_WORD_KEYS);
     for (i = 0; dataTypes[i].name != NULL; ++i) {
 	int isNew;
@@ -4550,6 +12406,24 @@ Tdbcpostgres_Init(
 	Tcl_IncrRefCount(nameObj);
 	Tcl_SetHashValue(entry, (ClientData) nameObj);
     }
+    for (i = 0; arrayTypes[i].arrayOid != 0; ++i) {
+	int isNew;
+	Tcl_HashEntry* elementEntry =
+	    Tcl_FindHashEntry(&(pidata->typeNumHash),
+			      INT2PTR(arrayTypes[i].elementOid));
+	Tcl_HashEntry* entry;
+	Tcl_Obj* nameObj;
+
+	if (elementEntry == NULL) {
+	    continue;
+	}
+	entry = Tcl_CreateHashEntry(&(pidata->typeNumHash),
+				    INT2PTR(arrayTypes[i].arrayOid), &isNew);
+	nameObj = Tcl_DuplicateObj((Tcl_Obj*) Tcl_GetHashValue(elementEntry));
+	Tcl_AppendToObj(nameObj, "[]", 2);
+	Tcl_IncrRefCount(nameObj);
+	Tcl_SetHashValue(entry, (ClientData) nameObj);
+    }
 
 
     /*
@@ -4652,6 +12526,11 @@ Tdbcpostgres_Init(
 		  (ClientData) 0);
     Tcl_DecrRefCount(nameObj);
 
+    /* Create the command that wraps channels for binding to parameters */
+
+    Tcl_CreateObjCommand(interp, "::tdbc::postgres::blob", BlobCmd,
+			 NULL, NULL);
+
     /*
      * Initialize the PostgreSQL library if this is the first interp using it.
      */
@@ -53,8 +53,8 @@ package require tdbc
 	}
     }
 
-    # The 'init', 'begintransaction', 'commit, 'rollback', 'tables'
-    #  and 'columns' methods are implemented in C.
+    # The 'init', 'begintransaction', 'commit, 'rollback', 'tables',
+    #  'columns' and 'pipeline' methods are implemented in C.
 
 }
 
@@ -78,16 +78,23 @@ package require tdbc
 
     # Methods implemented in C:
     #
+    # bind cmdName ?-as lists|dicts?
+    #   Creates a command that executes the statement with its parameters
+    #   given by position, and returns the rows of the result.
     # constructor connection SQLCode
     #	The constructor accepts the handle to the connection and the SQL code
     #	for the statement to prepare.  It creates a subordinate namespace to
     #	hold the statement's active result sets, and then delegates to the
     #	'init' method, written in C, to do the actual work of preparing the
     #	statement.
+    # executemany paramSets ?-positional?
+    #	Executes the statement for each set of parameters, pipelined where
+    #	the client library allows, and returns the rows affected by each.
     # params
     #   Returns descriptions of the parameters of a statement.
     # paramtype paramname ?direction? type ?precision ?scale??
-    #   Declares the type of a parameter in the statement
+    #   Declares the type of a parameter in the statement; 'type[]' declares
+    #   an array, which takes a Tcl list
 
 }
 
@@ -104,22 +111,29 @@ package require tdbc
 
     superclass ::tdbc::resultset
 
-    # The 'nextresults' method is stubbed out; tdbcpostgres does not
-    # allow a single call to return multiple results.
-
-    method nextresults {} {
-	while {[my nextdict rubbish]} {}
-	return 0
-    }
-
     # Methods implemented in C include:
 
-    # constructor statement ?dictionary?
+    # constructor statement ?-option value?... ?dictionary?
     #     -- Executes the statement against the database, optionally providing
     #        a dictionary of substituted parameters (default is to get params
-    #        from variables in the caller's scope).
+    #        from variables in the caller's scope, or a list of values in
+    #        order with -positional). The -fetchmode,
+    #        -chunksize, -withhold, -intern, -spillthreshold and
+    #        -cancelonclose options override the connection's settings. With -reuse true, nextdict
+    #        and nextlist update the row in their variable in place when it
+    #        is unshared.
+    # allcolumns
+    #     -- Returns a dictionary whose keys are the column names and whose
+    #        values are lists of the remaining values in each column.
+    # allrows ?-as lists|dicts? ?-columnsvariable varName? ?--?
+    #     -- Returns a list of all the remaining rows of the result set,
+    #        converted in a single call.
     # columns
     #     -- Returns a list of the names of the columns in the result.
+    # memory
+    #     -- Returns a dictionary of the bytes held by the result set: the
+    #        result from the server, the spool in memory and on file, and
+    #        the Tcl objects that it keeps.
     # nextdict
     #     -- Stores the next row of the result set in the given variable in
     #        the caller's scope as a dictionary whose keys are
@@ -128,8 +142,26 @@ package require tdbc
     # nextlist
     #     -- Stores the next row of the result set in the given variable in
     #        the caller's scope as a list of cells.
+    # nextresults
+    #     -- Discards the remaining rows, cancelling a streaming query where
+    #        that is safe, and returns 0: tdbcpostgres does not allow a
+    #        single call to return multiple results.
+    # nextrows ?-as lists|dicts? ?--? count varName
+    #     -- Stores a list of up to 'count' rows in the given variable in
+    #        the caller's scope, and returns the number of rows stored.
+    # nextvars ?-prefix prefix? ?varName...?
+    #     -- Assigns the columns of the next row to variables in the
+    #        caller's scope, named after the columns unless given.
+    # rowat rowNumber ?-as lists|dicts?
+    #     -- Returns the given row of a materialized result set.
     # rowcount
     #     -- Returns a count of rows affected by the statement, or -1
     #        if the count of rows has not been determined.
+    # seek rowNumber
+    #     -- Makes the given row of a materialized result set the next one
+    #        to be returned.
+    # slice start count ?-as lists|dicts?
+    #     -- Returns a list of up to 'count' rows of a materialized result
+    #        set, beginning at row 'start'.
 
 }